@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Counts the number of heap allocations DirCache::glob makes per visited
+ * directory. A directory tree is created in a temporary directory and then
+ * globbed recursively, first with a cold cache and then with a warm cache. The
+ * warm run isolates the overhead of the glob engine itself.
+ *
+ * The allocations made by the thread pool for each task are also counted
+ * separately for a few kinds of tasks.
+ *
+ * Usage: glob_alloc [fanout] [depth]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <future>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "dircache.h"
+#include "threadpool.h"
+
+namespace {
+
+std::atomic<size_t> allocations(0);
+
+size_t directories = 0;
+
+void makeTree(const std::string& dir, int fanout, int depth) {
+    ++directories;
+
+    for (int i = 0; i < fanout; ++i) {
+        std::string file = dir + "/file" + std::to_string(i) + ".c";
+        if (FILE* f = fopen(file.c_str(), "w"))
+            fclose(f);
+    }
+
+    if (depth == 0) return;
+
+    for (int i = 0; i < fanout; ++i) {
+        std::string sub = dir + "/some_longer_directory_name_" + std::to_string(i);
+        mkdir(sub.c_str(), 0755);
+        makeTree(sub, fanout, depth - 1);
+    }
+}
+
+void removeTree(const std::string& dir) {
+    std::string cmd = "rm -rf -- '" + dir + "'";
+    if (system(cmd.c_str()) != 0)
+        fprintf(stderr, "Failed to remove '%s'\n", dir.c_str());
+}
+
+size_t runGlob(DirCache& cache, Path root, ThreadPool* pool) {
+    std::atomic<size_t> matches(0);
+
+    size_t before = allocations;
+
+    cache.glob(root, "**", [&] (Path) { ++matches; }, pool);
+
+    size_t after = allocations;
+
+    printf("    matched %zu files, %zu allocations, %.2f allocations/directory\n",
+            (size_t)matches, after - before, (double)(after - before) / directories);
+
+    return after - before;
+}
+
+/**
+ * Enqueues a number of tasks made by the given function and reports how many
+ * allocations there were per task.
+ */
+template<class MakeTask>
+void runTasks(ThreadPool& pool, const char* name, MakeTask makeTask) {
+    const size_t count = 100000;
+
+    size_t before = allocations;
+
+    for (size_t i = 0; i < count; ++i)
+        makeTask(i);
+
+    pool.waitAll();
+
+    size_t after = allocations;
+
+    printf("    %-24s %.2f allocations/task\n", name,
+            (double)(after - before) / count);
+}
+
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+int main(int argc, char** argv) {
+    int fanout = argc > 1 ? atoi(argv[1]) : 4;
+    int depth  = argc > 2 ? atoi(argv[2]) : 5;
+
+    char tmpl[] = "/tmp/glob_alloc.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    std::string root = tmpl;
+
+    makeTree(root, fanout, depth);
+
+    printf("%zu directories\n", directories);
+
+    {
+        DirCache cache;
+        ThreadPool pool;
+
+        printf("threaded, cold cache:\n");
+        runGlob(cache, root, &pool);
+
+        printf("threaded, warm cache:\n");
+        runGlob(cache, root, &pool);
+    }
+
+    {
+        DirCache cache;
+
+        printf("serial, cold cache:\n");
+        runGlob(cache, root, nullptr);
+
+        printf("serial, warm cache:\n");
+        runGlob(cache, root, nullptr);
+    }
+
+    removeTree(root);
+
+    {
+        ThreadPool pool;
+        std::atomic<size_t> sum(0);
+
+        printf("thread pool:\n");
+
+        runTasks(pool, "two pointers", [&] (size_t) {
+            std::atomic<size_t>* s = &sum;
+            pool.enqueueTask([s, &pool] { ++*s; });
+        });
+
+        runTasks(pool, "40 byte capture", [&] (size_t i) {
+            std::atomic<size_t>* s = &sum;
+            size_t a = i, b = i+1, c = i+2, d = i+3;
+            pool.enqueueTask([s, a, b, c, d] { *s += a + b + c + d; });
+        });
+
+        runTasks(pool, "128 byte capture", [&] (size_t i) {
+            std::atomic<size_t>* s = &sum;
+            size_t a[15] = {i};
+            pool.enqueueTask([s, a] { *s += a[0]; });
+        });
+
+        std::vector<std::future<size_t>> futures;
+        futures.reserve(100000);
+
+        runTasks(pool, "enqueue with future", [&] (size_t i) {
+            futures.push_back(pool.enqueue([i] { return i; }));
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Measures the hash module. The throughput of XXH3 and SHA-256 is measured on
+ * a buffer and compared to a simple hash written in pure Lua. Then a tree of
+ * files is hashed one at a time with hash.file and all at once with
+ * hash.files, which spreads them across the thread pool.
+ *
+ * Usage: hash_files [files] [file size] [threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "lua.hpp"
+
+#include "button-lua.h"
+#include "deps.h"
+#include "dircache.h"
+#include "pathtable.h"
+#include "scriptcache.h"
+#include "sha256.h"
+#include "threadpool.h"
+#include "xxh3.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * A multiplicative hash that works on both Lua 5.2 and 5.3. Anything that
+ * build scripts could write themselves is at least this slow.
+ */
+const char* luaHash = R"(
+local s = ...
+local byte = string.byte
+local h = 2166136261
+for i = 1, #s do
+    h = (h * 16777619 + byte(s, i)) % 4294967296
+end
+return h
+)";
+
+const char* fileScript = R"(
+local n, mode = ...
+local paths = {}
+for i = 1, n do
+    paths[i] = string.format("files/%d/%d", i % 32, i)
+end
+
+if mode == "files" then
+    local hashes = hash.files(paths)
+    assert(#hashes == n and hashes[n])
+else
+    for i = 1, n do
+        assert(hash.file(paths[i]))
+    end
+end
+)";
+
+double runLua(lua_State* L, const char* chunk, const std::string& arg,
+        int n = 0) {
+    if (luaL_loadstring(L, chunk) != LUA_OK) {
+        fprintf(stderr, "Error: %s\n", lua_tostring(L, -1));
+        return -1;
+    }
+
+    int args = 1;
+
+    if (n) {
+        lua_pushinteger(L, n);
+        ++args;
+    }
+
+    lua_pushlstring(L, arg.data(), arg.length());
+
+    auto start = Clock::now();
+
+    if (lua_pcall(L, args, 0, 0) != LUA_OK) {
+        fprintf(stderr, "Error: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return -1;
+    }
+
+    return seconds(start);
+}
+
+void report(const char* name, double t, double bytes) {
+    printf("%-24s %10.3f %10.1f\n", name, t * 1000,
+            bytes / t / (1024 * 1024));
+}
+
+/**
+ * Creates the files to hash in the current directory.
+ */
+bool createFiles(int files, size_t size) {
+    std::string contents(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+        contents[i] = (char)(i * 131 + 7);
+
+    mkdir("files", 0755);
+
+    char path[64];
+
+    for (int i = 0; i < 32; ++i) {
+        snprintf(path, sizeof(path), "files/%d", i);
+        mkdir(path, 0755);
+    }
+
+    for (int i = 1; i <= files; ++i) {
+        snprintf(path, sizeof(path), "files/%d/%d", i % 32, i);
+
+        FILE* f = fopen(path, "wb");
+        if (!f)
+            return false;
+
+        fwrite(contents.data(), 1, contents.size(), f);
+        fclose(f);
+    }
+
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int files = 2000;
+    size_t size = 16 * 1024;
+    size_t threads = std::thread::hardware_concurrency();
+
+    if (argc > 1) files = atoi(argv[1]);
+    if (argc > 2) size = (size_t)atoi(argv[2]);
+    if (argc > 3) threads = (size_t)atoi(argv[3]);
+
+    printf("%-24s %10s %10s\n", "", "ms", "MiB/s");
+
+    // Raw throughput
+    {
+        std::string buf(64 * 1024 * 1024, 'x');
+
+        auto start = Clock::now();
+        volatile uint64_t h = xxh3(buf.data(), buf.size());
+        (void)h;
+        report("xxh3", seconds(start), (double)buf.size());
+
+        uint8_t digest[Sha256::digestSize];
+        start = Clock::now();
+        Sha256::hash(buf.data(), buf.size(), digest);
+        report("sha256", seconds(start), (double)buf.size());
+    }
+
+    char dir[] = "/tmp/button-lua-hash-XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) {
+        perror("Failed to create directory");
+        return 1;
+    }
+
+    if (!createFiles(files, size)) {
+        perror("Failed to create files");
+        return 1;
+    }
+
+    ImplicitDeps deps;
+    DirCache dirCache(&deps);
+    ThreadPool pool(threads);
+    ScriptCache scriptCache;
+    PathTable pathTable;
+
+    lua_State* L = luaL_newstate();
+    if (!L || buttonlua::init(L) != 0)
+        return 1;
+
+    buttonlua::setup(L, dirCache, pool, deps, scriptCache, pathTable);
+
+    const std::string small(1024 * 1024, 'x');
+    const double bytes = (double)files * size;
+
+    const double tLua = runLua(L, luaHash, small);
+    const double tFile = runLua(L, fileScript, "file", files);
+    const double tFiles = runLua(L, fileScript, "files", files);
+
+    lua_close(L);
+
+    if (system((std::string("rm -rf ") + dir).c_str()) != 0)
+        fprintf(stderr, "Warning: failed to remove %s\n", dir);
+
+    if (tLua < 0 || tFile < 0 || tFiles < 0)
+        return 1;
+
+    report("pure Lua", tLua, (double)small.size());
+
+    printf("\n%d files of %zu bytes, %zu threads\n", files, size, threads);
+    report("hash.file", tFile, bytes);
+    report("hash.files", tFiles, bytes);
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Measures decoding a generated JSON document of build metadata. The parser
+ * is measured on its own and through the json module, eagerly and lazily, and
+ * is compared against a small decoder written in pure Lua of the kind that
+ * build scripts would otherwise have to carry around.
+ *
+ * Usage: json_decode [entries] [runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+
+#include "lua.hpp"
+
+#include "json.h"
+#include "lua_json.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * A straightforward recursive descent decoder in Lua. Doesn't handle \u
+ * escapes, which the generated document doesn't have.
+ */
+const char* luaDecoder = R"(
+local find, sub, byte, tonumber = string.find, string.sub, string.byte, tonumber
+local escapes = {b = "\b", f = "\f", n = "\n", r = "\r", t = "\t"}
+
+local value
+
+local function skip(s, i)
+    return find(s, "[^ \t\r\n]", i) or #s + 1
+end
+
+local function str(s, i)
+    local j = i + 1
+    local parts = {}
+    while true do
+        local k = find(s, '["\\]', j)
+        if not k then error("unterminated string") end
+        parts[#parts+1] = sub(s, j, k - 1)
+        if byte(s, k) == 34 then
+            return table.concat(parts), k + 1
+        end
+        local c = sub(s, k + 1, k + 1)
+        parts[#parts+1] = escapes[c] or c
+        j = k + 2
+    end
+end
+
+function value(s, i)
+    i = skip(s, i)
+    local c = byte(s, i)
+    if c == 123 then
+        local t = {}
+        i = skip(s, i + 1)
+        if byte(s, i) == 125 then return t, i + 1 end
+        while true do
+            local k
+            k, i = str(s, skip(s, i))
+            i = skip(s, i) + 1
+            t[k], i = value(s, i)
+            i = skip(s, i)
+            c = byte(s, i)
+            i = i + 1
+            if c == 125 then return t, i end
+        end
+    elseif c == 91 then
+        local t = {}
+        i = skip(s, i + 1)
+        if byte(s, i) == 93 then return t, i + 1 end
+        while true do
+            t[#t+1], i = value(s, i)
+            i = skip(s, i)
+            c = byte(s, i)
+            i = i + 1
+            if c == 93 then return t, i end
+        end
+    elseif c == 34 then
+        return str(s, i)
+    elseif c == 116 then
+        return true, i + 4
+    elseif c == 102 then
+        return false, i + 5
+    elseif c == 110 then
+        return nil, i + 4
+    end
+    local _, j = find(s, "^-?[%d.eE+-]+", i)
+    return tonumber(sub(s, i, j)), j + 1
+end
+
+return function(s) return (value(s, 1)) end
+)";
+
+/**
+ * Generates a document with the given number of entries, each describing a
+ * compilation.
+ */
+std::string generate(int entries) {
+    std::string s = "{\"version\": 1, \"entries\": [\n";
+
+    char buf[512];
+
+    for (int i = 0; i < entries; ++i) {
+        snprintf(buf, sizeof(buf),
+            "  {\"file\": \"src/module%d/source%d.cc\", "
+            "\"directory\": \"/home/user/project/build\", "
+            "\"arguments\": [\"c++\", \"-std=c++11\", \"-Wall\", \"-O2\", "
+            "\"-Isrc/module%d\", \"-DID=%d\", \"-c\", \"src/module%d/source%d.cc\", "
+            "\"-o\", \"obj/module%d/source%d.o\"], "
+            "\"size\": %d, \"ratio\": %d.%d, \"generated\": %s, \"owner\": null, "
+            "\"note\": \"line\\none\\ttab \\\"quoted\\\"\"}%s\n",
+            i % 50, i, i % 50, i, i % 50, i, i % 50, i,
+            1000 + i * 7, i % 10, i % 7, (i % 3) ? "false" : "true",
+            (i + 1 < entries) ? "," : "");
+        s += buf;
+    }
+
+    s += "]}\n";
+    return s;
+}
+
+template<class F>
+bool report(const char* name, int runs, size_t bytes, F f) {
+    double best = 0;
+
+    for (int i = 0; i < runs; ++i) {
+        const double t = f();
+        if (t < 0) {
+            fprintf(stderr, "Error: '%s' failed\n", name);
+            return false;
+        }
+
+        if (i == 0 || t < best)
+            best = t;
+    }
+
+    printf("%-28s %10.3f %10.1f\n", name, best * 1000,
+            (double)bytes / best / (1024 * 1024));
+    return true;
+}
+
+/**
+ * Runs the chunk with the document as its argument and returns the time taken.
+ */
+double runLua(lua_State* L, int ref, const std::string& doc) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+    lua_pushlstring(L, doc.data(), doc.length());
+
+    lua_gc(L, LUA_GCCOLLECT, 0);
+
+    auto start = Clock::now();
+
+    if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+        fprintf(stderr, "%s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return -1;
+    }
+
+    return seconds(start);
+}
+
+int loadChunk(lua_State* L, const char* chunk) {
+    if (luaL_loadstring(L, chunk) != LUA_OK) {
+        fprintf(stderr, "%s\n", lua_tostring(L, -1));
+        exit(1);
+    }
+
+    return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+}
+
+int main(int argc, char** argv) {
+    int entries = 20000;
+    int runs = 5;
+
+    if (argc > 1) entries = atoi(argv[1]);
+    if (argc > 2) runs = atoi(argv[2]);
+
+    const std::string doc = generate(entries);
+
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+
+    luaL_requiref(L, "json", luaopen_json, 1);
+    lua_pop(L, 1);
+
+    if (luaL_dostring(L, luaDecoder) != LUA_OK) {
+        fprintf(stderr, "%s\n", lua_tostring(L, -1));
+        return 1;
+    }
+
+    lua_setglobal(L, "luadecode");
+
+    const int luaAll = loadChunk(L,
+        "local t = luadecode(...); assert(#t.entries > 0)");
+    const int eagerAll = loadChunk(L,
+        "local t = json.decode(...); assert(#t.entries > 0)");
+    const int lazyAll = loadChunk(L,
+        "local t = json.decode(..., {lazy = true})\n"
+        "local n = 0\n"
+        "for _, e in ipairs(t.entries) do n = n + #e.arguments end\n"
+        "assert(n > 0)");
+    const int lazyOne = loadChunk(L,
+        "local t = json.decode(..., {lazy = true})\n"
+        "assert(t.entries[#t.entries].file)");
+
+    printf("Decoding %zu bytes, %d entries, best of %d runs\n",
+            doc.length(), entries, runs);
+    printf("%-28s %10s %10s\n", "decoder", "best ms", "MiB/s");
+
+    const bool ok =
+        report("parse only", runs, doc.length(), [&] {
+            auto start = Clock::now();
+            json::Document d;
+            if (!d.parse(doc.data(), doc.length()))
+                return -1.0;
+            return seconds(start);
+        }) &&
+        report("pure Lua", runs, doc.length(), [&] {
+            return runLua(L, luaAll, doc);
+        }) &&
+        report("json.decode", runs, doc.length(), [&] {
+            return runLua(L, eagerAll, doc);
+        }) &&
+        report("lazy, every entry", runs, doc.length(), [&] {
+            return runLua(L, lazyAll, doc);
+        }) &&
+        report("lazy, one entry", runs, doc.length(), [&] {
+            return runLua(L, lazyOne, doc);
+        });
+
+    lua_close(L);
+
+    return ok ? 0 : 1;
+}
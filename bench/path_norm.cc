@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Measures path normalization on typical, deep, and long paths, for both Posix
+ * and Windows paths. The single pass normalizer is compared against the
+ * previous implementation, which recursively split the path into a vector of
+ * components and then resolved them with a stack. Heap allocations per path
+ * are counted as well.
+ *
+ * Before measuring, both implementations are run on many random paths to check
+ * that they give the same results.
+ *
+ * Usage: path_norm [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "path.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+std::atomic<size_t> allocations(0);
+
+/**
+ * The previous implementation of BasePath::components.
+ */
+template<class PathImpl>
+void oldComponents(const PathImpl& path, std::vector<PathImpl>& v) {
+    Split<PathImpl> s = path.split();
+
+    if (s.head.isRoot() && !s.tail.length) {
+        v.push_back(s.head);
+        return;
+    }
+
+    if (s.head.length) {
+        oldComponents(s.head, v);
+
+        if (s.tail.length)
+            v.push_back(s.tail);
+    }
+    else if (s.tail.length) {
+        v.push_back(s.tail);
+    }
+}
+
+/**
+ * The previous implementation of BasePath::norm.
+ */
+template<class PathImpl>
+void oldNorm(const PathImpl& path, std::string& buf) {
+    std::vector<PathImpl> components;
+    oldComponents(path, components);
+
+    std::vector<PathImpl> stack;
+
+    for (auto&& c: components) {
+        if (c.isDot())
+            continue;
+        else if (c.isDotDot() && !stack.empty() && !stack.back().isDotDot()) {
+            if (!stack.back().isabs())
+                stack.pop_back();
+        }
+        else
+            stack.push_back(c);
+    }
+
+    if (stack.empty()) {
+        PathImpl(".").join(buf);
+    }
+    else {
+        for (auto&& c: stack)
+            c.join(buf);
+    }
+
+    for (auto& ch: buf) {
+        if (PathImpl::isSep(ch) && ch != PathImpl::defaultSep)
+            ch = PathImpl::defaultSep;
+    }
+}
+
+/**
+ * Checks that both implementations agree on random paths. Returns the number
+ * of mismatches.
+ */
+template<class PathImpl>
+size_t check(const char* name, size_t count) {
+    static const char alphabet[] = "ab./\\\\:?UNC";
+
+    uint32_t state = 12345;
+    size_t mismatches = 0;
+
+    std::string path, expected, actual;
+
+    for (size_t i = 0; i < count; ++i) {
+        path.clear();
+
+        state = state * 1664525u + 1013904223u;
+        const size_t len = (state >> 16) % 24;
+
+        for (size_t j = 0; j < len; ++j) {
+            state = state * 1664525u + 1013904223u;
+            path.push_back(alphabet[(state >> 16) % (sizeof(alphabet) - 1)]);
+        }
+
+        // Also check that the result is appended to the buffer correctly.
+        const char* prefix = (i % 3 == 0) ? "" : (i % 3 == 1) ? "x" : "x/";
+
+        expected = prefix;
+        oldNorm(PathImpl(path), expected);
+
+        actual = prefix;
+        PathImpl(path).norm(actual);
+
+        std::vector<PathImpl> oldC, newC;
+        oldComponents(PathImpl(path), oldC);
+        PathImpl(path).components(newC);
+
+        bool same = oldC.size() == newC.size();
+        for (size_t j = 0; same && j < oldC.size(); ++j)
+            same = oldC[j].copy() == newC[j].copy();
+
+        if (expected != actual || !same) {
+            if (++mismatches <= 10)
+                fprintf(stderr, "%s: '%s%s' normalized to '%s', expected '%s'\n",
+                        name, prefix, path.c_str(), actual.c_str(),
+                        expected.c_str());
+        }
+    }
+
+    return mismatches;
+}
+
+std::vector<std::string> typicalPaths() {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 64; ++i) {
+        paths.push_back("src/module" + std::to_string(i) + "/../module" +
+                std::to_string(i + 1) + "/./file" + std::to_string(i) + ".cc");
+    }
+    return paths;
+}
+
+std::vector<std::string> deepPaths() {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 8; ++i) {
+        std::string p = "/root";
+        for (int j = 0; j < 256; ++j) {
+            if (j % 7 == 3)
+                p += "/..";
+            else if (j % 5 == 1)
+                p += "/.";
+            else
+                p += "/d" + std::to_string(j);
+        }
+        paths.push_back(p);
+    }
+    return paths;
+}
+
+std::vector<std::string> longPaths() {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 8; ++i) {
+        std::string p;
+        for (int j = 0; j < 4; ++j) {
+            p += std::string(1000 + i, (char)('a' + j));
+            p += "/";
+        }
+        p += "file.c";
+        paths.push_back(p);
+    }
+    return paths;
+}
+
+struct Result {
+    double ns;
+    double allocations;
+};
+
+template<class PathImpl, bool useOld>
+Result measure(const std::vector<std::string>& paths, size_t iterations) {
+    std::string buf;
+    buf.reserve(8192);
+
+    size_t sink = 0;
+
+    const size_t before = allocations;
+    auto start = Clock::now();
+
+    for (size_t i = 0; i < iterations; ++i) {
+        for (auto&& p: paths) {
+            buf.clear();
+
+            if (useOld)
+                oldNorm(PathImpl(p), buf);
+            else
+                PathImpl(p).norm(buf);
+
+            sink += buf.size();
+        }
+    }
+
+    const double elapsed = std::chrono::duration<double>(
+            Clock::now() - start).count();
+
+    const size_t count = iterations * paths.size();
+
+    if (sink == 0)
+        fputs("", stderr);
+
+    Result r;
+    r.ns = elapsed * 1e9 / count;
+    r.allocations = (double)(allocations - before) / count;
+    return r;
+}
+
+template<class PathImpl>
+void run(const char* name, const char* workload,
+        const std::vector<std::string>& paths, size_t iterations) {
+
+    const Result o = measure<PathImpl, true>(paths, iterations);
+    const Result n = measure<PathImpl, false>(paths, iterations);
+
+    printf("%-8s %-8s %10.1f %10.1f %8.2fx %10.1f %10.1f\n", name, workload,
+            o.ns, n.ns, o.ns / n.ns, o.allocations, n.allocations);
+}
+
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? (size_t)atoi(argv[1]) : 2000;
+
+    const size_t mismatches =
+        check<PosixPath>("posix", 200000) + check<WinPath>("windows", 200000);
+
+    if (mismatches) {
+        fprintf(stderr, "%zu mismatches with the previous implementation\n",
+                mismatches);
+        return 1;
+    }
+
+    const auto typical = typicalPaths();
+    const auto deep = deepPaths();
+    const auto lng = longPaths();
+
+    printf("%-8s %-8s %10s %10s %9s %10s %10s\n", "paths", "workload",
+            "old ns", "new ns", "speedup", "old allocs", "new allocs");
+
+    run<PosixPath>("posix", "typical", typical, iterations);
+    run<PosixPath>("posix", "deep", deep, iterations / 8);
+    run<PosixPath>("posix", "long", lng, iterations);
+    run<WinPath>("windows", "typical", typical, iterations);
+    run<WinPath>("windows", "deep", deep, iterations / 8);
+    run<WinPath>("windows", "long", lng, iterations);
+
+    return 0;
+}
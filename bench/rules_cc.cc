@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Measures how long it takes to generate the rules for a cc.binary target with
+ * many source files. This is dominated by the work done for every source file:
+ * the table helpers (table.join, table.filter, etc.) and the expansion of the
+ * compile rules (rules.expand_compile). The native implementations of these are
+ * compared against the Lua implementations they replaced. The pooled Lua
+ * allocator is also compared against malloc. Rules are written to /dev/null.
+ *
+ * Usage: rules_cc [sources] [runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "lua.hpp"
+
+#include "button-lua.h"
+#include "deps.h"
+#include "dircache.h"
+#include "threadpool.h"
+#include "rules.h"
+#include "scriptcache.h"
+#include "pathtable.h"
+#include "luaalloc.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * The table helpers and compile rule expansion as they were implemented in Lua.
+ */
+const char* luaHelpers = R"(
+function table.append(t, ...)
+    for _,i in ipairs({...}) do
+        if type(i) == "table" then
+            for _,j in ipairs(i) do
+                table.insert(t, j)
+            end
+        else
+            table.insert(t, i)
+        end
+    end
+
+    return t
+end
+
+function table.join(...)
+    local t = {}
+    return table.append(t, ...)
+end
+
+function table.contains(t, value)
+    for _,v in ipairs(t) do
+        if v == value then
+            return true
+        end
+    end
+
+    return false
+end
+
+function table.set(t)
+    local s = {}
+    for _,v in ipairs(t) do
+        s[v] = true
+    end
+    return s
+end
+
+function table.filter(t, pred)
+    local filtered = {}
+
+    for _,v in ipairs(t) do
+        if pred(v) then
+            table.insert(filtered, v)
+        end
+    end
+
+    return filtered
+end
+
+function expand_compile(t)
+    for i,src in ipairs(t.sources) do
+        local deps = {}
+        for _,v in ipairs(t.src_deps[src] or {}) do
+            table.insert(deps, path.norm(path.join(t.scriptdir, v)))
+        end
+
+        src = path.norm(path.join(t.scriptdir, src))
+
+        rule {
+            inputs  = table.join(t.headers, {src}, deps),
+            task    = {table.join(t.args, {"-c", src, "-o", t.objects[i]})},
+            outputs = {t.objects[i]},
+            display = t.display .. src,
+        }
+    end
+end
+)";
+
+/**
+ * Creates the sources, defines the target, and generates its rules.
+ */
+const char* benchScript = R"(
+local n = ...
+
+-- Every source depends on every header, so only have a few of them.
+local srcs = {}
+for i = 1, n do
+    if i % 5000 == 0 then
+        srcs[i] = string.format("src/module%d/file%d.h", i % 100, i)
+    elseif i % 2 == 0 then
+        srcs[i] = string.format("src/module%d/file%d.cc", i % 100, i)
+    else
+        srcs[i] = string.format("src/module%d/file%d.c", i % 100, i)
+    end
+end
+
+local cc = require "rules.cc"
+
+cc.binary {
+    name = "bench",
+    srcs = srcs,
+    includes = {"include", "src"},
+    warnings = {"all", "extra"},
+}
+
+require("rules").resolve()
+)";
+
+struct Config {
+    const char* name;
+
+    // Use the native table helpers and compile rule expansion.
+    bool native;
+
+    // Use the pools of the Lua allocator instead of malloc.
+    bool pooled;
+};
+
+const Config configs[] = {
+    {"lua",    false, false},
+    {"native", true,  false},
+    {"pooled", true,  true},
+};
+
+/**
+ * Runs the benchmark in a new Lua state. Returns the number of seconds taken,
+ * or a negative number on failure.
+ */
+double run(FILE* f, const Config& config, int sources, size_t& count,
+        size_t& peak) {
+    ImplicitDeps deps;
+    DirCache dirCache(&deps);
+    ThreadPool pool(1);
+    ScriptCache scriptCache;
+    PathTable pathTable;
+    buttonlua::Rules rules(f);
+    LuaAllocator allocator(config.pooled);
+
+    lua_State* L = lua_newstate(LuaAllocator::alloc, &allocator);
+    if (!L) return -1;
+
+    double elapsed = -1;
+
+    if (buttonlua::init(L) == 0) {
+        buttonlua::setup(L, dirCache, pool, deps, scriptCache, pathTable);
+        buttonlua::setupRules(L, rules);
+
+        if (config.native || luaL_dostring(L, luaHelpers) == LUA_OK) {
+            if (luaL_loadstring(L, benchScript) == LUA_OK) {
+                lua_pushinteger(L, sources);
+
+                allocator.phase("bench");
+
+                auto start = Clock::now();
+
+                if (lua_pcall(L, 1, 0, 0) == LUA_OK) {
+                    elapsed = std::chrono::duration<double>(
+                            Clock::now() - start).count();
+                    count = rules.count();
+                    peak = allocator.phases().back().peakBytes;
+                }
+            }
+        }
+
+        if (elapsed < 0)
+            fprintf(stderr, "Error: %s\n", lua_tostring(L, -1));
+    }
+
+    lua_close(L);
+    return elapsed;
+}
+
+double run(const Config& config, int sources, size_t& count, size_t& peak) {
+    FILE* f = fopen("/dev/null", "w");
+    if (!f) return -1;
+
+    const double elapsed = run(f, config, sources, count, peak);
+
+    fclose(f);
+    return elapsed;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int sources = 50000;
+    int runs = 3;
+
+    if (argc > 1) sources = atoi(argv[1]);
+    if (argc > 2) runs = atoi(argv[2]);
+
+    printf("cc.binary with %d sources, best of %d runs\n", sources, runs);
+    printf("%8s %10s %8s %8s %10s\n", "config", "seconds", "rules", "speedup",
+            "peak KiB");
+
+    double base = 0;
+
+    for (auto&& config: configs) {
+        double best = 0;
+        size_t rules = 0, peak = 0;
+
+        for (int i = 0; i < runs; ++i) {
+            const double t = run(config, sources, rules, peak);
+            if (t < 0)
+                return 1;
+
+            if (i == 0 || t < best)
+                best = t;
+        }
+
+        if (base == 0)
+            base = best;
+
+        printf("%8s %10.3f %8zu %7.2fx %10zu\n", config.name, best, rules,
+                base / best, peak / 1024);
+    }
+
+    return 0;
+}
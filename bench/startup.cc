@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Measures how long button-lua takes to start up and run a trivial script that
+ * doesn't glob. This is dominated by fixed costs: creating the Lua state,
+ * opening libraries, running init.lua, and creating the thread pool. The whole
+ * process is measured as well as some of these steps individually, and so is a
+ * run that is skipped because nothing changed since the last one.
+ *
+ * Usage: startup [button-lua] [runs] [threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lua.hpp"
+
+#include "button-lua.h"
+#include "threadpool.h"
+
+extern char** environ;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char* script = "rule {inputs = {'a'}, task = {{'true'}}, outputs = {'b'}}\n";
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Runs button-lua on the script once. Any extra arguments come after the
+ * script. Returns the number of seconds taken, or a negative number on failure.
+ */
+double runProcess(const char* program, const char* scriptPath,
+        const std::vector<std::string>& extra = std::vector<std::string>()) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+    std::vector<char*> argv;
+    argv.push_back((char*)program);
+    argv.push_back((char*)scriptPath);
+    for (auto&& arg: extra)
+        argv.push_back((char*)arg.c_str());
+    argv.push_back(NULL);
+
+    auto start = Clock::now();
+
+    pid_t pid;
+    int err = posix_spawn(&pid, program, &actions, NULL, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0)
+        return -1;
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0)
+        return -1;
+
+    return seconds(start);
+}
+
+/**
+ * Creates a Lua state and runs init.lua.
+ */
+double runInit() {
+    auto start = Clock::now();
+
+    lua_State* L = luaL_newstate();
+    if (!L || buttonlua::init(L) != 0)
+        return -1;
+
+    lua_close(L);
+
+    return seconds(start);
+}
+
+/**
+ * Creates and destroys a thread pool. If `tasks` is not zero, that many empty
+ * tasks are run on it.
+ */
+double runPool(size_t threads, size_t tasks) {
+    auto start = Clock::now();
+
+    {
+        ThreadPool pool(threads);
+
+        if (tasks) {
+            TaskGroup group(pool);
+            for (size_t i = 0; i < tasks; ++i)
+                group.run([] {});
+        }
+    }
+
+    return seconds(start);
+}
+
+template<class F>
+bool report(const char* name, int runs, F f) {
+    double best = 0, total = 0;
+
+    for (int i = 0; i < runs; ++i) {
+        const double t = f();
+        if (t < 0) {
+            fprintf(stderr, "Error: '%s' failed\n", name);
+            return false;
+        }
+
+        total += t;
+        if (i == 0 || t < best)
+            best = t;
+    }
+
+    printf("%-24s %10.3f %10.3f\n", name, best * 1000, total / runs * 1000);
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const char* program = "./button-lua";
+    int runs = 50;
+    size_t threads = std::thread::hardware_concurrency();
+
+    if (argc > 1) program = argv[1];
+    if (argc > 2) runs = atoi(argv[2]);
+    if (argc > 3) threads = (size_t)atoi(argv[3]);
+
+    char scriptPath[] = "/tmp/button-lua-startup-XXXXXX";
+    int fd = mkstemp(scriptPath);
+    if (fd == -1) {
+        perror("Failed to create script");
+        return 1;
+    }
+
+    if (write(fd, script, strlen(script)) < 0) {
+        perror("Failed to write script");
+        close(fd);
+        unlink(scriptPath);
+        return 1;
+    }
+
+    // Runs are only fingerprinted if their inputs are older than the run.
+    const struct timespec old[2] = {{time(NULL) - 3600, 0}, {time(NULL) - 3600, 0}};
+    futimens(fd, old);
+
+    close(fd);
+
+    char dir[] = "/tmp/button-lua-noop-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("Failed to create directory");
+        unlink(scriptPath);
+        return 1;
+    }
+
+    const std::vector<std::string> noop = {
+        "-o", std::string(dir) + "/out.json",
+        "--cache-dir", std::string(dir) + "/cache",
+    };
+
+    printf("Startup with a pool of %zu threads, %d runs\n", threads, runs);
+    printf("%-24s %10s %10s\n", "step", "best ms", "mean ms");
+
+    const bool ok =
+        report("process", runs, [&] { return runProcess(program, scriptPath); }) &&
+        report("process, no-op", runs, [&] {
+                return runProcess(program, scriptPath, noop); }) &&
+        report("lua state and init", runs, runInit) &&
+        report("thread pool, unused", runs, [=] { return runPool(threads, 0); }) &&
+        report("thread pool, 1 task", runs, [=] { return runPool(threads, 1); }) &&
+        report("thread pool, 1k tasks", runs, [=] { return runPool(threads, 1000); });
+
+    unlink(scriptPath);
+
+    if (system((std::string("rm -rf ") + dir).c_str()) != 0)
+        fprintf(stderr, "Warning: failed to remove %s\n", dir);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Measures how the thread pool scales with the number of threads. Two kinds of
+ * workloads are run:
+ *
+ *  - flat: Many small tasks are enqueued from outside of the pool.
+ *  - tree: Each task enqueues more tasks from inside of the pool, like the
+ *    recursive glob does for every directory.
+ *
+ * Usage: threadpool_scaling [max threads] [work per task]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "threadpool.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t flatTasks = 200000;
+const size_t treeFanout = 8;
+const size_t treeDepth = 6;
+
+// Prevents the busy work from being optimized away.
+std::atomic<size_t> sink(0);
+
+/**
+ * Simulates the work done by a task (e.g., listing a cached directory).
+ */
+void work(size_t amount) {
+    size_t x = amount;
+    for (size_t i = 0; i < amount; ++i)
+        x = x * 6364136223846793005u + 1442695040888963407u;
+    sink.fetch_add(x & 1, std::memory_order_relaxed);
+}
+
+struct Tree {
+    ThreadPool* pool;
+    size_t amount;
+    std::atomic<size_t> tasks;
+
+    void visit(size_t depth) {
+        ++tasks;
+        work(amount);
+
+        if (depth == 0) return;
+
+        for (size_t i = 0; i < treeFanout; ++i)
+            pool->enqueueTask([this, depth] { visit(depth - 1); });
+    }
+};
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double runFlat(ThreadPool& pool, size_t amount) {
+    auto start = Clock::now();
+
+    for (size_t i = 0; i < flatTasks; ++i)
+        pool.enqueueTask([amount] { work(amount); });
+
+    pool.waitAll();
+
+    return flatTasks / seconds(start);
+}
+
+double runTree(ThreadPool& pool, size_t amount) {
+    Tree tree;
+    tree.pool = &pool;
+    tree.amount = amount;
+    tree.tasks = 0;
+
+    auto start = Clock::now();
+
+    pool.enqueueTask([&tree] { tree.visit(treeDepth); });
+    pool.waitAll();
+
+    return tree.tasks / seconds(start);
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t maxThreads = 64;
+    size_t amount = 200;
+
+    if (argc > 1) maxThreads = (size_t)atoi(argv[1]);
+    if (argc > 2) amount = (size_t)atoi(argv[2]);
+
+    printf("%zu hardware threads, %zu iterations of work per task\n",
+            (size_t)std::thread::hardware_concurrency(), amount);
+    printf("%8s %14s %8s %14s %8s\n", "threads", "flat tasks/s", "speedup",
+            "tree tasks/s", "speedup");
+
+    double flatBase = 0, treeBase = 0;
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        ThreadPool pool(threads);
+
+        // Warm up such that all threads have started.
+        runFlat(pool, amount);
+
+        const double flat = runFlat(pool, amount);
+        const double tree = runTree(pool, amount);
+
+        if (threads == 1) {
+            flatBase = flat;
+            treeBase = tree;
+        }
+
+        printf("%8zu %14.0f %7.2fx %14.0f %7.2fx\n", threads, flat,
+                flat / flatBase, tree, tree / treeBase);
+    }
+
+    return 0;
+}
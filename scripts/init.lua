@@ -184,50 +184,7 @@ function table.print(t, name, indent)
     print(table.show(t, name, indent))
 end
 
-function table.append(t, ...)
-    for _,i in ipairs({...}) do
-        if type(i) == "table" then
-            for _,j in ipairs(i) do
-                table.insert(t, j)
-            end
-        else
-            table.insert(t, i)
-        end
-    end
-
-    return t
-end
-
-function table.join(...)
-    local t = {}
-    return table.append(t, ...)
-end
-
 --[[
-Checks if the given table contains the given value. Returns true if the value is
-in the table, false otherwise.
+table.append, table.join, table.contains, table.set, and table.filter are
+implemented in C. See src/lua_table.cc.
 ]]
-function table.contains(t, value)
-    for _,v in ipairs(t) do
-        if v == value then
-            return true
-        end
-    end
-
-    return false
-end
-
---[[
-Returns a new table with only the items that the predicate returns true for.
-]]
-function table.filter(t, pred)
-    local filtered = {}
-
-    for _,v in ipairs(t) do
-        if pred(v) then
-            table.insert(filtered, v)
-        end
-    end
-
-    return filtered
-end
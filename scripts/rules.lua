@@ -86,4 +86,8 @@ return {
     common = common,
     add = add,
     resolve = resolve,
+
+    -- Outputs the compile rules for many sources at once. See
+    -- Rules::expandCompile in src/rules.h.
+    expand_compile = expand_compile,
 }
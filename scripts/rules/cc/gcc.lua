@@ -6,24 +6,19 @@ Generates rules for compiling and linking C/C++ with gcc.
 ]]
 
 local rules = require "rules"
+local argv = require "argv"
 
 --[[
     Helper functions.
 ]]
-local cc_srcs = {".cc", ".cpp", ".cxx", ".c++.C"}
-local cc_hdrs = {".h", ".hh", ".hpp", ".hxx", ".inc"}
+local cc_srcs = table.set {".cc", ".cpp", ".cxx", ".c++.C"}
+local cc_hdrs = table.set {".h", ".hh", ".hpp", ".hxx", ".inc"}
 
-local function is_c_source(ext)
-    return ext == ".c"
-end
+-- Extensions of both C and C++ sources.
+local all_srcs = table.set {".c", ".cc", ".cpp", ".cxx", ".c++.C"}
 
 local function is_cpp_source(ext)
-    return table.contains(cc_srcs, ext)
-end
-
-local function is_source(f)
-    local ext = path.getext(f)
-    return is_c_source(ext) or is_cpp_source(ext)
+    return cc_srcs[ext] == true
 end
 
 local function has_cpp_source(srcs)
@@ -36,28 +31,18 @@ local function has_cpp_source(srcs)
     return false
 end
 
-local function is_header(f)
-    return table.contains(cc_hdrs, path.getext(f))
-end
-
-local function to_object(objdir, src)
-    return path.norm(path.join(objdir, src .. ".o"))
-end
-
 --[[
     Returns a list of filtered C/C++ sources and their corresponding objects.
 ]]
 local function get_sources_and_objects(srcs, objdir)
-    local sources = {}
+    local sources = path.filter_ext(srcs, all_srcs)
+
     local objects = {}
-    for _,v in ipairs(srcs) do
-        if is_source(v) then
-            table.insert(sources, path.norm(v))
-            table.insert(objects, to_object(objdir, v))
-        end
+    for i,v in ipairs(sources) do
+        objects[i] = v .. ".o"
     end
 
-    return sources, objects
+    return path.norm_all(sources), path.norm_all(objects, objdir)
 end
 
 --[[
@@ -75,9 +60,8 @@ local function compile(self)
         table.insert(compiler_opts, "-W".. v)
     end
 
-    for _,v in ipairs(self.includes) do
-        table.insert(compiler_opts,
-            "-I".. path.norm(path.join(self.scriptdir, v)))
+    for _,v in ipairs(path.norm_all(self.includes, self.scriptdir)) do
+        table.insert(compiler_opts, "-I".. v)
     end
 
     for _,v in ipairs(self.defines) do
@@ -86,33 +70,23 @@ local function compile(self)
 
     table.append(compiler_opts, self.compiler_opts)
 
-    local headers = table.filter(self.srcs, is_header)
-    for i,v in ipairs(headers) do
-        headers[i] = path.norm(path.join(self.scriptdir, v))
-    end
+    local headers = path.norm_all(path.filter_ext(self.srcs, cc_hdrs),
+        self.scriptdir)
 
     local sources, objects = get_sources_and_objects(
         self.srcs,
         path.join(self.scriptdir, objdir)
         )
 
-    for i,src in ipairs(sources) do
-
-        local deps = {}
-        for _,v in ipairs(self.src_deps[src] or {}) do
-            table.insert(deps, path.norm(path.join(self.scriptdir, v)))
-        end
-
-        local src = path.norm(path.join(self.scriptdir, src))
-        local obj = objects[i]
-
-        rule {
-            inputs  = table.join(headers, {src}, deps),
-            task    = {table.join(args, compiler_opts, {"-c", src, "-o", obj})},
-            outputs = {obj},
-            display = "cc ".. src,
-        }
-    end
+    rules.expand_compile {
+        args      = argv.join(args, compiler_opts),
+        headers   = headers,
+        sources   = sources,
+        objects   = objects,
+        scriptdir = self.scriptdir,
+        src_deps  = self.src_deps,
+        display   = "cc ",
+    }
 
     return objects
 end
@@ -228,7 +202,7 @@ function common:rules()
     -- Create a binary executable.
     rule {
         inputs  = objects,
-        task    = {table.join(args, linker_opts, objects)},
+        task    = {argv.join(args, linker_opts, objects)},
         outputs = {output},
         display = "ld ".. self:basename(),
     }
@@ -263,7 +237,7 @@ function _library:rules()
         --  * D: operate in deterministic mode
         rule {
             inputs  = objects,
-            task    = {table.join(self.prefix, {self.toolchain.ar, "rcsD"}, output, objects)},
+            task    = {argv.join(self.prefix, self.toolchain.ar, "rcsD", output, objects)},
             outputs = {output},
             display = "ar ".. self:basename(),
         }
@@ -282,7 +256,7 @@ function _library:rules()
 
         rule {
             inputs  = objects,
-            task    = {table.join(args, opts, objects)},
+            task    = {argv.join(args, opts, objects)},
             outputs = {output},
             display = "ld ".. self:basename(),
         }
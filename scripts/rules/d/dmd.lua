@@ -6,6 +6,7 @@ Generates rules for the DMD compiler.
 ]]
 
 local rules = require "rules"
+local argv = require "argv"
 
 local cc = require "rules.cc"
 
@@ -14,19 +15,13 @@ Helper functions.
 
 TODO: Alter paths based on platform
 ]]
-local function is_d_source(src)
-    return path.getext(src) == ".d"
-end
-
-local function to_object(objdir, src)
-    return path.norm(path.setext(path.join(objdir, src), ".o"))
-end
+local d_srcs = {".d"}
 
 --[[
     Filters for D source files.
 ]]
 local function sources(files)
-    local srcs = table.filter(files, is_d_source)
+    local srcs = path.filter_ext(files, d_srcs)
 
     for i,v in ipairs(srcs) do
         files[i] = path.norm(v)
@@ -39,13 +34,7 @@ end
     Returns a list of objects corresponding to the given list of sources.
 ]]
 local function objects(srcs, objdir)
-    local objs = {}
-
-    for _,v in ipairs(srcs) do
-        table.insert(objs, to_object(objdir, v))
-    end
-
-    return objs
+    return path.norm_all(path.setext_all(path.join_all(srcs, objdir), ".o"))
 end
 
 --[[
@@ -195,12 +184,15 @@ function common:rules()
         -- Combined compilation
         rule {
             inputs  = table.join(srcs, libs, deps),
-            task    = {table.join(args, compiler_opts, self.linker_opts, srcs, libs)},
+            task    = {argv.join(args, compiler_opts, self.linker_opts, srcs, libs)},
             outputs = {self:path()},
             display = "dmd ".. self:basename(),
         }
     else
-        -- Individual compilation
+        -- Individual compilation. The flags are shared by every command
+        -- instead of being copied into each one.
+        local flags = argv.join(args, compiler_opts)
+
         for i,src in ipairs(srcs) do
 
             local deps = {}
@@ -213,8 +205,7 @@ function common:rules()
 
             rule {
                 inputs  = table.join({src}, deps),
-                task    = {table.join(args, compiler_opts,
-                    {"-c", src, "-of".. obj})},
+                task    = {argv.join(flags, "-c", src, "-of".. obj)},
                 outputs = {obj},
                 display = "dmd ".. src,
             }
@@ -222,7 +213,7 @@ function common:rules()
 
         rule {
             inputs = table.join(objs, libs),
-            task = {table.join(args, linker_opts, objs, libs)},
+            task = {argv.join(args, linker_opts, objs, libs)},
             outputs = {self:path()},
             display = "dmd ".. self:basename(),
         }
@@ -0,0 +1,91 @@
+--[[
+Copyright (c) Jason White. MIT license.
+
+Description:
+This script gets executed after init.lua in the Lua states used by import_all.
+Each of these states evaluates a single build script in parallel with the
+others. Instead of defining targets in this state, calls to the functions of
+rule modules (e.g., cc.binary) are recorded such that the main Lua state can
+make the same calls later in a deterministic order.
+
+The given function records a call. It takes the module name, function name,
+and the arguments. An empty module name refers to a global function.
+]]
+
+local record = ...
+
+local rules = require "rules"
+
+--[[
+    The call is only made in the main state. Making it here as well would
+    generate every target twice. Thus, calls made by scripts passed to
+    import_all return nothing.
+]]
+local function wrap(module, name)
+    return function(...)
+        record(module, name, ...)
+    end
+end
+
+--[[
+    Wraps all functions in the module such that calls to them get recorded.
+]]
+local proxies = {}
+
+local function proxy(module, m)
+    local p = proxies[module]
+    if p then
+        return p
+    end
+
+    p = setmetatable({}, {
+        __index = function(t, k)
+            local v = m[k]
+            if type(v) == "function" then
+                v = wrap(module, k)
+                rawset(t, k, v)
+            end
+            return v
+        end,
+        __newindex = m,
+    })
+
+    proxies[module] = p
+    return p
+end
+
+local _require = require
+function require(module)
+    local m = _require(module)
+
+    if type(m) == "table" and string.find(module, "^rules%.") then
+        return proxy(module, m)
+    end
+
+    return m
+end
+
+--[[
+    Targets added any other way would be lost.
+]]
+rules.add = function(target)
+    error("targets can only be added through rule modules "..
+        "(e.g., cc.binary) by scripts passed to import_all", 2)
+end
+
+--[[
+    Low-level rules and output are also replayed in the main state such that
+    they are in the same order as if the scripts were imported one by one.
+]]
+function rule(t)
+    record("", "rule", t)
+end
+
+function print(...)
+    local args = table.pack(...)
+    for i = 1, args.n do
+        args[i] = tostring(args[i])
+    end
+
+    record("", "print", table.unpack(args, 1, args.n))
+end
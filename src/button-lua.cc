@@ -13,6 +13,8 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <memory>
 #include <string>
 
 #include "button-lua.h"
@@ -21,18 +23,56 @@
 #include "lua_path.h"
 #include "embedded.h"
 #include "lua_glob.h"
+#include "lua_import.h"
+#include "lua_table.h"
+#include "lua_argv.h"
+#include "lua_fs.h"
+#include "lua_json.h"
+#include "lua_hash.h"
+#include "fingerprint.h"
 #include "deps.h"
 #include "dircache.h"
 #include "threadpool.h"
+#include "scriptcache.h"
+#include "pathtable.h"
+#include "luaalloc.h"
 
 namespace {
 
-const char* usage = "Usage: button-lua <script> [-o output] [args...]\n";
+const char* usage =
+    "Usage: button-lua <script> [-o output] [-j threads] [--cache-dir dir]\n"
+    "                  [--git-index file | --manifest file] [--mem-stats]\n"
+    "                  [--gc-mode incremental|generational]\n"
+    "                  [--gc-pause percent] [--gc-stepmul percent] [args...]\n";
 
 struct Options
 {
     const char* script;
     const char* output;
+
+    // If given, directory listings are taken from this git index file instead
+    // of the file system.
+    const char* gitIndex;
+
+    // Like gitIndex, but a list of paths separated by new lines.
+    const char* manifest;
+
+    // Number of threads to use. If 0, one per hardware thread.
+    size_t threads;
+
+    // If given, the bytecode of scripts is cached in this directory (e.g.,
+    // ".button-lua-cache"). This is off by default because the directory would
+    // otherwise show up in globs of the source tree. Runs are fingerprinted
+    // here as well such that they can be skipped when nothing changed.
+    const char* cacheDir;
+
+    // Print the memory usage of the Lua state to stderr when done.
+    bool memStats;
+
+    // Garbage collector parameters. Zero to use Lua's defaults.
+    bool gcGenerational;
+    int gcPause;
+    int gcStepMul;
 };
 
 struct Args
@@ -41,32 +81,189 @@ struct Args
     char** argv;
 };
 
+/**
+ * Parses a positive integer. Returns false if it isn't one.
+ */
+bool parse_positive(const char* s, long& n) {
+    char* end;
+    n = strtol(s, &end, 10);
+    return *s != '\0' && *end == '\0' && n > 0;
+}
+
 /**
  * Parses command line arguments. Returns true if successful.
  */
 bool parse_args(Options &opts, Args &args)
 {
-    if (args.n > 0) {
-        opts.script = args.argv[0];
-        --args.n; ++args.argv;
-
-        if (args.n > 0 && strcmp(args.argv[0], "-o") == 0) {
-            if (args.n > 1)
-                opts.output = args.argv[1];
-            else
-                return false;
-
-            args.n -= 2;
-            args.argv += 2;
-        }
-        else {
-            opts.output = NULL;
+    if (args.n <= 0)
+        return false;
+
+    opts.script = args.argv[0];
+    opts.output = NULL;
+    opts.gitIndex = NULL;
+    opts.manifest = NULL;
+    opts.threads = 0;
+    opts.cacheDir = NULL;
+    opts.memStats = false;
+    opts.gcGenerational = false;
+    opts.gcPause = 0;
+    opts.gcStepMul = 0;
+
+    const char* threads = NULL;
+    const char* gcMode = NULL;
+    const char* gcPause = NULL;
+    const char* gcStepMul = NULL;
+
+    --args.n; ++args.argv;
+
+    // Parse options until we find one we don't recognize. Everything else gets
+    // passed along to the script.
+    while (args.n > 0) {
+        const char* arg = args.argv[0];
+        const char** value;
+
+        // Flags without a value
+        if (strcmp(arg, "--mem-stats") == 0) {
+            opts.memStats = true;
+            --args.n; ++args.argv;
+            continue;
         }
 
-        return true;
+        if (strcmp(arg, "-o") == 0)
+            value = &opts.output;
+        else if (strcmp(arg, "--git-index") == 0)
+            value = &opts.gitIndex;
+        else if (strcmp(arg, "--manifest") == 0)
+            value = &opts.manifest;
+        else if (strcmp(arg, "-j") == 0)
+            value = &threads;
+        else if (strcmp(arg, "--cache-dir") == 0)
+            value = &opts.cacheDir;
+        else if (strcmp(arg, "--gc-mode") == 0)
+            value = &gcMode;
+        else if (strcmp(arg, "--gc-pause") == 0)
+            value = &gcPause;
+        else if (strcmp(arg, "--gc-stepmul") == 0)
+            value = &gcStepMul;
+        else
+            break;
+
+        if (args.n < 2)
+            return false;
+
+        *value = args.argv[1];
+
+        args.n -= 2;
+        args.argv += 2;
+    }
+
+    // Only one source of directory listings can be used.
+    if (opts.gitIndex && opts.manifest)
+        return false;
+
+    long n;
+
+    if (threads) {
+        if (!parse_positive(threads, n))
+            return false;
+
+        opts.threads = (size_t)n;
+    }
+
+    if (gcMode) {
+        if (strcmp(gcMode, "generational") == 0)
+            opts.gcGenerational = true;
+        else if (strcmp(gcMode, "incremental") != 0)
+            return false;
+    }
+
+    if (gcPause) {
+        if (!parse_positive(gcPause, n))
+            return false;
+
+        opts.gcPause = (int)n;
+    }
+
+    if (gcStepMul) {
+        if (!parse_positive(gcStepMul, n))
+            return false;
+
+        opts.gcStepMul = (int)n;
     }
 
-    return false;
+    return true;
+}
+
+/**
+ * Returns true if runs with these options are fingerprinted. The output must
+ * be a file for there to be anything to reuse.
+ */
+bool fingerprinted(const Options& opts) {
+    return opts.cacheDir && opts.output && strcmp(opts.output, "-") != 0 &&
+        !opts.memStats;
+}
+
+/**
+ * Returns the allocator of the Lua state, or NULL if it doesn't use one.
+ */
+LuaAllocator* get_allocator(lua_State* L) {
+    void* ud;
+    if (lua_getallocf(L, &ud) != LuaAllocator::alloc)
+        return NULL;
+
+    return (LuaAllocator*)ud;
+}
+
+/**
+ * Starts a new phase for counting allocations.
+ */
+void mem_phase(lua_State* L, const char* name) {
+    if (LuaAllocator* allocator = get_allocator(L))
+        allocator->phase(name);
+}
+
+/**
+ * Prints the memory usage of the Lua state when destroyed.
+ */
+class MemStatsReport {
+private:
+    lua_State* _L;
+    bool _enabled;
+
+public:
+    MemStatsReport(lua_State* L, bool enabled) : _L(L), _enabled(enabled) {}
+
+    ~MemStatsReport() {
+        if (!_enabled)
+            return;
+
+        if (LuaAllocator* allocator = get_allocator(_L))
+            allocator->report(stderr);
+        else
+            fprintf(stderr, "Lua memory usage: %d KiB\n",
+                    lua_gc(_L, LUA_GCCOUNT, 0));
+    }
+};
+
+/**
+ * Configures the garbage collector.
+ */
+void setup_gc(lua_State* L, const Options& opts) {
+#if LUA_VERSION_NUM >= 504
+    if (opts.gcGenerational)
+        lua_gc(L, LUA_GCGEN, 0, 0);
+    else
+        lua_gc(L, LUA_GCINC, opts.gcPause, opts.gcStepMul, 0);
+#else
+    if (opts.gcGenerational)
+        fputs("Warning: generational GC requires Lua 5.4\n", stderr);
+
+    if (opts.gcPause)
+        lua_gc(L, LUA_GCSETPAUSE, opts.gcPause);
+
+    if (opts.gcStepMul)
+        lua_gc(L, LUA_GCSETSTEPMUL, opts.gcStepMul);
+#endif
 }
 
 void print_error(lua_State* L) {
@@ -80,11 +277,42 @@ int rule(lua_State* L) {
     return 0;
 }
 
+int expand_compile(lua_State* L) {
+    buttonlua::Rules* rules = (buttonlua::Rules*)lua_touserdata(L, lua_upvalueindex(1));
+    if (rules)
+        rules->expandCompile(L);
+    return 0;
+}
+
+/**
+ * Replaces the standard dofile() such that scripts are loaded through the
+ * script cache. This also replaces the wrapper installed by init.lua, so the
+ * script is reported as an input here.
+ */
+int dofile(lua_State* L) {
+    ScriptCache* cache = (ScriptCache*)lua_touserdata(L, lua_upvalueindex(1));
+    ImplicitDeps* deps = (ImplicitDeps*)lua_touserdata(L, lua_upvalueindex(2));
+
+    size_t len = 0;
+    const char* path = lua_isnoneornil(L, 1) ? NULL :
+        lua_checkpath(L, 1, &len);
+    lua_settop(L, 1);
+
+    if (path && deps)
+        deps->addInput(path, len);
+
+    if (cache->load(L, path) != LUA_OK)
+        return lua_error(L);
+
+    lua_call(L, 0, LUA_MULTRET);
+    return lua_gettop(L) - 1;
+}
+
 int publish_input(lua_State* L) {
     ImplicitDeps* deps = (ImplicitDeps*)lua_touserdata(L, lua_upvalueindex(1));
 
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     if (deps)
         deps->addInput(path, len);
@@ -92,26 +320,109 @@ int publish_input(lua_State* L) {
     return 0;
 }
 
+/**
+ * Libraries that are opened up front. init.lua modifies some of these.
+ */
+const luaL_Reg eagerLibs[] = {
+    {"_G", luaopen_base},
+    {LUA_LOADLIBNAME, luaopen_package},
+    {LUA_TABLIBNAME, luaopen_table},
+    {LUA_STRLIBNAME, luaopen_string},
+    {LUA_IOLIBNAME, luaopen_io},
+    {LUA_OSLIBNAME, luaopen_os},
+    {LUA_MATHLIBNAME, luaopen_math},
+    {NULL, NULL}
+};
+
+/**
+ * Libraries that are only opened when their global variable is first accessed
+ * or when they are required. Most scripts never need some of these.
+ */
+const luaL_Reg lazyLibs[] = {
+    {LUA_COLIBNAME, luaopen_coroutine},
+    {LUA_DBLIBNAME, luaopen_debug},
+#if LUA_VERSION_NUM >= 503
+    {LUA_UTF8LIBNAME, luaopen_utf8},
+#endif
+    {"path", luaopen_path},
+    {"winpath", luaopen_winpath},
+    {"posixpath", luaopen_posixpath},
+    {"glob", luaopen_glob},
+    {"argv", luaopen_argv},
+    {"fs", luaopen_fs},
+    {"json", luaopen_json},
+    {"hash", luaopen_hash},
+    {NULL, NULL}
+};
+
+/**
+ * The __index metamethod of the global table. Opens a lazy library when its
+ * global variable is accessed for the first time. The library is then stored
+ * in the global table such that this isn't called for it again.
+ *
+ * The first upvalue is a table mapping library names to their open functions.
+ */
+int lazy_global(lua_State* L) {
+    lua_settop(L, 2);
+
+    if (lua_type(L, 2) != LUA_TSTRING)
+        return 0;
+
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+
+    lua_CFunction openf = lua_tocfunction(L, -1);
+    if (!openf)
+        return 0;
+
+    // Reuses the library if it was already loaded with require().
+    luaL_requiref(L, lua_tostring(L, 2), openf, 1);
+    return 1;
 }
 
-namespace buttonlua {
+/**
+ * Opens the standard libraries and the native modules.
+ */
+void open_libs(lua_State* L) {
+    for (const luaL_Reg* lib = eagerLibs; lib->func; ++lib) {
+        luaL_requiref(L, lib->name, lib->func, 1);
+        lua_pop(L, 1);
+    }
 
-int init(lua_State* L) {
+    // Lazy libraries can be loaded with require() or by using their global.
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, "_PRELOAD");
+    lua_newtable(L);
 
-    // Initialize the standard library
-    luaL_openlibs(L);
+    for (const luaL_Reg* lib = lazyLibs; lib->func; ++lib) {
+        lua_pushcfunction(L, lib->func);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -4, lib->name);
+        lua_setfield(L, -2, lib->name);
+    }
 
-    luaL_requiref(L, "path", luaopen_path, 1);
-    lua_pop(L, 1);
+    lua_pushglobaltable(L);
 
-    luaL_requiref(L, "winpath", luaopen_winpath, 1);
-    lua_pop(L, 1);
+    lua_createtable(L, 0, 1);
+    lua_pushvalue(L, -3);
+    lua_pushcclosure(L, lazy_global, 1);
+    lua_setfield(L, -2, "__index");
+    lua_setmetatable(L, -2);
 
-    luaL_requiref(L, "posixpath", luaopen_posixpath, 1);
-    lua_pop(L, 1);
+    lua_pop(L, 3);
+}
 
-    lua_pushcfunction(L, lua_glob);
-    lua_setglobal(L, "glob");
+}
+
+namespace buttonlua {
+
+int init(lua_State* L) {
+
+    // Initialize the standard library and the native modules
+    open_libs(L);
+
+    // Add to the standard table library
+    luaopen_tableext(L);
+    lua_pop(L, 1);
 
     lua_getglobal(L, "package");
     lua_getfield(L, -1, "searchers");
@@ -142,6 +453,54 @@ int init(lua_State* L) {
     return 0;
 }
 
+void setup(lua_State* L, DirCache& dirCache, ThreadPool& pool,
+        ImplicitDeps& deps, ScriptCache& scriptCache, PathTable& pathTable) {
+
+    lua_pushlightuserdata(L, &dirCache);
+    lua_setglobal(L, "__DIR_CACHE");
+
+    lua_pushlightuserdata(L, &pool);
+    lua_setglobal(L, "__THREAD_POOL");
+
+    lua_pushlightuserdata(L, &scriptCache);
+    lua_setglobal(L, "__SCRIPT_CACHE");
+
+    lua_pushlightuserdata(L, &pathTable);
+    lua_setglobal(L, "__PATH_TABLE");
+
+    lua_pushlightuserdata(L, &deps);
+    lua_setglobal(L, "__DEPS");
+
+    // Register dofile() function
+    lua_pushlightuserdata(L, &scriptCache);
+    lua_pushlightuserdata(L, &deps);
+    lua_pushcclosure(L, dofile, 2);
+    lua_setglobal(L, "dofile");
+
+    // Register publish_input() function
+    lua_pushlightuserdata(L, &deps);
+    lua_pushcclosure(L, publish_input, 1);
+    lua_setglobal(L, "publish_input");
+
+    // Register import_all() function
+    lua_pushlightuserdata(L, &deps);
+    lua_pushcclosure(L, lua_import_all, 1);
+    lua_setglobal(L, "import_all");
+}
+
+void setupRules(lua_State* L, Rules& rules) {
+
+    // Register rule() function
+    lua_pushlightuserdata(L, &rules);
+    lua_pushcclosure(L, rule, 1);
+    lua_setglobal(L, "rule");
+
+    // Register expand_compile() function
+    lua_pushlightuserdata(L, &rules);
+    lua_pushcclosure(L, expand_compile, 1);
+    lua_setglobal(L, "expand_compile");
+}
+
 int execute(lua_State* L, int argc, char** argv) {
 
     Options opts;
@@ -152,16 +511,34 @@ int execute(lua_State* L, int argc, char** argv) {
         return 1;
     }
 
+    setup_gc(L, opts);
+
+    MemStatsReport memStats(L, opts.memStats);
+    mem_phase(L, "script");
+
     // Set SCRIPT_DIR to the script's directory.
     Path dirname = Path(opts.script).dirname();
     lua_pushlstring(L, dirname.path, dirname.length);
     lua_setglobal(L, "SCRIPT_DIR");
 
-    if (luaL_loadfile(L, opts.script) != LUA_OK) {
+    ScriptCache scriptCache(opts.cacheDir);
+
+    if (scriptCache.load(L, opts.script) != LUA_OK) {
         print_error(L);
         return 1;
     }
 
+    // Anything modified after this may or may not have been seen by the run.
+    const double start = Fingerprint::now();
+
+    std::unique_ptr<Fingerprint> fingerprint;
+
+    if (fingerprinted(opts)) {
+        // A run that fails part way must never be skipped.
+        fingerprint.reset(new Fingerprint(opts.cacheDir, argc, argv));
+        fingerprint->remove();
+    }
+
     FILE* output;
 
     if (!opts.output || strcmp(opts.output, "-") == 0)
@@ -175,42 +552,84 @@ int execute(lua_State* L, int argc, char** argv) {
     }
 
     ImplicitDeps deps;
-    ThreadPool pool; // TODO: Allow setting pool size from command line
-    Rules rules(output);
     DirCache dirCache(&deps);
+    PathTable pathTable;
 
-    lua_pushlightuserdata(L, &dirCache);
-    lua_setglobal(L, "__DIR_CACHE");
+    if (fingerprint)
+        deps.record();
 
-    lua_pushlightuserdata(L, &pool);
-    lua_setglobal(L, "__THREAD_POOL");
+    // Declared last such that it is destroyed first. Asynchronous globs that
+    // were never awaited may still be using the directory cache.
+    ThreadPool pool(opts.threads ? opts.threads :
+            std::thread::hardware_concurrency());
 
-    // Register publish_input() function
-    lua_pushlightuserdata(L, &deps);
-    lua_pushcclosure(L, publish_input, 1);
-    lua_setglobal(L, "publish_input");
+    if (opts.gitIndex && !dirCache.loadGitIndex(opts.gitIndex)) {
+        fprintf(stderr, "Error: Failed to load git index '%s'\n", opts.gitIndex);
+        return 1;
+    }
 
-    // Register rule() function
-    lua_pushlightuserdata(L, &rules);
-    lua_pushcclosure(L, rule, 1);
-    lua_setglobal(L, "rule");
+    if (opts.manifest && !dirCache.loadManifest(opts.manifest)) {
+        fprintf(stderr, "Error: Failed to load manifest '%s'\n", opts.manifest);
+        return 1;
+    }
 
-    // Pass along the rest of the command line arguments to the Lua script.
-    for (int i = 0; i < args.n; ++i)
-        lua_pushstring(L, args.argv[i]);
+    setup(L, dirCache, pool, deps, scriptCache, pathTable);
 
-    if (lua_pcall(L, args.n, LUA_MULTRET, 0) != LUA_OK) {
-        print_error(L);
-        return 1;
+    {
+        // The output is finished when this goes out of scope.
+        Rules rules(output);
+
+        setupRules(L, rules);
+
+        // Pass along the rest of the command line arguments to the Lua script.
+        for (int i = 0; i < args.n; ++i)
+            lua_pushstring(L, args.argv[i]);
+
+        if (lua_pcall(L, args.n, LUA_MULTRET, 0) != LUA_OK) {
+            print_error(L);
+            return 1;
+        }
+
+        // Shutdown
+        mem_phase(L, "shutdown");
+
+        if (load_shutdown(L) || lua_pcall(L, 0, LUA_MULTRET, 0)) {
+            print_error(L);
+            return 1;
+        }
     }
 
-    // Shutdown
-    if (load_shutdown(L) || lua_pcall(L, 0, LUA_MULTRET, 0)) {
-        print_error(L);
+    if (output != stdout && fclose(output) != 0) {
+        perror("Failed to write output file");
         return 1;
     }
 
+    if (fingerprint)
+        fingerprint->save(scriptCache, deps, dirCache, opts.script,
+                opts.output, start);
+
     return 0;
 }
 
+bool upToDate(int argc, char** argv) {
+
+    Options opts;
+    Args args = {argc-1, argv+1};
+
+    if (!parse_args(opts, args) || !fingerprinted(opts))
+        return false;
+
+    Fingerprint fingerprint(opts.cacheDir, argc, argv);
+
+    ThreadPool pool(opts.threads ? opts.threads :
+            std::thread::hardware_concurrency());
+
+    if (!fingerprint.check(pool))
+        return false;
+
+    ImplicitDeps deps;
+    fingerprint.replay(deps);
+    return true;
+}
+
 }
@@ -10,16 +10,43 @@
 
 #include "lua.hpp"
 
+class DirCache;
+class ThreadPool;
+class ImplicitDeps;
+class ScriptCache;
+class PathTable;
+
 namespace buttonlua {
 
+class Rules;
+
 /**
  * Initializes the Lua state with additional functions and libraries.
  */
 int init(lua_State* L);
 
+/**
+ * Gives the Lua state access to the objects that are shared by all Lua states.
+ * This also registers the functions that depend on them.
+ */
+void setup(lua_State* L, DirCache& dirCache, ThreadPool& pool,
+        ImplicitDeps& deps, ScriptCache& scriptCache, PathTable& pathTable);
+
+/**
+ * Registers the functions that output rules.
+ */
+void setupRules(lua_State* L, Rules& rules);
+
 /**
  * Executes the script given on the command line. Fails if no script is given.
  */
 int execute(lua_State* L, int argc, char **argv);
 
+/**
+ * Returns true if the output of the previous run with the same command line is
+ * still up to date. Its dependencies are then sent to the parent build system
+ * again and there is nothing left to do. This doesn't need a Lua state.
+ */
+bool upToDate(int argc, char** argv);
+
 }
@@ -10,11 +10,14 @@
 
 #include <stdlib.h>
 
+#include <mutex>
+
 #ifdef _WIN32
 
 #include <windows.h>
 
-ImplicitDeps::ImplicitDeps() : _inputs(NULL), _outputs(NULL) {
+ImplicitDeps::ImplicitDeps()
+        : _inputs(NULL), _outputs(NULL), _recording(false) {
 
     static const size_t bufLength = 32;
     char buf[bufLength];
@@ -43,51 +46,19 @@ bool ImplicitDeps::hasParent() const {
     return _inputs != NULL || _outputs != NULL;
 }
 
-void ImplicitDeps::addInput(const Dependency& dep) {
-    if (!_inputs) return;
-
-    DWORD written;
-    WriteFile(_inputs, &dep, sizeof(dep) + dep.length, &written, NULL);
-}
-
-void ImplicitDeps::addOutput(const Dependency& dep) {
-    if (!_outputs) return;
-
-    DWORD written;
-    WriteFile(_outputs, &dep, sizeof(dep) + dep.length, &written, NULL);
-}
-
-void ImplicitDeps::addInput(const char* name, size_t length) {
-    if (!_inputs) return;
-
-    if (length > UINT32_MAX)
-        length = UINT32_MAX;
-
-    Dependency dep = {0};
-    dep.length = (uint32_t)length;
+namespace {
 
+void writeData(void* f, const void* data, size_t length) {
     DWORD written;
-    WriteFile(_inputs, &dep, sizeof(dep), &written, NULL);
-    WriteFile(_inputs, name, dep.length, &written, NULL);
+    WriteFile(f, data, (DWORD)length, &written, NULL);
 }
 
-void ImplicitDeps::addOutput(const char* name, size_t length) {
-    if (!_outputs) return;
-
-    if (length > UINT32_MAX)
-        length = UINT32_MAX;
-
-    Dependency dep = {0};
-    dep.length = (uint32_t)length;
-
-    DWORD written;
-    WriteFile(_outputs, &dep, sizeof(dep), &written, NULL);
-    WriteFile(_outputs, name, dep.length, &written, NULL);
 }
 
 #else // WIN32
 
-ImplicitDeps::ImplicitDeps() : _inputs(NULL), _outputs(NULL) {
+ImplicitDeps::ImplicitDeps()
+        : _inputs(NULL), _outputs(NULL), _recording(false) {
     const char* var;
     int fd;
 
@@ -109,41 +80,102 @@ bool ImplicitDeps::hasParent() const {
     return _inputs != NULL || _outputs != NULL;
 }
 
-void ImplicitDeps::addInput(const Dependency& dep) {
-    if (!_inputs) return;
+namespace {
 
-    fwrite(&dep, sizeof(dep) + dep.length, 1, _inputs);
+void writeData(FILE* f, const void* data, size_t length) {
+    fwrite(data, 1, length, f);
 }
 
-void ImplicitDeps::addOutput(const Dependency& dep) {
-    if (!_outputs) return;
+}
+
+#endif // !_WIN32
 
-    fwrite(&dep, sizeof(dep) + dep.length, 1, _outputs);
+void ImplicitDeps::add(bool input, const Dependency& dep, const char* name) {
+    auto f = input ? _inputs : _outputs;
+
+    if (!f && !_recording) return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (f) {
+        writeData(f, &dep, sizeof(dep));
+        writeData(f, name, dep.length);
+    }
+
+    if (_recording) {
+        std::string& log = input ? _inputLog : _outputLog;
+        log.append((const char*)&dep, sizeof(dep));
+        log.append(name, dep.length);
+    }
 }
 
-void ImplicitDeps::addInput(const char* name, size_t length) {
-    if (!_inputs) return;
+void ImplicitDeps::addInput(const Dependency& dep) {
+    add(true, dep, dep.name);
+}
+
+void ImplicitDeps::addOutput(const Dependency& dep) {
+    add(false, dep, dep.name);
+}
 
+void ImplicitDeps::addInput(const char* name, size_t length) {
     if (length > UINT32_MAX)
         length = UINT32_MAX;
 
     Dependency dep = {0};
     dep.length = (uint32_t)length;
 
-    fwrite(&dep, sizeof(dep), 1, _inputs);
-    fwrite(name, 1, dep.length, _inputs);
+    add(true, dep, name);
 }
 
 void ImplicitDeps::addOutput(const char* name, size_t length) {
-    if (!_outputs) return;
-
     if (length > UINT32_MAX)
         length = UINT32_MAX;
 
     Dependency dep = {0};
     dep.length = (uint32_t)length;
 
-    fwrite(&dep, sizeof(dep), 1, _outputs);
-    fwrite(name, 1, dep.length, _outputs);
+    add(false, dep, name);
+}
+
+bool ImplicitDeps::addName(const char* name, size_t length) {
+    std::lock_guard<std::mutex> lock(_addedMutex);
+    return _added.insert(std::string(name, length)).second;
+}
+
+void ImplicitDeps::addInputOnce(const char* name, size_t length) {
+    if (!_inputs && !_recording) return;
+
+    if (addName(name, length))
+        addInput(name, length);
+}
+
+void ImplicitDeps::addInputOnce(const Dependency& dep) {
+    if (!_inputs && !_recording) return;
+
+    if (addName(dep.name, dep.length))
+        addInput(dep);
+}
+
+void ImplicitDeps::record() {
+    _recording = true;
+}
+
+std::string ImplicitDeps::recordedInputs() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inputLog;
+}
+
+std::string ImplicitDeps::recordedOutputs() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _outputLog;
+}
+
+void ImplicitDeps::replay(const std::string& inputs, const std::string& outputs) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_inputs && !inputs.empty())
+        writeData(_inputs, inputs.data(), inputs.size());
+
+    if (_outputs && !outputs.empty())
+        writeData(_outputs, outputs.data(), outputs.size());
 }
-#endif // !_WIN32
@@ -12,6 +12,10 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
 #ifdef _WIN32
 #   pragma warning(push)
 
@@ -70,6 +74,8 @@ struct Dependency {
  * that can be used to send back dependency information from the child process.
  * This is the generic interface for making implicit inputs and outputs known to
  * the parent build system.
+ *
+ * This is thread safe.
  */
 class ImplicitDeps {
 private:
@@ -82,6 +88,20 @@ private:
     FILE* _outputs;
 #endif
 
+    // Dependencies may be added from multiple threads. Each one must be written
+    // out in one piece.
+    std::mutex _mutex;
+
+    // Names added with addInputOnce.
+    std::unordered_set<std::string> _added;
+    std::mutex _addedMutex;
+
+    // Copies of everything that was added, in the same form that it is sent
+    // in. Only kept if recording.
+    bool _recording;
+    std::string _inputLog;
+    std::string _outputLog;
+
 public:
     ImplicitDeps();
     ~ImplicitDeps();
@@ -102,6 +122,44 @@ public:
      */
     void addInput(const char* name, size_t length);
     void addOutput(const char* name, size_t length);
+
+    /**
+     * Like addInput, but the name is only sent the first time it is given.
+     * Names are compared exactly, so they should be normalized first.
+     */
+    void addInputOnce(const char* name, size_t length);
+    void addInputOnce(const Dependency& dep);
+
+    /**
+     * Starts keeping a copy of every dependency that is added from now on,
+     * whether or not there is a parent build system. This must be called
+     * before any dependencies are added from other threads.
+     */
+    void record();
+
+    /**
+     * Returns the dependencies that were added since record() was called. Each
+     * one is a Dependency immediately followed by its name.
+     */
+    std::string recordedInputs();
+    std::string recordedOutputs();
+
+    /**
+     * Sends dependencies that were recorded by an earlier run to the parent
+     * build system.
+     */
+    void replay(const std::string& inputs, const std::string& outputs);
+
+private:
+    /**
+     * Sends the dependency to the parent build system and records it.
+     */
+    void add(bool input, const Dependency& dep, const char* name);
+
+    /**
+     * Returns true if the name has not been given to addInputOnce before.
+     */
+    bool addName(const char* name, size_t length);
 };
 
 
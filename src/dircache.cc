@@ -13,8 +13,13 @@
 #   include <fcntl.h>
 #endif // _WIN32
 
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
 #include <algorithm>
 #include <utility>
+#include <new>
 
 #include "threadpool.h"
 #include "dircache.h"
@@ -27,6 +32,187 @@ bool operator<(const DirEntry& a, const DirEntry& b) {
 
 namespace {
 
+// Size of the blocks allocated by GlobArena.
+const size_t globArenaBlockSize = 16 * 1024;
+
+/**
+ * Reads an entire file into the given buffer. Returns false on failure.
+ */
+bool readFile(const char* path, std::string& buf) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    char chunk[4096];
+    size_t n;
+
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.append(chunk, n);
+
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+/**
+ * Reports a path whose existence was checked as an input. Whether the path
+ * exists is just as much an input as a listing. A path that doesn't exist is
+ * reported with the status for that rather than as an ordinary input.
+ */
+void addExistenceInput(ImplicitDeps& deps, const std::string& path,
+        bool exists) {
+
+    const auto normalized = Path(path).norm();
+
+    if (exists) {
+        deps.addInputOnce(normalized.data(), normalized.length());
+        return;
+    }
+
+    std::vector<char> buf(sizeof(Dependency) + normalized.length());
+
+    Dependency* dep = (Dependency*)buf.data();
+    dep->status = 1;
+    dep->length = (uint32_t)normalized.length();
+    memcpy(dep->name, normalized.data(), normalized.length());
+
+    deps.addInputOnce(*dep);
+}
+
+/**
+ * Reads a big-endian 32-bit integer.
+ */
+uint32_t readBigEndian32(const char* p) {
+    const unsigned char* u = (const unsigned char*)p;
+    return ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) |
+           ((uint32_t)u[2] << 8)  |  (uint32_t)u[3];
+}
+
+/**
+ * Reads a big-endian 16-bit integer.
+ */
+uint16_t readBigEndian16(const char* p) {
+    const unsigned char* u = (const unsigned char*)p;
+    return (uint16_t)(((uint16_t)u[0] << 8) | u[1]);
+}
+
+/**
+ * A single path parsed from a git index or manifest.
+ */
+struct TrackedPath {
+    std::string path;
+    bool isDir;
+};
+
+/**
+ * Parses a git index file. Versions 2, 3, and 4 are supported. See
+ * Documentation/technical/index-format.txt in the git source for details.
+ */
+bool parseGitIndex(const std::string& data, std::vector<TrackedPath>& paths) {
+
+    // Size of the fixed part of an index entry up to (and including) the flags.
+    const size_t entrySize = 62;
+
+    if (data.size() < 12 || data.compare(0, 4, "DIRC") != 0)
+        return false;
+
+    const uint32_t version = readBigEndian32(data.data() + 4);
+    const uint32_t count   = readBigEndian32(data.data() + 8);
+
+    if (version < 2 || version > 4)
+        return false;
+
+    const char* p   = data.data() + 12;
+    const char* end = data.data() + data.size();
+
+    // The previous path. Version 4 paths are prefix-compressed relative to it.
+    std::string name;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const char* entry = p;
+
+        if ((size_t)(end - p) < entrySize)
+            return false;
+
+        const uint32_t mode  = readBigEndian32(p + 24);
+        const uint16_t flags = readBigEndian16(p + 60);
+
+        p += entrySize;
+
+        // Version 3 and above can have extended flags.
+        if (version >= 3 && (flags & 0x4000))
+            p += 2;
+
+        if (version == 4) {
+            // Number of bytes to remove from the end of the previous path.
+            size_t strip = 0;
+            unsigned char c;
+
+            do {
+                if (p >= end) return false;
+                c = (unsigned char)*p++;
+                strip = (strip << 7) | (c & 0x7f);
+                if (c & 0x80) ++strip;
+            } while (c & 0x80);
+
+            if (strip > name.size())
+                return false;
+
+            name.resize(name.size() - strip);
+        }
+        else {
+            name.clear();
+        }
+
+        const char* nul = (const char*)memchr(p, '\0', end - p);
+        if (!nul) return false;
+
+        name.append(p, nul);
+        p = nul + 1;
+
+        // Versions before 4 pad each entry with 1 to 8 NUL bytes such that
+        // its length is a multiple of 8.
+        if (version < 4)
+            p = entry + ((p - entry + 7) & ~(size_t)7);
+
+        if (p > end)
+            return false;
+
+        // Gitlinks (submodules) and sparse directory entries are directories.
+        const uint32_t type = mode & 0170000;
+        const bool isDir = type == 0160000 || type == 0040000;
+
+        paths.push_back(TrackedPath {name, isDir});
+    }
+
+    return true;
+}
+
+/**
+ * Parses a list of paths separated by new lines.
+ */
+void parseManifest(const std::string& data, std::vector<TrackedPath>& paths) {
+    size_t start = 0;
+
+    while (start < data.size()) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos)
+            end = data.size();
+
+        size_t len = end - start;
+
+        // Handle Windows line endings.
+        if (len > 0 && data[start + len - 1] == '\r')
+            --len;
+
+        if (len > 0) {
+            const bool isDir = Path::isSep(data[start + len - 1]);
+            paths.push_back(TrackedPath {data.substr(start, len), isDir});
+        }
+
+        start = end + 1;
+    }
+}
+
 /**
  * Returns true if a NULL-terminated path is "." or "..".
  */
@@ -129,30 +315,139 @@ DirEntries dirEntries(const std::string& path) {
     return entries;
 }
 
-enum class PathType {
-    // The path type is unknown.
-    unknown,
+}
 
-    // The path exists refers to a file.
-    file,
+DirCache::DirCache(ImplicitDeps* deps)
+        : _deps(deps), _inMemory(false) {
+}
 
-    // The path exists and refers to a directory.
-    dir,
-};
+DirCache::~DirCache() {
+}
+
+const DirEntries& DirCache::dirEntries(Path root, Path dir) {
+    // Reuse the buffer for joining paths. This is called for every directory
+    // visited by a glob.
+    static thread_local std::string buf;
+    buf.assign(root.path, root.length);
+    dir.join(buf);
+    return dirEntries(buf);
+}
+
+size_t DirCache::cachedSize(Path root, Path dir) {
+    static thread_local std::string buf;
+    buf.assign(root.path, root.length);
+    dir.join(buf);
+
+    static thread_local std::string normalized;
+    normalized.clear();
+    Path(buf).norm(normalized);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto it = _cache.find(normalized);
+    if (it != _cache.end())
+        return it->second.size();
+
+    // Directories missing from the index or manifest are empty.
+    return _inMemory ? 0 : SIZE_MAX;
+}
+
+const DirEntry* DirCache::find(Path root, Path path) {
+    static thread_local std::string buf;
+    buf.assign(root.path, root.length);
+    path.join(buf);
+
+    static thread_local std::string normalized;
+    normalized.clear();
+    Path(buf).norm(normalized);
+
+    const Path p(normalized);
+    const auto s = p.split();
+
+    // These have no entry in a directory listing, but always exist. After
+    // normalization, ".." can only be at the start of the path.
+    if (p.isDot() || p.isRoot() || s.tail.isDotDot()) {
+        static const DirEntry dir = {".", true};
+        return &dir;
+    }
+
+    const DirEntries& entries = dirEntries(
+            s.head.length ? s.head.copy() : std::string("."));
+
+    const auto it = std::lower_bound(entries.begin(), entries.end(), s.tail,
+            [](const DirEntry& e, Path name) {
+                return e.name.compare(0, e.name.length(), name.path,
+                        name.length) < 0;
+            });
+
+    if (it != entries.end() &&
+            it->name.compare(0, it->name.length(), s.tail.path,
+                s.tail.length) == 0)
+        return &*it;
+
+    return NULL;
+}
+
+const DirEntries& DirCache::dirEntries(const std::string& path) {
+
+    auto normalized = Path(path).norm();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Did we already do the work?
+    const auto it = _cache.find(normalized);
+    if (it != _cache.end())
+        return it->second;
+
+    // Directories that are not in the index or manifest don't exist as far as
+    // we are concerned.
+    if (_inMemory) {
+        static const DirEntries empty;
+        return empty;
+    }
+
+    if (_deps) _deps->addInput(normalized.data(), normalized.length());
+
+    // List the directories, cache it, and return the cached list.
+    return _cache.insert(
+            std::pair<std::string, DirEntries>(normalized, ::dirEntries(normalized))
+            ).first->second;
+}
+
+
+DirCache::PathType DirCache::pathType(Path root, Path path) {
+    std::string buf(root.path, root.length);
+    path.join(buf);
+
+    if (_inMemory) {
+        // Look up the name in the parent directory's listing.
+        const auto normalized = Path(buf).norm();
+        const auto s = Path(normalized).split();
+
+        const DirEntries& entries = dirEntries(s.head.length ? s.head.copy() : ".");
+
+        const auto name = s.tail.copy();
+
+        auto it = std::lower_bound(entries.begin(), entries.end(),
+                DirEntry {name, false});
+
+        if (it != entries.end() && it->name == name)
+            return it->isDir ? PathType::dir : PathType::file;
+
+        return PathType::unknown;
+    }
 
-/**
- * Returns the type of a given path. That is, if it exists, if it's a directory,
- * or if it's a file.
- */
-PathType pathType(const std::string& path) {
 #ifdef _WIN32
 
     // Convert path to UTF-16
     std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-    std::wstring widePath = converter.from_bytes(path);
+    std::wstring widePath = converter.from_bytes(buf);
 
     DWORD attribs = GetFileAttributesW(widePath.c_str());
 
+    if (_deps)
+        addExistenceInput(*_deps, buf, attribs != INVALID_FILE_ATTRIBUTES);
+
     if (attribs == INVALID_FILE_ATTRIBUTES)
         return PathType::unknown;
 
@@ -166,7 +461,12 @@ PathType pathType(const std::string& path) {
 
     struct stat statbuf;
 
-    if (lstat(path.c_str(), &statbuf) != 0)
+    const bool exists = lstat(buf.c_str(), &statbuf) == 0;
+
+    if (_deps)
+        addExistenceInput(*_deps, buf, exists);
+
+    if (!exists)
         return PathType::unknown;
 
     switch (statbuf.st_mode & S_IFMT) {
@@ -179,178 +479,230 @@ PathType pathType(const std::string& path) {
 #endif // _WIN32
 }
 
-PathType pathType(const Path root, const Path path) {
-    std::string buf(root.path, root.length);
-    path.join(buf);
-    return pathType(buf);
-}
+FileStat DirCache::statInput(Path root, Path path) {
+    if (_deps) {
+        std::string buf(root.path, root.length);
+        path.join(buf);
 
-/**
- * Returns true if the given string contains a glob pattern.
- */
-inline bool isGlobPattern(const Path& p) {
-    for (size_t i = 0; i < p.length; ++i) {
-        switch (p.path[i]) {
-            case '?':
-            case '*':
-            case '[':
-                return true;
-        }
+        const auto normalized = Path(buf).norm();
+        _deps->addInputOnce(normalized.data(), normalized.length());
     }
 
-    return false;
+    return fileStat(root, path);
 }
 
-/**
- * Returns true if the given path element is a recursive glob pattern.
- */
-inline bool isRecursiveGlob(const Path& p) {
-    return p.length == 2 && p.path[0] == '*' && p.path[1] == '*';
+FileStat DirCache::fileStat(Path root, Path path) {
+    // This is called for many files in a row from the same thread.
+    static thread_local std::string buf;
+    buf.assign(root.path, root.length);
+    path.join(buf);
+
+    FileStat st = {-1, 0};
+
+#if defined(_WIN32)
+
+    // Convert path to UTF-16
+    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+    std::wstring widePath = converter.from_bytes(buf);
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (GetFileAttributesExW(widePath.c_str(), GetFileExInfoStandard, &data)) {
+        st.size = ((int64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+
+        // Convert from 100ns intervals since 1601 to seconds since 1970.
+        const uint64_t t = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) |
+            data.ftLastWriteTime.dwLowDateTime;
+        st.mtime = (double)t / 1e7 - 11644473600.0;
+    }
+
+#elif defined(STATX_BASIC_STATS)
+
+    // Only ask for what we need. Don't force a sync with a remote file system
+    // either.
+    struct statx statbuf;
+
+    if (statx(AT_FDCWD, buf.c_str(), AT_STATX_DONT_SYNC,
+                STATX_SIZE | STATX_MTIME, &statbuf) == 0) {
+        st.size = (int64_t)statbuf.stx_size;
+        st.mtime = (double)statbuf.stx_mtime.tv_sec +
+            (double)statbuf.stx_mtime.tv_nsec / 1e9;
+    }
+
+#else
+
+    struct stat statbuf;
+
+    if (stat(buf.c_str(), &statbuf) == 0) {
+        st.size = (int64_t)statbuf.st_size;
+        st.mtime = (double)statbuf.st_mtime;
+    }
+
+#endif
+
+    return st;
 }
 
+void GlobNode::path(std::string& buf) const {
+    if (parent) parent->path(buf);
+    buf.append(suffix, length);
 }
 
-DirCache::DirCache(ImplicitDeps* deps)
-        : _deps(deps) {
+GlobArena::GlobArena() : _next(NULL), _left(0) {
 }
 
-DirCache::~DirCache() {
+GlobArena::~GlobArena() {
+    for (auto block: _blocks)
+        delete [] block;
 }
 
-const DirEntries& DirCache::dirEntries(Path root, Path dir) {
-    std::string buf(root.path, root.length);
-    dir.join(buf);
-    return dirEntries(buf);
+GlobNode* GlobArena::node(const GlobNode* parent, const char* suffix,
+        size_t length, size_t index, size_t depth) {
+
+    // Round up such that the next node is suitably aligned.
+    const size_t align = alignof(GlobNode);
+    const size_t size = (sizeof(GlobNode) + length + align - 1) & ~(align - 1);
+
+    char* p;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (size > _left) {
+            // Start a new block. Very long paths get a block of their own.
+            const size_t blockSize = std::max(size, globArenaBlockSize);
+            _blocks.push_back(new char[blockSize]);
+            _next = _blocks.back();
+            _left = blockSize;
+        }
+
+        p = _next;
+        _next += size;
+        _left -= size;
+    }
+
+    char* name = p + sizeof(GlobNode);
+    memcpy(name, suffix, length);
+
+    GlobNode* node = new (p) GlobNode;
+    node->parent = parent;
+    node->suffix = name;
+    node->length = length;
+    node->index = index;
+    node->depth = depth;
+    node->next = NULL;
+    return node;
 }
 
-const DirEntries& DirCache::dirEntries(const std::string& path) {
+bool DirCache::loadGitIndex(const char* path) {
+    std::string data;
+    std::vector<TrackedPath> paths;
 
-    auto normalized = Path(path).norm();
+    if (!readFile(path, data) || !parseGitIndex(data, paths))
+        return false;
 
     std::lock_guard<std::mutex> lock(_mutex);
 
-    // Did we already do the work?
-    const auto it = _cache.find(normalized);
-    if (it != _cache.end())
-        return it->second;
-
-    if (_deps) _deps->addInput(normalized.data(), normalized.length());
+    for (auto&& p: paths)
+        addPath(Path(p.path).norm(), p.isDir);
 
-    // List the directories, cache it, and return the cached list.
-    return _cache.insert(
-            std::pair<std::string, DirEntries>(normalized, ::dirEntries(normalized))
-            ).first->second;
+    finishLoading(path);
+    return true;
 }
 
-void DirCache::glob(Path root, Path path, MatchCallback callback, ThreadPool* pool) {
+bool DirCache::loadManifest(const char* path) {
+    std::string data;
+    std::vector<TrackedPath> paths;
 
-    bool onlyMatchDirs = path.basename().length == 0;
+    if (!readFile(path, data))
+        return false;
 
-    auto components = path.components();
+    parseManifest(data, paths);
 
-    std::string buf;
+    std::lock_guard<std::mutex> lock(_mutex);
 
-    globImpl(root, buf, components, 0, onlyMatchDirs, callback, pool);
+    for (auto&& p: paths)
+        addPath(Path(p.path).norm(), p.isDir);
 
-    if (pool) pool->waitAll();
+    finishLoading(path);
+    return true;
 }
 
-void DirCache::globImpl(Path root, std::string& path,
-        const std::vector<Path>& components, size_t index,
-        bool matchDirs, MatchCallback callback, ThreadPool* pool) {
-
-    if (index >= components.size()) return;
+void DirCache::addPath(const std::string& path, bool isDir) {
+    const auto s = Path(path).split();
 
-    const Path& pattern = components[index];
+    // The path is a root or "." and has no parent.
+    if (!s.tail.length || s.tail.isDot())
+        return;
 
-    // We only want to use the callback if this is the last thing to match.
-    const bool lastOne = index == components.size()-1;
+    std::string dir = s.head.length ? s.head.copy() : ".";
 
-    const size_t pathLength = path.size();
+    auto it = _cache.find(dir);
+    const bool newDir = it == _cache.end();
 
-    if (isRecursiveGlob(pattern)) {
-        // A recursive glob can match 0 or more directories. Lets assume here it
-        // will match 0 directories. Note that this will cause the same
-        // directory to be listed twice. This should be okay since we are
-        // caching directory listing results.
-        queueGlob(root, path, components, index+1, matchDirs, callback, pool);
+    if (newDir)
+        it = _cache.insert(std::make_pair(dir, DirEntries())).first;
 
-        // We also want to continue on here attempting to match more than 0
-        // directories.
-        for (auto&& entry: dirEntries(root, path)) {
+    it->second.push_back(DirEntry {s.tail.copy(), isDir});
 
-            Path(entry.name).join(path);
+    // If we haven't seen the parent directory before, then it hasn't been
+    // added to its own parent yet either.
+    if (newDir)
+        addPath(dir, true);
+}
 
-            if (lastOne && entry.isDir == matchDirs) {
-                // Note that "**" matches all files recursively and "**/"
-                // matches all directories recursively. Thus, we yield this
-                // path if this is the last pattern in the list and we've found
-                // the type of entry we're looking for.
-                callback(path);
-            }
+void DirCache::finishLoading(const char* source) {
+    for (auto&& dir: _cache) {
+        DirEntries& entries = dir.second;
 
-            if (entry.isDir) {
-                // We can match 0 or more directories. Go deeper!
-                queueGlob(root, path, components, index, matchDirs, callback,
-                        pool);
-            }
+        std::sort(entries.begin(), entries.end());
 
-            path.resize(pathLength);
-        }
+        // The same directory can get added many times. Conflicted files can
+        // also appear more than once in a git index.
+        entries.erase(std::unique(entries.begin(), entries.end(),
+                    [] (const DirEntry& a, const DirEntry& b) {
+                        return a.name == b.name && a.isDir == b.isDir;
+                    }), entries.end());
     }
-    else if (isGlobPattern(pattern)) {
-        for (auto&& entry: dirEntries(root, path)) {
-            const Path name = Path(entry.name);
 
-            if (!name.matches(pattern)) continue;
+    _inMemory = true;
 
-            name.join(path);
+    // The index is the only thing we depend on now.
+    if (_deps) _deps->addInput(source, strlen(source));
+}
 
-            if (lastOne) {
-                if (entry.isDir == matchDirs)
-                    callback(path);
-            }
-            else if (entry.isDir) {
-                // It's a directory and it matched. Shift the pattern.
-                queueGlob(root, path, components, index+1, matchDirs, callback,
-                        pool);
-            }
+void DirCache::eachListing(
+        const std::function<void(const std::string&, const DirEntries&)>& f) {
 
-            path.resize(pathLength);
-        }
-    }
-    else {
-        Path(pattern).join(path);
-
-        if (lastOne) {
-            // The explicitly named path must exist in order to be returned.
-            PathType type = pathType(root, path);
-            if (( matchDirs && type == PathType::dir) ||
-                (!matchDirs && type == PathType::file)) {
-                callback(path);
-            }
-        }
-        else {
-            // Assume it's a directory and go deeper
-            queueGlob(root, path, components, index+1, matchDirs, callback,
-                    pool);
-        }
+    std::lock_guard<std::mutex> lock(_mutex);
 
-        path.resize(pathLength);
-    }
+    if (_inMemory)
+        return;
+
+    for (auto&& dir: _cache)
+        f(dir.first, dir.second);
 }
 
-void DirCache::queueGlob(Path root, std::string& path,
-        const std::vector<Path>& components, size_t index,
-        bool matchDirs, MatchCallback callback,
-        ThreadPool* pool) {
-    if (pool) {
-        pool->enqueueTask([this, root, path, &components, index, matchDirs, callback, pool] {
-                globImpl(root, (std::string&)path, components, index, matchDirs,
-                        callback, pool);
-                });
-    }
-    else {
-        globImpl(root, path, components, index, matchDirs, callback, pool);
-    }
+const IgnoreRules& DirCache::ignoreFile(const std::string& path) {
+
+    auto normalized = Path(path).norm();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto it = _ignoreFiles.find(normalized);
+    if (it != _ignoreFiles.end())
+        return *it->second;
+
+    if (_deps) _deps->addInput(normalized.data(), normalized.length());
+
+    std::unique_ptr<IgnoreRules> rules(new IgnoreRules(
+                Path(normalized).dirname()));
+
+    std::string contents;
+    if (readFile(normalized.c_str(), contents))
+        rules->parse(contents);
+
+    return *_ignoreFiles.insert(
+            std::make_pair(normalized, std::move(rules))
+            ).first->second;
 }
@@ -14,11 +14,16 @@
 #include <vector>
 #include <mutex>
 #include <functional>
+#include <type_traits>
+#include <memory>
+
+#include <stdint.h>
 
 #include "path.h"
+#include "threadpool.h"
+#include "ignore.h"
 
 class ImplicitDeps;
-class ThreadPool;
 
 struct DirEntry {
     std::string name;
@@ -30,9 +35,110 @@ struct DirEntry {
 
 typedef std::vector<DirEntry> DirEntries;
 
-// Called with the matched path.
+/**
+ * Metadata about a file.
+ */
+struct FileStat {
+    // Size of the file in bytes. -1 if the file could not be found.
+    int64_t size;
+
+    // Modification time in seconds since the epoch.
+    double mtime;
+};
+
+// Called with the matched path. Any callable object that accepts a Path can be
+// used as a glob visitor. This is just the type-erased version.
 using MatchCallback = std::function<void(Path)>;
 
+/**
+ * Options for restricting what a glob searches.
+ */
+struct GlobOptions {
+    // Paths matching any of these rules are skipped. Ignored directories are
+    // never listed.
+    std::vector<const IgnoreRules*> ignore;
+
+    // Maximum number of directories below the root to descend into. With 0,
+    // only the root directory is searched.
+    size_t maxDepth;
+
+    GlobOptions() : maxDepth(SIZE_MAX) {}
+
+    /**
+     * Returns true if the given path, relative to the glob root, should be
+     * skipped.
+     */
+    bool ignored(Path root, Path path, Path name, bool isDir) const {
+        for (auto rules: ignore) {
+            if (rules->ignored(root, path, name, isDir))
+                return true;
+        }
+
+        return false;
+    }
+};
+
+/**
+ * A directory that is queued to be searched by a glob task. Instead of each
+ * task holding a copy of the full path, it only holds a pointer to one of
+ * these. The full path is recovered by walking up the parents. Thus, sibling
+ * tasks share their parent's prefix.
+ */
+struct GlobNode {
+    // The node this one is relative to. NULL if this is the first one.
+    const GlobNode* parent;
+
+    // The part of the path after the parent's path (including any separator).
+    const char* suffix;
+    size_t length;
+
+    // The index of the pattern component to match next.
+    size_t index;
+
+    // Number of directories below the glob root.
+    size_t depth;
+
+    // The next directory to search in the same task, if any.
+    const GlobNode* next;
+
+    /**
+     * Appends the full path of this node to the given buffer.
+     */
+    void path(std::string& buf) const;
+};
+
+/**
+ * Allocates glob nodes for the duration of a single glob. Nodes are never
+ * freed individually. Instead, all nodes are freed at once when the arena is
+ * destroyed.
+ *
+ * This is thread safe.
+ */
+class GlobArena {
+private:
+    std::mutex _mutex;
+
+    // Blocks of memory that have been allocated.
+    std::vector<char*> _blocks;
+
+    // Next free byte in the current block and how many are left in it.
+    char* _next;
+    size_t _left;
+
+public:
+    GlobArena();
+    ~GlobArena();
+
+    GlobArena(const GlobArena&) = delete;
+    GlobArena& operator=(const GlobArena&) = delete;
+
+    /**
+     * Creates a new node. The suffix is copied into the arena.
+     */
+    GlobNode* node(const GlobNode* parent, const char* suffix,
+            size_t length, size_t index, size_t depth);
+};
+
 /**
  * A cache for directory listings.
  */
@@ -46,6 +152,13 @@ private:
     // Mutex protects the cache.
     std::mutex _mutex;
 
+    // Compiled ignore files.
+    std::map<std::string, std::unique_ptr<IgnoreRules>> _ignoreFiles;
+
+    // True if the cache was populated from a git index or manifest file. In
+    // that case, the file system is never consulted.
+    bool _inMemory;
+
 public:
     DirCache(ImplicitDeps* deps = nullptr);
     virtual ~DirCache();
@@ -64,42 +177,441 @@ public:
      */
     const DirEntries& dirEntries(Path root, Path dir);
 
+    /**
+     * Returns the number of entries in the directory formed by joining the two
+     * paths if it has already been listed. Otherwise, returns SIZE_MAX. This
+     * never touches the file system.
+     *
+     * This function is thread safe.
+     */
+    size_t cachedSize(Path root, Path dir);
+
+    /**
+     * Looks up the path formed by joining the two paths in the listing of its
+     * parent directory. Returns NULL if there is no such entry. Only the parent
+     * directory is listed (and reported as a dependency), so looking up many
+     * paths in the same directory touches the file system once. Symbolic links
+     * are not followed.
+     *
+     * This function is thread safe.
+     */
+    const DirEntry* find(Path root, Path path);
+
+    /**
+     * Populates the cache from a git index file (e.g., ".git/index"). After
+     * this, all directory listings are answered from memory and only contain
+     * tracked files. Instead of every directory, only the index file is
+     * reported as a dependency.
+     *
+     * Paths in the index are assumed to be relative to the current working
+     * directory. Returns false if the file could not be read or parsed.
+     */
+    bool loadGitIndex(const char* path);
+
+    /**
+     * Like loadGitIndex, but the file is a list of paths separated by new
+     * lines. Paths ending with a separator are treated as directories.
+     */
+    bool loadManifest(const char* path);
+
+    /**
+     * Returns the compiled rules from an ignore file (e.g., ".gitignore"). The
+     * file is only read and compiled once. If it doesn't exist, there are no
+     * rules. Either way, it is reported as a dependency.
+     *
+     * This function is thread safe.
+     */
+    const IgnoreRules& ignoreFile(const std::string& path);
+
+    /**
+     * Calls the function with each directory that was listed from the file
+     * system, in sorted order. Listings from a git index or manifest are
+     * skipped since they only depend on that file.
+     *
+     * This function is thread safe, but the function must not use the cache.
+     */
+    void eachListing(
+            const std::function<void(const std::string&, const DirEntries&)>& f);
+
+    /**
+     * Gets the size and modification time of the path formed by joining the
+     * two paths. Symbolic links are followed. Uses statx where available.
+     *
+     * This function is thread safe.
+     */
+    static FileStat fileStat(Path root, Path path);
+
+    /**
+     * Like fileStat, but also reports the path as an input since whatever is
+     * done with its metadata depends on it.
+     *
+     * This function is thread safe.
+     */
+    FileStat statInput(Path root, Path path);
+
     /**
      * Globs for files starting at the given root.
      *
      * Parameters:
-     *   root     = The root directory to start searching from. All matched
-     *              paths are relative to this directory.
-     *   path     = The path which can contain glob patterns. Recursive glob
-     *              expressions are also supported.
-     *   callback = The function to call for every matched file name.
-     *   pool     = Thread pool to use for evaluating glob expressions. If NULL,
-     *              all expressions are evaluated serially which can actually be
-     *              faster in some cases.
+     *   root    = The root directory to start searching from. All matched
+     *             paths are relative to this directory.
+     *   path    = The path which can contain glob patterns. Recursive glob
+     *             expressions are also supported.
+     *   visitor = The function to call for every matched file name. If a
+     *             thread pool is given, this may be called from multiple
+     *             threads at once.
+     *   pool    = Thread pool to use for evaluating glob expressions. If NULL,
+     *             all expressions are evaluated serially. Otherwise, small
+     *             directories that are already cached are still searched
+     *             inline and the rest are batched into tasks.
+     *   options = Paths to ignore and how deep to search.
      */
-    void glob(Path root, Path path, MatchCallback callback, ThreadPool* pool = nullptr);
+    template<class Visitor>
+    void glob(Path root, Path path, Visitor&& visitor, ThreadPool* pool = nullptr,
+            const GlobOptions& options = GlobOptions());
 
 private:
 
+    enum class PathType {
+        // The path type is unknown.
+        unknown,
+
+        // The path exists refers to a file.
+        file,
+
+        // The path exists and refers to a directory.
+        dir,
+    };
+
+    /**
+     * Returns the type of the path formed by joining the two paths.
+     */
+    PathType pathType(Path root, Path path);
+
+    // Adds a normalized path to the in-memory directory tree.
+    void addPath(const std::string& path, bool isDir);
+
+    // Sorts the in-memory directory listings after they have all been added.
+    void finishLoading(const char* source);
+
+    /**
+     * Returns true if the given string contains a glob pattern.
+     */
+    static bool isGlobPattern(const Path& p) {
+        for (size_t i = 0; i < p.length; ++i) {
+            switch (p.path[i]) {
+                case '?':
+                case '*':
+                case '[':
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Returns true if the given path element is a recursive glob pattern.
+     */
+    static bool isRecursiveGlob(const Path& p) {
+        return p.length == 2 && p.path[0] == '*' && p.path[1] == '*';
+    }
+
+    // Estimated cost of searching a directory that is not yet cached. This is
+    // in the same units as the number of entries in a cached directory.
+    static const size_t globListCost = 64;
+
+    // Directories that cost less than this are searched right away instead of
+    // in a separate task.
+    static const size_t globInlineCost = 32;
+
+    // Queued directories are batched until their total cost reaches this.
+    static const size_t globTaskCost = 256;
+
+    /**
+     * State shared by all tasks of a single glob.
+     */
+    template<class Visitor>
+    struct GlobState {
+        DirCache* cache;
+
+        // Root from which all matched paths are relative.
+        Path root;
+
+        // Path components of the pattern.
+        std::vector<Path> components;
+
+        // Only match directories.
+        bool matchDirs;
+
+        // Function to call for every match.
+        Visitor& visitor;
+
+        // Tasks of this glob. If null, the glob is done serially.
+        TaskGroup* group;
+
+        const GlobOptions& options;
+
+        // Storage for the directories queued in the thread pool.
+        GlobArena arena;
+
+        GlobState(DirCache* cache, Path root, Path path, Visitor& visitor,
+                TaskGroup* group, const GlobOptions& options)
+            : cache(cache), root(root), components(path.components()),
+              matchDirs(path.basename().length == 0), visitor(visitor),
+              group(group), options(options) {}
+    };
+
+    /**
+     * Directories that are waiting to be queued together as a single task.
+     */
+    struct GlobBatch {
+        const GlobNode* head;
+        size_t cost;
+
+        GlobBatch() : head(nullptr), cost(0) {}
+    };
+
+    template<class Visitor>
     void globImpl(
-            Path root, // Root from which all matched paths are relative.
+            GlobState<Visitor>& state,
+            const GlobNode* base, // The queued directory we started from.
+            size_t baseLength, // Length of the base directory's path.
             std::string& path, // The directory path we've matched so far.
-            const std::vector<Path>& components, // Path components of the pattern.
             size_t index, // Current component we're trying to match.
-            bool matchDirs, // Only match directories.
-            MatchCallback callback, // Function to call for every match
-            ThreadPool* pool
+            size_t depth // Number of directories below the root.
             );
 
     // Helper function to run an asynchronous glob using the thread pool (if
-    // any).
+    // any). Depending on the estimated cost, the directory is either searched
+    // right away or added to the batch.
+    template<class Visitor>
     void queueGlob(
-            Path root,
+            GlobState<Visitor>& state,
+            GlobBatch& batch,
+            const GlobNode* base,
+            size_t baseLength,
             std::string& path,
-            const std::vector<Path>& components,
             size_t index,
-            bool matchDirs,
-            MatchCallback callback,
-            ThreadPool* pool
+            size_t depth,
+            size_t size = SIZE_MAX // Number of directory entries, if known.
             );
+
+    // Queues all directories in the batch as a single task.
+    template<class Visitor>
+    void flushGlob(GlobState<Visitor>& state, GlobBatch& batch);
+
+    // Runs a glob for a batch of nodes that was queued in the thread pool.
+    template<class Visitor>
+    void globTask(GlobState<Visitor>& state, const GlobNode* node);
 };
+
+template<class Visitor>
+void DirCache::glob(Path root, Path path, Visitor&& visitor, ThreadPool* pool,
+        const GlobOptions& options) {
+
+    typedef typename std::remove_reference<Visitor>::type V;
+
+    std::string buf;
+
+    if (pool) {
+        GlobState<V> state(this, root, path, visitor, nullptr, options);
+
+        // Only wait for the tasks of this glob. The calling thread helps out
+        // while it waits. Must be declared after the state such that it waits
+        // for the tasks before the state is destroyed, even if an exception is
+        // thrown.
+        TaskGroup group(*pool);
+        state.group = &group;
+
+        globImpl(state, nullptr, 0, buf, 0, 0);
+
+        group.wait();
+    }
+    else {
+        GlobState<V> state(this, root, path, visitor, nullptr, options);
+
+        globImpl(state, nullptr, 0, buf, 0, 0);
+    }
+}
+
+template<class Visitor>
+void DirCache::globImpl(GlobState<Visitor>& state, const GlobNode* base,
+        size_t baseLength, std::string& path, size_t index, size_t depth) {
+
+    const std::vector<Path>& components = state.components;
+
+    const GlobOptions& options = state.options;
+
+    // Can we go any deeper?
+    const bool descend = depth < options.maxDepth;
+
+    if (index >= components.size()) return;
+
+    const Path& pattern = components[index];
+
+    // We only want to use the visitor if this is the last thing to match.
+    const bool lastOne = index == components.size()-1;
+
+    const bool matchDirs = state.matchDirs;
+
+    const size_t pathLength = path.size();
+
+    // Subdirectories to be queued as a single task.
+    GlobBatch batch;
+
+    if (isRecursiveGlob(pattern)) {
+        const DirEntries& entries = dirEntries(state.root, path);
+
+        // A recursive glob can match 0 or more directories. Lets assume here it
+        // will match 0 directories. Note that this will cause the same
+        // directory to be listed twice. This should be okay since we are
+        // caching directory listing results.
+        queueGlob(state, batch, base, baseLength, path, index+1, depth,
+                entries.size());
+
+        // We also want to continue on here attempting to match more than 0
+        // directories.
+        for (auto&& entry: entries) {
+
+            const Path name = Path(entry.name);
+
+            name.join(path);
+
+            // Skipping ignored directories here means they never get listed.
+            if (options.ignored(state.root, path, name, entry.isDir)) {
+                path.resize(pathLength);
+                continue;
+            }
+
+            if (lastOne && entry.isDir == matchDirs) {
+                // Note that "**" matches all files recursively and "**/"
+                // matches all directories recursively. Thus, we yield this
+                // path if this is the last pattern in the list and we've found
+                // the type of entry we're looking for.
+                state.visitor(Path(path));
+            }
+
+            if (entry.isDir && descend) {
+                // We can match 0 or more directories. Go deeper!
+                queueGlob(state, batch, base, baseLength, path, index, depth+1);
+            }
+
+            path.resize(pathLength);
+        }
+    }
+    else if (isGlobPattern(pattern)) {
+        for (auto&& entry: dirEntries(state.root, path)) {
+            const Path name = Path(entry.name);
+
+            if (!name.matches(pattern)) continue;
+
+            name.join(path);
+
+            if (options.ignored(state.root, path, name, entry.isDir)) {
+                // Skip it.
+            }
+            else if (lastOne) {
+                if (entry.isDir == matchDirs)
+                    state.visitor(Path(path));
+            }
+            else if (entry.isDir && descend) {
+                // It's a directory and it matched. Shift the pattern.
+                queueGlob(state, batch, base, baseLength, path, index+1,
+                        depth+1);
+            }
+
+            path.resize(pathLength);
+        }
+    }
+    else {
+        Path(pattern).join(path);
+
+        if (lastOne) {
+            // The explicitly named path must exist in order to be returned.
+            PathType type = pathType(state.root, path);
+            if (( matchDirs && type == PathType::dir) ||
+                (!matchDirs && type == PathType::file)) {
+                if (!options.ignored(state.root, path, pattern, matchDirs))
+                    state.visitor(Path(path));
+            }
+        }
+        else if (descend && !options.ignored(state.root, path, pattern, true)) {
+            // Assume it's a directory and go deeper. Note that "." doesn't
+            // take us any deeper.
+            queueGlob(state, batch, base, baseLength, path, index+1,
+                    pattern.isDot() ? depth : depth+1);
+        }
+
+        path.resize(pathLength);
+    }
+
+    flushGlob(state, batch);
+}
+
+template<class Visitor>
+void DirCache::queueGlob(GlobState<Visitor>& state, GlobBatch& batch,
+        const GlobNode* base, size_t baseLength, std::string& path,
+        size_t index, size_t depth, size_t size) {
+    if (!state.group) {
+        globImpl(state, base, baseLength, path, index, depth);
+        return;
+    }
+
+    // Estimate how much work it is to search this directory. Listing a
+    // directory that isn't cached yet needs I/O and so is worth a task.
+    if (size == SIZE_MAX)
+        size = cachedSize(state.root, path);
+
+    const size_t cost = size == SIZE_MAX ? globListCost : size;
+
+    if (cost < globInlineCost) {
+        // Not worth the overhead of a task. Note that this only searches this
+        // one directory. Its subdirectories are still subject to this policy.
+        globImpl(state, base, baseLength, path, index, depth);
+        return;
+    }
+
+    // Only the part of the path that is not already in the base node needs to
+    // be stored.
+    GlobNode* node = state.arena.node(base, path.data() + baseLength,
+            path.size() - baseLength, index, depth);
+
+    node->next = batch.head;
+    batch.head = node;
+    batch.cost += cost;
+
+    if (batch.cost >= globTaskCost)
+        flushGlob(state, batch);
+}
+
+template<class Visitor>
+void DirCache::flushGlob(GlobState<Visitor>& state, GlobBatch& batch) {
+    if (!batch.head) return;
+
+    GlobState<Visitor>* s = &state;
+    const GlobNode* node = batch.head;
+
+    // Note that capturing just two pointers allows the task to be stored
+    // without a heap allocation.
+    state.group->run([s, node] {
+            s->cache->globTask(*s, node);
+            });
+
+    batch = GlobBatch();
+}
+
+template<class Visitor>
+void DirCache::globTask(GlobState<Visitor>& state, const GlobNode* node) {
+    // Shared by every node in the batch. This must not be a thread-local
+    // buffer: the visitor could wait on a task group, which runs other tasks,
+    // including glob tasks, on this thread while it waits.
+    std::string path;
+
+    for (; node; node = node->next) {
+        path.clear();
+        node->path(path);
+
+        globImpl(state, node, path.size(), path, node->index, node->depth);
+    }
+}
@@ -9,7 +9,7 @@
 #include "embedded.h"
 
 #include <string.h> // for strcmp
-#include <stdlib.h> // for bsearch
+#include <stdint.h>
 
 #include <lua.hpp>
 
@@ -35,44 +35,46 @@ struct Script
  */
 #include "embedded/init.c"
 #include "embedded/shutdown.c"
+#include "embedded/worker.c"
 
 /**
  * Initialization/shutdown scripts.
  */
 const Script script_init     = SCRIPT("init", "init.lua", init);
 const Script script_shutdown = SCRIPT("shutdown", "shutdown.lua", shutdown);
+const Script script_worker   = SCRIPT("worker", "worker.lua", worker);
 
 /**
- * Modules to embed
+ * Modules to embed. This defines the embedded[] list and its hash table.
  */
-#include "embedded/rules.c"
-#include "embedded/rules/cc.c"
-#include "embedded/rules/cc/gcc.c"
-#include "embedded/rules/d.c"
-#include "embedded/rules/d/dmd.c"
+#include "embedded/modules.c"
 
 /**
- * List of embedded Lua scripts.
- *
- * NOTE: This *must* be in sorted order according to the module name.
+ * Hashes a module name. This must be the same as hash() in
+ * tools/embed-table.lua.
  */
-const Script embedded[] = {
-    SCRIPT("rules",        "{embedded}/rules.lua",        rules),
-    SCRIPT("rules.cc",     "{embedded}/rules/cc.lua",     rules_cc),
-    SCRIPT("rules.cc.gcc", "{embedded}/rules/cc/gcc.lua", rules_cc_gcc),
-    SCRIPT("rules.d",      "{embedded}/rules/d.lua",      rules_d),
-    SCRIPT("rules.d.dmd",  "{embedded}/rules/d/dmd.lua",  rules_d_dmd),
-};
+uint32_t hash_name(const char* name, uint32_t seed) {
+    uint32_t h = seed;
 
-const size_t embedded_len = sizeof(embedded)/sizeof(Script);
+    for (; *name; ++name)
+        h = h * 31 + (unsigned char)*name;
 
-int compare_embedded(const void* key, const void* elem) {
-    return strcmp((const char*)key, ((const Script*)elem)->name);
+    return h;
 }
 
-// Note that this assumes the list of modules is sorted.
 const Script* find_embedded(const char* name) {
-    return (const Script*)bsearch(name, embedded, embedded_len, sizeof(Script), compare_embedded);
+    const size_t slots = sizeof(embedded_slots)/sizeof(embedded_slots[0]);
+
+    const size_t i = embedded_slots[hash_name(name, embedded_seed) % slots];
+    if (i == 0)
+        return NULL;
+
+    // Names that aren't embedded can still land on an occupied slot.
+    const Script* m = &embedded[i-1];
+    if (strcmp(m->name, name) != 0)
+        return NULL;
+
+    return m;
 }
 
 int Script::load(lua_State* L) const {
@@ -118,3 +120,7 @@ int load_init(lua_State* L) {
 int load_shutdown(lua_State* L) {
     return script_shutdown.load(L);
 }
+
+int load_worker(lua_State* L) {
+    return script_worker.load(L);
+}
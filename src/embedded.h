@@ -23,3 +23,8 @@ int load_init(lua_State* L);
  * Loads the embedded shutdown script.
  */
 int load_shutdown(lua_State* L);
+
+/**
+ * Loads the embedded script that sets up a Lua state for import_all.
+ */
+int load_worker(lua_State* L);
@@ -0,0 +1,371 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <unistd.h>
+#endif // _WIN32
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+
+#include "fingerprint.h"
+#include "deps.h"
+#include "dircache.h"
+#include "mappedfile.h"
+#include "path.h"
+#include "scriptcache.h"
+#include "threadpool.h"
+#include "xxh3.h"
+
+namespace {
+
+/**
+ * Identifies the file format. Change the version whenever the format changes.
+ */
+const char magic[8] = {'B', 'L', 'F', 'P', 0, 0, 0, 1};
+
+/**
+ * Number of entries checked by each task.
+ */
+const size_t batchSize = 64;
+
+/**
+ * Inputs modified less than this many seconds before a run started may have
+ * been modified again during the run without changing their modification
+ * time. Runs that saw such inputs are not recorded.
+ */
+const double racyTime = 1.0;
+
+template<typename T>
+void put(std::string& buf, T value) {
+    buf.append((const char*)&value, sizeof(value));
+}
+
+void putString(std::string& buf, const std::string& s) {
+    put(buf, (uint32_t)s.length());
+    buf.append(s);
+}
+
+/**
+ * Reads what was written with put() and putString(). Reading past the end
+ * fails rather than crashing on a truncated file.
+ */
+class Reader {
+    const char* _p;
+    const char* _end;
+    bool _ok;
+
+public:
+    Reader(const char* data, size_t length)
+        : _p(data), _end(data + length), _ok(true) {}
+
+    bool ok() const {
+        return _ok;
+    }
+
+    bool done() const {
+        return _ok && _p == _end;
+    }
+
+    template<typename T>
+    T get() {
+        T value = T();
+
+        if (_ok && (size_t)(_end - _p) >= sizeof(value)) {
+            memcpy(&value, _p, sizeof(value));
+            _p += sizeof(value);
+        }
+        else {
+            _ok = false;
+        }
+
+        return value;
+    }
+
+    std::string getString() {
+        const uint32_t length = get<uint32_t>();
+
+        if (!_ok || (size_t)(_end - _p) < length) {
+            _ok = false;
+            return std::string();
+        }
+
+        std::string s(_p, length);
+        _p += length;
+        return s;
+    }
+
+    bool skip(const char* data, size_t length) {
+        if (!_ok || (size_t)(_end - _p) < length ||
+                memcmp(_p, data, length) != 0) {
+            _ok = false;
+            return false;
+        }
+
+        _p += length;
+        return true;
+    }
+};
+
+std::string workingDir() {
+#ifdef _WIN32
+    char buf[MAX_PATH];
+    const DWORD n = GetCurrentDirectoryA(sizeof(buf), buf);
+    return (n > 0 && n < sizeof(buf)) ? std::string(buf, n) : std::string();
+#else
+    char buf[4096];
+    return getcwd(buf, sizeof(buf)) ? std::string(buf) : std::string();
+#endif
+}
+
+/**
+ * Path to the running program such that a new build of it is never skipped.
+ * Empty if it is unknown.
+ */
+std::string programPath() {
+#if defined(_WIN32)
+    char buf[MAX_PATH];
+    const DWORD n = GetModuleFileNameA(NULL, buf, sizeof(buf));
+    return (n > 0 && n < sizeof(buf)) ? std::string(buf, n) : std::string();
+#elif defined(__linux__)
+    return "/proc/self/exe";
+#else
+    return std::string();
+#endif
+}
+
+uint64_t listingHash(const DirEntries& entries) {
+    std::string buf;
+
+    for (auto&& entry: entries) {
+        buf.append(entry.name);
+        buf.push_back('\0');
+        buf.push_back(entry.isDir ? 'd' : 'f');
+    }
+
+    return xxh3(buf.data(), buf.length());
+}
+
+/**
+ * Calls the function with the name of each dependency in a log from
+ * ImplicitDeps.
+ */
+template<typename F>
+void eachName(const std::string& log, F f) {
+    size_t i = 0;
+
+    while (log.length() - i >= sizeof(Dependency)) {
+        // Names are not padded, so the next header may not be aligned.
+        Dependency dep;
+        memcpy(&dep, log.data() + i, sizeof(dep));
+        i += sizeof(dep);
+
+        if (log.length() - i < dep.length)
+            break;
+
+        f(std::string(log.data() + i, dep.length));
+        i += dep.length;
+    }
+}
+
+}
+
+Fingerprint::Fingerprint(const char* cacheDir, int argc, char** argv)
+    : _key(workingDir()) {
+
+    for (int i = 1; i < argc; ++i) {
+        _key.push_back('\0');
+        _key.append(argv[i]);
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "run-%016llx",
+            (unsigned long long)xxh3(_key.data(), _key.length()));
+
+    _name = name;
+    _path = std::string(cacheDir) + "/" + _name;
+}
+
+bool Fingerprint::load() {
+    MappedFile file;
+    if (!file.open(_path.c_str()))
+        return false;
+
+    Reader r(file.data(), file.length());
+
+    // The name is only a hash, so it could belong to another command line.
+    r.skip(magic, sizeof(magic));
+    if (r.getString() != _key)
+        return false;
+
+    const uint32_t count = r.get<uint32_t>();
+
+    // Each entry takes at least 25 bytes, which bounds a corrupt count.
+    if (!r.ok() || count > file.length() / 25)
+        return false;
+
+    _entries.resize(count);
+
+    for (auto&& entry: _entries) {
+        entry.path    = r.getString();
+        entry.size    = r.get<int64_t>();
+        entry.mtime   = r.get<double>();
+        entry.listed  = r.get<uint8_t>() != 0;
+        entry.listing = r.get<uint64_t>();
+    }
+
+    _inputs = r.getString();
+    _outputs = r.getString();
+
+    return r.done();
+}
+
+bool Fingerprint::current(const Entry& entry) {
+    const FileStat st = DirCache::fileStat(Path(""), Path(entry.path));
+
+    if (st.size == entry.size && st.mtime == entry.mtime)
+        return true;
+
+    // Modifying a file in a directory changes the modification time of the
+    // directory but not what globs see in it.
+    if (!entry.listed || st.size < 0)
+        return false;
+
+    DirCache dirCache;
+    return listingHash(dirCache.dirEntries(entry.path)) == entry.listing;
+}
+
+bool Fingerprint::check(ThreadPool& pool) {
+    if (!load())
+        return false;
+
+    std::atomic<bool> changed(false);
+
+    {
+        TaskGroup group(pool);
+
+        const Entry* entries = _entries.data();
+        const size_t count = _entries.size();
+
+        for (size_t begin = 0; begin < count; begin += batchSize) {
+            const size_t end = (count - begin > batchSize) ?
+                begin + batchSize : count;
+
+            group.run([=, &changed] {
+                for (size_t i = begin; i < end && !changed; ++i) {
+                    if (!current(entries[i]))
+                        changed = true;
+                }
+            });
+        }
+    }
+
+    return !changed;
+}
+
+void Fingerprint::replay(ImplicitDeps& deps) const {
+    deps.replay(_inputs, _outputs);
+}
+
+void Fingerprint::remove() const {
+    ::remove(_path.c_str());
+}
+
+bool Fingerprint::save(const ScriptCache& cache, ImplicitDeps& deps,
+        DirCache& dirCache, const char* script, const char* output,
+        double start) const {
+
+    const std::string inputs = deps.recordedInputs();
+    const std::string outputs = deps.recordedOutputs();
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, size_t> index;
+
+    // Whether each entry was read during the run and so must be older than
+    // it.
+    std::vector<bool> read;
+
+    auto add = [&](const std::string& path, bool input) -> Entry& {
+        auto it = index.find(path);
+        if (it != index.end()) {
+            if (input)
+                read[it->second] = true;
+            return entries[it->second];
+        }
+
+        index.emplace(path, entries.size());
+        read.push_back(input);
+
+        Entry entry;
+        entry.path = path;
+        entry.listed = false;
+        entry.listing = 0;
+        entries.push_back(std::move(entry));
+        return entries.back();
+    };
+
+    // The program was loaded before the run started, so a fresh build of it
+    // is fine.
+    const std::string program = programPath();
+    if (!program.empty())
+        add(program, false);
+
+    add(script, true);
+
+    // Scripts are covered even if they were never reported as inputs.
+    for (auto&& path: cache.loaded())
+        add(path, true);
+
+    eachName(inputs, [&](const std::string& name) { add(name, true); });
+    eachName(outputs, [&](const std::string& name) { add(name, false); });
+    add(output, false);
+
+    dirCache.eachListing([&](const std::string& path,
+                const DirEntries& listing) {
+        Entry& entry = add(path, true);
+        entry.listed = true;
+        entry.listing = listingHash(listing);
+    });
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+
+        const FileStat st = DirCache::fileStat(Path(""), Path(entry.path));
+        if (read[i] && st.mtime >= start - racyTime)
+            return false;
+
+        entry.size = st.size;
+        entry.mtime = st.mtime;
+    }
+
+    std::string buf(magic, sizeof(magic));
+    putString(buf, _key);
+    put(buf, (uint32_t)entries.size());
+
+    for (auto&& entry: entries) {
+        putString(buf, entry.path);
+        put(buf, entry.size);
+        put(buf, entry.mtime);
+        put(buf, (uint8_t)entry.listed);
+        put(buf, entry.listing);
+    }
+
+    putString(buf, inputs);
+    putString(buf, outputs);
+
+    return cache.write(_name.c_str(), buf);
+}
+
+double Fingerprint::now() {
+    return std::chrono::duration<double>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
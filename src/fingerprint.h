@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Fingerprints of runs such that runs where nothing changed can be skipped.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class DirCache;
+class ImplicitDeps;
+class ScriptCache;
+class ThreadPool;
+
+/**
+ * Everything that the output of a run depends on: the working directory, the
+ * command line, the program itself, every script loaded through the script
+ * cache (the script, imported scripts, and scripts loaded with dofile), every
+ * input and output that was reported through ImplicitDeps (including modules
+ * loaded with require), and every directory that was listed. Files are
+ * compared by their size and modification time. Directories with a new
+ * modification time are listed again and compared by a hash of their entries.
+ *
+ * The dependencies that were sent to the parent build system are kept as well
+ * such that they can be sent again when a run is skipped.
+ *
+ * Inputs that are never reported, such as files read with io.open or
+ * environment variables, are not covered.
+ */
+class Fingerprint {
+public:
+    /**
+     * The fingerprint is stored in the cache directory under a name derived
+     * from the working directory and the command line.
+     */
+    Fingerprint(const char* cacheDir, int argc, char** argv);
+
+    /**
+     * Returns true if the fingerprint of the previous run is still current.
+     * That is, its output can be used as it is. Files are checked on the
+     * thread pool.
+     */
+    bool check(ThreadPool& pool);
+
+    /**
+     * Sends the dependencies of the previous run to the parent build system.
+     * Only valid after check() returned true.
+     */
+    void replay(ImplicitDeps& deps) const;
+
+    /**
+     * Removes the fingerprint of the previous run. This must be done before
+     * the output is overwritten such that a failed run is never skipped.
+     */
+    void remove() const;
+
+    /**
+     * Records the fingerprint of the run that just finished, which started at
+     * the given time. The output must be closed already. Nothing is recorded
+     * if any input was modified too recently to tell whether the run saw the
+     * change. Returns true if the fingerprint was written.
+     */
+    bool save(const ScriptCache& cache, ImplicitDeps& deps, DirCache& dirCache,
+            const char* script, const char* output, double start) const;
+
+    /**
+     * Returns the current time in the same terms as modification times.
+     */
+    static double now();
+
+private:
+    struct Entry {
+        std::string path;
+
+        // The same as FileStat.
+        int64_t size;
+        double mtime;
+
+        // Hash of the directory listing, if it was listed.
+        bool listed;
+        uint64_t listing;
+    };
+
+    /**
+     * Reads the fingerprint of the previous run. Returns false if there is
+     * none or it is for a different command line.
+     */
+    bool load();
+
+    /**
+     * Returns true if the entry still matches the file system.
+     */
+    static bool current(const Entry& entry);
+
+    // Working directory and command line.
+    std::string _key;
+
+    // Name of the file in the cache directory and its full path.
+    std::string _name;
+    std::string _path;
+
+    // The previous run.
+    std::vector<Entry> _entries;
+    std::string _inputs;
+    std::string _outputs;
+};
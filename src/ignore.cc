@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Rules for ignoring paths while globbing.
+ */
+#include <string.h>
+
+#include "ignore.h"
+
+namespace {
+
+/**
+ * Returns true if the given path element is a recursive glob pattern.
+ */
+bool isRecursiveGlob(const Path& p) {
+    return p.length == 2 && p.path[0] == '*' && p.path[1] == '*';
+}
+
+/**
+ * Skips past any leading path separators.
+ */
+Path skipSeps(Path p) {
+    while (p.length > 0 && Path::isSep(p.path[0])) {
+        ++p.path;
+        --p.length;
+    }
+
+    return p;
+}
+
+/**
+ * Splits off the first component of the path.
+ */
+Split<Path> splitFirst(Path p) {
+    size_t i = 0;
+    while (i < p.length && !Path::isSep(p.path[i]))
+        ++i;
+
+    Split<Path> s;
+    s.head = Path(p.path, i);
+    s.tail = skipSeps(Path(p.path + i, p.length - i));
+    return s;
+}
+
+/**
+ * Returns true if the normalized relative path refers to a parent directory
+ * (i.e., "..").
+ */
+bool isParentDir(Path p) {
+    return p.length >= 2 && p.path[0] == '.' && p.path[1] == '.' &&
+        (p.length == 2 || Path::isSep(p.path[2]));
+}
+
+/**
+ * Gets the part of the normalized path that is below the normalized directory.
+ * Returns false if the path is not below it.
+ */
+bool below(Path dir, Path& path) {
+    if (dir.length == 1 && dir.path[0] == '.')
+        return !path.isabs() && !isParentDir(path);
+
+    if (path.length <= dir.length ||
+            memcmp(path.path, dir.path, dir.length) != 0)
+        return false;
+
+    // A root such as "/" already ends with a separator.
+    size_t i = dir.length;
+    if (!Path::isSep(dir.path[i-1])) {
+        if (!Path::isSep(path.path[i]))
+            return false;
+        ++i;
+    }
+
+    path = Path(path.path + i, path.length - i);
+    return true;
+}
+
+/**
+ * Matches the path against the pattern components starting at the given index.
+ * This does not allocate.
+ */
+bool matchComponents(Path path, const std::vector<Path>& pattern, size_t i) {
+    if (i == pattern.size())
+        return path.length == 0;
+
+    if (isRecursiveGlob(pattern[i])) {
+        // Match 0 or more directories.
+        while (true) {
+            if (matchComponents(path, pattern, i+1))
+                return true;
+
+            if (path.length == 0)
+                return false;
+
+            path = splitFirst(path).tail;
+        }
+    }
+
+    if (path.length == 0)
+        return false;
+
+    const Split<Path> s = splitFirst(path);
+
+    if (!s.head.matches(pattern[i]))
+        return false;
+
+    return matchComponents(s.tail, pattern, i+1);
+}
+
+}
+
+IgnoreRules::IgnoreRules(Path dir) : _dir(dir.norm()) {}
+
+void IgnoreRules::add(const char* pattern, size_t length) {
+    Rule rule;
+    rule.negate = false;
+    rule.dirOnly = false;
+
+    if (length > 0 && pattern[0] == '!') {
+        rule.negate = true;
+        ++pattern;
+        --length;
+    }
+
+    // Trailing separators only match directories.
+    while (length > 0 && Path::isSep(pattern[length-1])) {
+        rule.dirOnly = true;
+        --length;
+    }
+
+    if (length == 0)
+        return;
+
+    _patterns.push_back(std::string(pattern, length));
+
+    const Path full = _patterns.back();
+    const Path p = skipSeps(full);
+
+    // A leading separator or any separator in the middle of the pattern makes
+    // it relative to the root.
+    rule.anchored = p.length != full.length;
+    for (size_t i = 0; i < p.length && !rule.anchored; ++i) {
+        if (Path::isSep(p.path[i]))
+            rule.anchored = true;
+    }
+
+    if (rule.anchored)
+        rule.components = p.components();
+    else
+        rule.components.push_back(p);
+
+    _rules.push_back(rule);
+}
+
+void IgnoreRules::parse(const std::string& contents) {
+    size_t start = 0;
+
+    while (start < contents.size()) {
+        size_t end = contents.find('\n', start);
+        if (end == std::string::npos)
+            end = contents.size();
+
+        size_t len = end - start;
+
+        // Handle Windows line endings.
+        if (len > 0 && contents[start + len - 1] == '\r')
+            --len;
+
+        // Trailing spaces are not significant.
+        while (len > 0 && contents[start + len - 1] == ' ')
+            --len;
+
+        if (len > 0 && contents[start] != '#')
+            add(contents.data() + start, len);
+
+        start = end + 1;
+    }
+}
+
+bool IgnoreRules::ignored(Path root, Path path, Path name, bool isDir) const {
+    // The path relative to the directory anchored patterns are relative to.
+    // Normalizing it strips any "./" and resolves any "../" in the glob
+    // pattern. Only needed for anchored patterns.
+    static thread_local std::string joined, normalized;
+    Path relative;
+    bool haveRelative = false, isBelow = false;
+
+    // Go backwards since the last matching rule wins.
+    for (size_t i = _rules.size(); i-- > 0; ) {
+        const Rule& rule = _rules[i];
+
+        if (rule.dirOnly && !isDir)
+            continue;
+
+        if (rule.anchored && !haveRelative) {
+            haveRelative = true;
+
+            normalized.clear();
+
+            if (_dir.empty()) {
+                path.norm(normalized);
+                relative = normalized;
+                isBelow = !isParentDir(relative);
+            }
+            else {
+                joined.assign(root.path, root.length);
+                path.join(joined);
+                Path(joined).norm(normalized);
+                relative = normalized;
+                isBelow = below(_dir, relative);
+            }
+        }
+
+        const bool matched = rule.anchored
+            ? isBelow && matchComponents(relative, rule.components, 0)
+            : name.matches(rule.components[0]);
+
+        if (matched)
+            return !rule.negate;
+    }
+
+    return false;
+}
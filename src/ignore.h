@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Rules for ignoring paths while globbing.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "path.h"
+
+/**
+ * A compiled list of ignore patterns using the same syntax as .gitignore files:
+ *
+ *  - Blank lines and lines starting with '#' are skipped.
+ *  - A leading '!' negates the pattern such that a previously ignored path is
+ *    included again.
+ *  - A trailing separator only matches directories.
+ *  - A pattern without a separator matches the name of a file or directory at
+ *    any depth. Otherwise, the pattern is matched against the whole path
+ *    relative to the directory of the ignore file, or the glob root if the
+ *    pattern was given inline. Paths outside of that directory never match. A
+ *    "**" component matches any number of directories.
+ *
+ * Patterns are matched with Path::matches. Later patterns take precedence over
+ * earlier ones.
+ */
+class IgnoreRules {
+private:
+    struct Rule {
+        // The pattern split into components. If not anchored, there is only
+        // one component.
+        std::vector<Path> components;
+
+        // Re-include paths matched by this pattern.
+        bool negate;
+
+        // Only match directories.
+        bool dirOnly;
+
+        // Match against the whole path instead of just the name.
+        bool anchored;
+    };
+
+    std::vector<Rule> _rules;
+
+    // Storage for the pattern strings. The rules point into these. A deque is
+    // used such that adding a pattern doesn't move the existing ones.
+    std::deque<std::string> _patterns;
+
+    // Normalized directory that anchored patterns are relative to. Empty if
+    // they are relative to the glob root.
+    std::string _dir;
+
+public:
+
+    IgnoreRules() {}
+
+    /**
+     * Anchored patterns are relative to the given directory instead of the
+     * glob root. This is the directory of the ignore file.
+     */
+    explicit IgnoreRules(Path dir);
+
+    /**
+     * Adds a single pattern.
+     */
+    void add(const char* pattern, size_t length);
+
+    /**
+     * Adds all patterns from the contents of an ignore file, one per line.
+     */
+    void parse(const std::string& contents);
+
+    /**
+     * Returns true if there are no rules.
+     */
+    bool empty() const {
+        return _rules.empty();
+    }
+
+    /**
+     * Returns true if the given path should be ignored. The path is relative
+     * to the glob root and the name is its last component.
+     */
+    bool ignored(Path root, Path path, Path name, bool isDir) const;
+};
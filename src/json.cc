@@ -0,0 +1,620 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * JSON parsing.
+ */
+#include "json.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define JSON_SSE2
+#   include <emmintrin.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   endif
+#endif
+
+namespace json {
+
+namespace {
+
+// Containers nested deeper than this are rejected.
+const size_t maxDepth = 1024;
+
+// Set in Token::count for strings with escape sequences.
+const uint32_t hasEscapes = 0x80000000u;
+
+/**
+ * Bit masks of the interesting characters in a 16 byte block. Bit i is for
+ * byte i.
+ */
+struct Block {
+    uint32_t quote;
+    uint32_t backslash;
+
+    // Structural characters: {}[]:,
+    uint32_t op;
+
+    uint32_t space;
+};
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool isOp(char c) {
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+inline unsigned countTrailingZeros(uint32_t x) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, (unsigned long)x);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctz(x);
+#endif
+}
+
+void classify(const char* p, Block& b) {
+#ifdef JSON_SSE2
+    const __m128i c = _mm_loadu_si128((const __m128i*)p);
+
+    // Setting bit 5 turns '[' into '{' and ']' into '}' without changing ':'
+    // or ','. Thus, all six characters are found with four comparisons.
+    const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+
+    const __m128i op = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(lower, _mm_set1_epi8('{')),
+                _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(c, _mm_set1_epi8(':')),
+                _mm_cmpeq_epi8(c, _mm_set1_epi8(','))));
+
+    const __m128i space = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+                _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(c, _mm_set1_epi8('\n')),
+                _mm_cmpeq_epi8(c, _mm_set1_epi8('\r'))));
+
+    b.quote = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')));
+    b.backslash = (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(c, _mm_set1_epi8('\\')));
+    b.op = (uint32_t)_mm_movemask_epi8(op);
+    b.space = (uint32_t)_mm_movemask_epi8(space);
+#else
+    b.quote = b.backslash = b.op = b.space = 0;
+
+    for (unsigned i = 0; i < 16; ++i) {
+        const uint32_t bit = 1u << i;
+        const char c = p[i];
+
+        if (c == '"')
+            b.quote |= bit;
+        else if (c == '\\')
+            b.backslash |= bit;
+        else if (isOp(c))
+            b.op |= bit;
+        else if (isSpace(c))
+            b.space |= bit;
+    }
+#endif
+}
+
+/**
+ * Bit i of the result is the exclusive or of bits 0 through i.
+ */
+inline uint32_t prefixXor(uint32_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    return x & 0xFFFF;
+}
+
+/**
+ * Returns the position of the first quote, backslash, or control character in
+ * [p, end), or end if there is none.
+ */
+inline const char* findStringSpecial(const char* p, const char* end) {
+#ifdef JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+    for (; end - p >= 16; p += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+
+        // There is no unsigned comparison, but c <= 0x1F iff min(c, 0x1F) == c.
+        const int mask = _mm_movemask_epi8(_mm_or_si128(
+                    _mm_or_si128(
+                        _mm_cmpeq_epi8(chunk, quote),
+                        _mm_cmpeq_epi8(chunk, backslash)),
+                    _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk)));
+
+        if (mask != 0)
+            return p + countTrailingZeros((uint32_t)mask);
+    }
+#endif
+
+    for (; p < end; ++p) {
+        if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20)
+            return p;
+    }
+
+    return end;
+}
+
+inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Parses the 4 hex digits at p. Returns -1 if they are not hex digits.
+ */
+int parseHex4(const char* p) {
+    int value = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        const int h = hexValue(p[i]);
+        if (h < 0)
+            return -1;
+
+        value = (value << 4) | h;
+    }
+
+    return value;
+}
+
+void appendUtf8(std::string& buf, uint32_t c) {
+    if (c < 0x80) {
+        buf.push_back((char)c);
+    }
+    else if (c < 0x800) {
+        buf.push_back((char)(0xC0 | (c >> 6)));
+        buf.push_back((char)(0x80 | (c & 0x3F)));
+    }
+    else if (c < 0x10000) {
+        buf.push_back((char)(0xE0 | (c >> 12)));
+        buf.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+        buf.push_back((char)(0x80 | (c & 0x3F)));
+    }
+    else {
+        buf.push_back((char)(0xF0 | (c >> 18)));
+        buf.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+        buf.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+        buf.push_back((char)(0x80 | (c & 0x3F)));
+    }
+}
+
+/**
+ * Returns the length of the number starting at p, or 0 if it isn't a valid
+ * number.
+ */
+size_t scanNumber(const char* p, const char* end) {
+    const char* start = p;
+
+    if (p < end && *p == '-')
+        ++p;
+
+    if (p == end)
+        return 0;
+
+    if (*p == '0') {
+        ++p;
+    }
+    else if (*p >= '1' && *p <= '9') {
+        while (p < end && *p >= '0' && *p <= '9')
+            ++p;
+    }
+    else {
+        return 0;
+    }
+
+    if (p < end && *p == '.') {
+        ++p;
+
+        const char* digits = p;
+        while (p < end && *p >= '0' && *p <= '9')
+            ++p;
+
+        if (p == digits)
+            return 0;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+
+        if (p < end && (*p == '+' || *p == '-'))
+            ++p;
+
+        const char* digits = p;
+        while (p < end && *p >= '0' && *p <= '9')
+            ++p;
+
+        if (p == digits)
+            return 0;
+    }
+
+    return (size_t)(p - start);
+}
+
+}
+
+Type Document::type(uint32_t i) const {
+    switch (_data[_tokens[i].pos]) {
+        case '{': return Type::object;
+        case '[': return Type::array;
+        case '"': return Type::string;
+        case 't':
+        case 'f': return Type::boolean;
+        case 'n': return Type::null;
+        default:  return Type::number;
+    }
+}
+
+bool Document::fail(const char* what, size_t pos) {
+    size_t line = 1, column = 1;
+
+    for (size_t i = 0; i < pos && i < _length; ++i) {
+        if (_data[i] == '\n') {
+            ++line;
+            column = 1;
+        }
+        else {
+            ++column;
+        }
+    }
+
+    _error = what;
+    _error += " at line " + std::to_string(line) + ", column " +
+        std::to_string(column);
+    return false;
+}
+
+bool Document::scan() {
+    _positions.clear();
+    _positions.reserve(_length / 4 + 16);
+
+    // State carried from one block to the next.
+    uint32_t escapeNext = 0; // The first byte is escaped
+    uint32_t inString = 0;   // 0xFFFF if the block starts inside a string
+    uint32_t boundary = 1;   // The last byte ended a token
+
+    char tail[16];
+
+    for (size_t base = 0; base < _length; base += 16) {
+        const char* p = _data + base;
+
+        // Pad the last block with spaces.
+        if (_length - base < 16) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, _length - base);
+            p = tail;
+        }
+
+        Block b;
+        classify(p, b);
+
+        // Find the escaped characters. Backslashes are rare, so this doesn't
+        // need to be clever.
+        uint32_t escaped = 0;
+        if (b.backslash | escapeNext) {
+            for (unsigned i = 0; i < 16; ++i) {
+                const uint32_t bit = 1u << i;
+
+                if (escapeNext) {
+                    escaped |= bit;
+                    escapeNext = 0;
+                }
+                else if (b.backslash & bit) {
+                    escapeNext = 1;
+                }
+            }
+        }
+
+        const uint32_t quotes = b.quote & ~escaped;
+
+        // Bytes inside of strings, including the opening quote but not the
+        // closing quote.
+        const uint32_t strings = prefixXor(quotes) ^ inString;
+        inString = (strings & 0x8000) ? 0xFFFF : 0;
+
+        const uint32_t outside = ~strings & 0xFFFF;
+
+        const uint32_t ops = b.op & outside;
+        const uint32_t opening = quotes & strings;
+        const uint32_t closing = quotes & outside;
+
+        // Scalars start after a byte that ends a token.
+        const uint32_t ends = ops | (b.space & outside) | closing;
+        const uint32_t follows = ((ends << 1) | boundary) & 0xFFFF;
+        boundary = ends >> 15;
+
+        const uint32_t scalars = outside & ~(b.op | b.space | b.quote) & follows;
+
+        uint32_t structurals = ops | opening | scalars;
+
+        while (structurals) {
+            _positions.push_back((uint32_t)base + countTrailingZeros(structurals));
+            structurals &= structurals - 1;
+        }
+    }
+
+    if (inString)
+        return fail("unterminated string", _length);
+
+    return true;
+}
+
+bool Document::build() {
+    enum State {
+        value,          // A value
+        valueOrClose,   // A value or ']'
+        keyOrClose,     // A key or '}'
+        key,            // A key
+        colon,          // ':'
+        commaOrClose,   // ',' or the end of the container
+        done,           // Nothing
+    };
+
+    _tokens.clear();
+    _tokens.reserve(_positions.size() / 2 + 1);
+
+    // Indices of the open containers.
+    std::vector<uint32_t> stack;
+
+    State state = value;
+
+    const char* end = _data + _length;
+
+    for (const uint32_t pos: _positions) {
+        const char c = _data[pos];
+        const uint32_t i = (uint32_t)_tokens.size();
+
+        switch (c) {
+        case '{':
+        case '[':
+            if (state != value && state != valueOrClose)
+                return fail("unexpected container", pos);
+
+            if (stack.size() >= maxDepth)
+                return fail("too deeply nested", pos);
+
+            if (!stack.empty() && _data[_tokens[stack.back()].pos] == '[')
+                ++_tokens[stack.back()].count;
+
+            _tokens.push_back(Token {pos, 0, 0});
+            stack.push_back(i);
+
+            state = (c == '{') ? keyOrClose : valueOrClose;
+            break;
+
+        case '}':
+        case ']': {
+            if (stack.empty())
+                return fail("unexpected closing bracket", pos);
+
+            const char open = _data[_tokens[stack.back()].pos];
+
+            const bool ok = (c == '}') ?
+                (open == '{' && (state == commaOrClose || state == keyOrClose)) :
+                (open == '[' && (state == commaOrClose || state == valueOrClose));
+
+            if (!ok)
+                return fail("unexpected closing bracket", pos);
+
+            _tokens[stack.back()].next = i;
+            stack.pop_back();
+
+            state = stack.empty() ? done : commaOrClose;
+            break;
+        }
+
+        case ',':
+            if (state != commaOrClose)
+                return fail("unexpected ','", pos);
+
+            state = (_data[_tokens[stack.back()].pos] == '{') ? key : value;
+            break;
+
+        case ':':
+            if (state != colon)
+                return fail("unexpected ':'", pos);
+
+            state = value;
+            break;
+
+        case '"': {
+            const bool isKey = (state == key || state == keyOrClose);
+
+            if (!isKey && state != value && state != valueOrClose)
+                return fail("unexpected string", pos);
+
+            // Find the closing quote and check the escape sequences.
+            const char* start = _data + pos + 1;
+            const char* p = start;
+            uint32_t escapes = 0;
+
+            for (;;) {
+                p = findStringSpecial(p, end);
+
+                if (p == end)
+                    return fail("unterminated string", pos);
+
+                if (*p == '"')
+                    break;
+
+                if (*p != '\\')
+                    return fail("control character in string",
+                            (size_t)(p - _data));
+
+                escapes = hasEscapes;
+
+                if (end - p < 2)
+                    return fail("unterminated string", pos);
+
+                switch (p[1]) {
+                    case '"': case '\\': case '/': case 'b':
+                    case 'f': case 'n': case 'r': case 't':
+                        p += 2;
+                        break;
+                    case 'u':
+                        if (end - p < 6 || parseHex4(p + 2) < 0)
+                            return fail("invalid unicode escape",
+                                    (size_t)(p - _data));
+                        p += 6;
+                        break;
+                    default:
+                        return fail("invalid escape sequence",
+                                (size_t)(p - _data));
+                }
+            }
+
+            // Members are counted by their keys.
+            if (!stack.empty() &&
+                    (isKey || _data[_tokens[stack.back()].pos] == '['))
+                ++_tokens[stack.back()].count;
+
+            _tokens.push_back(Token {pos, i + 1, (uint32_t)(p - start) | escapes});
+
+            if (isKey)
+                state = colon;
+            else
+                state = stack.empty() ? done : commaOrClose;
+
+            break;
+        }
+
+        default: {
+            if (state != value && state != valueOrClose)
+                return fail("unexpected value", pos);
+
+            const char* p = _data + pos;
+            size_t len = 0;
+
+            if (c == 't' && end - p >= 4 && memcmp(p, "true", 4) == 0)
+                len = 4;
+            else if (c == 'f' && end - p >= 5 && memcmp(p, "false", 5) == 0)
+                len = 5;
+            else if (c == 'n' && end - p >= 4 && memcmp(p, "null", 4) == 0)
+                len = 4;
+            else if (c == '-' || (c >= '0' && c <= '9'))
+                len = scanNumber(p, end);
+
+            // The value must end right before the next token.
+            if (len == 0 || (p + len < end && !isSpace(p[len]) &&
+                        !isOp(p[len]) && p[len] != '"'))
+                return fail("invalid value", pos);
+
+            if (!stack.empty() && _data[_tokens[stack.back()].pos] == '[')
+                ++_tokens[stack.back()].count;
+
+            _tokens.push_back(Token {pos, i + 1, (uint32_t)len});
+
+            state = stack.empty() ? done : commaOrClose;
+            break;
+        }
+        }
+    }
+
+    if (state != done)
+        return fail("unexpected end of input", _length);
+
+    return true;
+}
+
+bool Document::parse(const char* data, size_t length) {
+    _data = data;
+    _length = length;
+    _error.clear();
+    _tokens.clear();
+
+    if (length >= hasEscapes)
+        return fail("document is too large", 0);
+
+    const bool ok = scan() && build();
+
+    // Only the tape is needed from here on.
+    std::vector<uint32_t>().swap(_positions);
+
+    return ok;
+}
+
+Slice Document::string(uint32_t i, std::string& buf) const {
+    const Token& t = _tokens[i];
+
+    const char* p = _data + t.pos + 1;
+    const size_t length = t.count & ~hasEscapes;
+
+    if (!(t.count & hasEscapes))
+        return Slice {p, length};
+
+    // The escape sequences were checked when parsing.
+    buf.clear();
+
+    const char* end = p + length;
+
+    while (p < end) {
+        const char* q = findStringSpecial(p, end);
+        buf.append(p, (size_t)(q - p));
+
+        if (q == end)
+            break;
+
+        switch (q[1]) {
+            case 'b': buf.push_back('\b'); break;
+            case 'f': buf.push_back('\f'); break;
+            case 'n': buf.push_back('\n'); break;
+            case 'r': buf.push_back('\r'); break;
+            case 't': buf.push_back('\t'); break;
+            case 'u': {
+                uint32_t c = (uint32_t)parseHex4(q + 2);
+                q += 4;
+
+                if (c >= 0xD800 && c <= 0xDBFF) {
+                    // A high surrogate must be followed by a low surrogate.
+                    int low = -1;
+                    if (end - q >= 8 && q[2] == '\\' && q[3] == 'u')
+                        low = parseHex4(q + 4);
+
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        c = 0x10000 + ((c - 0xD800) << 10) +
+                            ((uint32_t)low - 0xDC00);
+                        q += 6;
+                    }
+                    else {
+                        c = 0xFFFD;
+                    }
+                }
+                else if (c >= 0xDC00 && c <= 0xDFFF) {
+                    c = 0xFFFD;
+                }
+
+                appendUtf8(buf, c);
+                break;
+            }
+            default:
+                // '"', '\\', or '/'
+                buf.push_back(q[1]);
+                break;
+        }
+
+        p = q + 2;
+    }
+
+    return Slice {buf.data(), buf.length()};
+}
+
+}
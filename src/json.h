@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * JSON parsing.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace json {
+
+enum class Type {
+    object,
+    array,
+    string,
+    number,
+    boolean,
+    null,
+};
+
+/**
+ * A value in a parsed document. Object keys are tokens too; each member of an
+ * object is a key followed by its value.
+ */
+struct Token {
+    // Offset of the first character of the value in the input.
+    uint32_t pos;
+
+    // Index of the token after this value and all of its children.
+    uint32_t next;
+
+    // For arrays, the number of elements. For objects, the number of members.
+    // For strings, the length of the raw contents, with the top bit set if
+    // there are escape sequences. For numbers, the length of the number.
+    uint32_t count;
+};
+
+/**
+ * A string that is not owned.
+ */
+struct Slice {
+    const char* data;
+    size_t length;
+};
+
+/**
+ * A parsed JSON document. Parsing is done in two stages, much like simdjson:
+ *
+ *  1. The input is scanned 16 bytes at a time (with SSE2 if it is available)
+ *     to find the positions of the structural characters ({}[]:,) and the
+ *     starts of all strings and scalars. The contents of strings are skipped
+ *     with bit tricks instead of branching on every character.
+ *  2. The positions are walked once to check the grammar, match brackets, and
+ *     build a tape of the values in document order. Containers on the tape
+ *     know where they end and how many elements they have. Thus, they can be
+ *     skipped or presized without looking at their contents.
+ *
+ * Strings and numbers are validated, but only decoded when asked for. The
+ * document does not own the input, so the input must outlive it.
+ */
+class Document {
+public:
+    /**
+     * Parses the input. Returns false if it is not valid JSON, in which case
+     * error() says why. Documents must be smaller than 2 GiB.
+     */
+    bool parse(const char* data, size_t length);
+
+    const std::string& error() const {
+        return _error;
+    }
+
+    /**
+     * The tokens of the document. The root value is token 0.
+     */
+    const Token& operator[](uint32_t i) const {
+        return _tokens[i];
+    }
+
+    size_t size() const {
+        return _tokens.size();
+    }
+
+    Type type(uint32_t i) const;
+
+    /**
+     * Returns the contents of the string at token i. If the string has no
+     * escape sequences, this points into the input. Otherwise, it is decoded
+     * into the buffer.
+     */
+    Slice string(uint32_t i, std::string& buf) const;
+
+    /**
+     * Returns the text of the number at token i.
+     */
+    Slice number(uint32_t i) const {
+        const Token& t = _tokens[i];
+        return Slice {_data + t.pos, t.count};
+    }
+
+    /**
+     * Returns the value of the boolean at token i.
+     */
+    bool boolean(uint32_t i) const {
+        return _data[_tokens[i].pos] == 't';
+    }
+
+private:
+    /**
+     * Finds the positions of the structural characters, strings, and scalars.
+     */
+    bool scan();
+
+    /**
+     * Builds the tape from the positions found by scan().
+     */
+    bool build();
+
+    /**
+     * Sets the error message for the given position and returns false.
+     */
+    bool fail(const char* what, size_t pos);
+
+    const char* _data;
+    size_t _length;
+
+    std::vector<uint32_t> _positions;
+    std::vector<Token> _tokens;
+
+    std::string _error;
+};
+
+}
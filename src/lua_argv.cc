@@ -0,0 +1,401 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Immutable argument lists that share their segments.
+ *
+ * An argv list is a userdata whose user value is a table of its segments. Each
+ * segment is either a single element (a string or path handle) or another argv
+ * list. Joining lists only adds references to them, so the elements of a list
+ * are stored once no matter how many lists it is part of.
+ */
+#include "lua.hpp"
+
+#include <algorithm>
+
+#include "lua_argv.h"
+#include "lua_path.h"
+
+namespace {
+
+const char* argvType = "buttonlua.Argv";
+
+/**
+ * Lists nested deeper than this are copied instead of referenced when they are
+ * joined. This keeps walking a list from recursing too deeply when lists are
+ * built up one element at a time.
+ */
+const int maxDepth = 32;
+
+struct Argv {
+    // Total number of elements.
+    lua_Integer length;
+
+    // Number of segments.
+    lua_Integer count;
+
+    // Number of levels of lists nested in this one.
+    int depth;
+};
+
+/**
+ * Index of the segment offsets in the segments table. They are created the
+ * first time an element is looked up by index.
+ */
+const lua_Integer offsetsIndex = 0;
+
+Argv* toArgv(lua_State* L, int i) {
+    return (Argv*)luaL_testudata(L, i, argvType);
+}
+
+Argv* checkArgv(lua_State* L, int i) {
+    return (Argv*)luaL_checkudata(L, i, argvType);
+}
+
+bool isPathHandle(lua_State* L, int i) {
+    PathTable* table;
+    PathId id;
+    return lua_topathid(L, i, &table, &id);
+}
+
+/**
+ * Calls the function for each element of the list at the given (absolute)
+ * index.
+ */
+void each(lua_State* L, int i, const std::function<void(lua_State*)>& f) {
+    luaL_checkstack(L, 2, NULL);
+
+    lua_getuservalue(L, i);
+    const int segments = lua_gettop(L);
+
+    for (lua_Integer j = 1; ; ++j) {
+        lua_rawgeti(L, segments, j);
+
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        if (toArgv(L, -1))
+            each(L, lua_gettop(L), f);
+        else
+            f(L);
+
+        lua_pop(L, 1);
+    }
+
+    lua_pop(L, 1);
+}
+
+/**
+ * A list that is being joined. The segments table is on the stack.
+ */
+struct Builder {
+    int segments;
+    lua_Integer count;
+    lua_Integer length;
+    int depth;
+};
+
+/**
+ * Adds the element at the top of the stack to the list and pops it. Strings,
+ * numbers, and path handles are accepted.
+ */
+void addElement(lua_State* L, Builder& b, int arg) {
+    switch (lua_type(L, -1)) {
+        case LUA_TSTRING:
+            break;
+        case LUA_TNUMBER:
+            // Converts the number in place.
+            lua_tostring(L, -1);
+            break;
+        case LUA_TUSERDATA:
+            if (isPathHandle(L, -1))
+                break;
+
+            // Fall through
+        default:
+            luaL_error(L, "bad argument #%d to 'join' (string expected, got %s)",
+                    arg, luaL_typename(L, -1));
+    }
+
+    lua_rawseti(L, b.segments, ++b.count);
+    ++b.length;
+}
+
+/**
+ * Adds the argv list at the top of the stack to the list and pops it.
+ */
+void addList(lua_State* L, Builder& b) {
+    const Argv* list = toArgv(L, -1);
+
+    if (list->length == 0) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    if (list->depth >= maxDepth) {
+        each(L, lua_gettop(L), [&](lua_State* L) {
+            lua_pushvalue(L, -1);
+            lua_rawseti(L, b.segments, ++b.count);
+        });
+
+        // The copied elements are leaves, so the depth doesn't change.
+        // Otherwise, every later join would copy them again.
+        b.length += list->length;
+        lua_pop(L, 1);
+        return;
+    }
+
+    if (list->depth + 1 > b.depth)
+        b.depth = list->depth + 1;
+
+    b.length += list->length;
+    lua_rawseti(L, b.segments, ++b.count);
+}
+
+/**
+ * Returns the number of elements before each segment of the list. The segments
+ * table is at the top of the stack.
+ */
+const lua_Integer* segmentOffsets(lua_State* L, const Argv* list) {
+    lua_rawgeti(L, -1, offsetsIndex);
+    const lua_Integer* offsets = (const lua_Integer*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    if (offsets)
+        return offsets;
+
+    lua_Integer* o = (lua_Integer*)lua_newuserdata(L,
+            sizeof(lua_Integer) * (size_t)list->count);
+
+    lua_Integer n = 0;
+
+    for (lua_Integer j = 0; j < list->count; ++j) {
+        o[j] = n;
+
+        lua_rawgeti(L, -2, j + 1);
+        const Argv* sub = toArgv(L, -1);
+        n += sub ? sub->length : 1;
+        lua_pop(L, 1);
+    }
+
+    // The segments table keeps it alive.
+    lua_rawseti(L, -2, offsetsIndex);
+    return o;
+}
+
+/**
+ * Pushes element i of the list at the given index. Pushes nil if the index is
+ * out of bounds.
+ *
+ * The segment holding the element is found with a binary search at each level,
+ * so iterating over a list doesn't depend on how many segments it has.
+ */
+void pushElement(lua_State* L, int idx, lua_Integer i) {
+    const Argv* list = checkArgv(L, idx);
+
+    if (i < 1 || i > list->length) {
+        lua_pushnil(L);
+        return;
+    }
+
+    lua_getuservalue(L, idx);
+
+    while (true) {
+        const lua_Integer* offsets = segmentOffsets(L, list);
+
+        // Last segment that starts before the element.
+        const lua_Integer j = std::upper_bound(offsets, offsets + list->count,
+                i - 1) - offsets - 1;
+
+        lua_rawgeti(L, -1, j + 1);
+        i -= offsets[j];
+
+        const Argv* sub = toArgv(L, -1);
+        if (!sub) {
+            lua_replace(L, -2);
+            return;
+        }
+
+        // Descend into the nested list.
+        list = sub;
+        lua_getuservalue(L, -1);
+        lua_replace(L, -3);
+        lua_pop(L, 1);
+    }
+}
+
+/**
+ * Returns a new argv list of the given values. Argv list and table arguments
+ * have their elements added instead.
+ */
+int argv_join(lua_State* L) {
+    const int argc = lua_gettop(L);
+
+    lua_createtable(L, argc, 0);
+
+    Builder b = {lua_gettop(L), 0, 0, 0};
+
+    for (int i = 1; i <= argc; ++i) {
+        const int type = lua_type(L, i);
+
+        if (type == LUA_TNIL)
+            break;
+
+        if (toArgv(L, i)) {
+            lua_pushvalue(L, i);
+            addList(L, b);
+        }
+        else if (type == LUA_TTABLE ||
+                (type == LUA_TUSERDATA && !isPathHandle(L, i))) {
+            // Like ipairs(), this respects __index such that lazy glob results
+            // work too.
+            for (lua_Integer j = 1; ; ++j) {
+                lua_pushinteger(L, j);
+                lua_gettable(L, i);
+
+                if (lua_isnil(L, -1)) {
+                    lua_pop(L, 1);
+                    break;
+                }
+
+                if (toArgv(L, -1))
+                    addList(L, b);
+                else
+                    addElement(L, b, i);
+            }
+        }
+        else {
+            lua_pushvalue(L, i);
+            addElement(L, b, i);
+        }
+    }
+
+    Argv* list = (Argv*)lua_newuserdata(L, sizeof(Argv));
+    list->length = b.length;
+    list->count = b.count;
+    list->depth = b.depth;
+    luaL_setmetatable(L, argvType);
+
+    lua_pushvalue(L, b.segments);
+    lua_setuservalue(L, -2);
+
+    return 1;
+}
+
+/**
+ * Converts the argv list to a table.
+ */
+int argv_totable(lua_State* L) {
+    const Argv* list = checkArgv(L, 1);
+
+    lua_createtable(L, (int)list->length, 0);
+    const int t = lua_gettop(L);
+
+    lua_Integer n = 0;
+
+    each(L, 1, [&](lua_State* L) {
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, t, ++n);
+    });
+
+    return 1;
+}
+
+int argv_len(lua_State* L) {
+    lua_pushinteger(L, checkArgv(L, 1)->length);
+    return 1;
+}
+
+/**
+ * Indexing with an integer returns the element at that index. Anything else is
+ * looked up in the method table (the first upvalue).
+ */
+int argv_index(lua_State* L) {
+    checkArgv(L, 1);
+
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        pushElement(L, 1, lua_tointeger(L, 2));
+        return 1;
+    }
+
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    return 1;
+}
+
+int argv_next(lua_State* L) {
+    const Argv* list = checkArgv(L, 1);
+    lua_Integer i = luaL_checkinteger(L, 2) + 1;
+
+    if (i < 1 || i > list->length)
+        return 0;
+
+    lua_pushinteger(L, i);
+    pushElement(L, 1, i);
+    return 2;
+}
+
+/**
+ * Only needed for Lua 5.2. Later versions of ipairs respect __index.
+ */
+int argv_ipairs(lua_State* L) {
+    checkArgv(L, 1);
+    lua_pushcfunction(L, argv_next);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+
+const luaL_Reg argv_methods[] = {
+    {"totable", argv_totable},
+    {NULL, NULL}
+};
+
+const luaL_Reg argvlib[] = {
+    {"join", argv_join},
+    {"totable", argv_totable},
+    {NULL, NULL}
+};
+
+/**
+ * Creates the metatable for argv lists.
+ */
+void registerArgv(lua_State* L) {
+    if (!luaL_newmetatable(L, argvType)) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    lua_pushcfunction(L, argv_len);
+    lua_setfield(L, -2, "__len");
+
+    lua_pushcfunction(L, argv_ipairs);
+    lua_setfield(L, -2, "__ipairs");
+
+    luaL_newlib(L, argv_methods);
+    lua_pushcclosure(L, argv_index, 1);
+    lua_setfield(L, -2, "__index");
+
+    lua_pop(L, 1); // Pop metatable
+}
+
+}
+
+bool lua_isargv(lua_State* L, int idx) {
+    return toArgv(L, idx) != NULL;
+}
+
+void lua_argveach(lua_State* L, int idx,
+        const std::function<void(lua_State*)>& f) {
+    each(L, lua_absindex(L, idx), f);
+}
+
+int luaopen_argv(lua_State* L) {
+    registerArgv(L);
+    luaL_newlib(L, argvlib);
+    return 1;
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Immutable argument lists that share their segments.
+ */
+#pragma once
+
+#include <functional>
+
+struct lua_State;
+
+/**
+ * An argv list is an immutable list of strings (or path handles) that is built
+ * by concatenating other lists. Instead of copying the elements of the lists it
+ * is built from, it refers to them. That is, it is a rope. This makes it cheap
+ * to build the command line for every source file out of the same long list of
+ * flags:
+ *
+ *     local flags = argv.join(args, compiler_opts)
+ *     for i,src in ipairs(srcs) do
+ *         rule {
+ *             ...
+ *             task = {argv.join(flags, {"-c", src, "-o", objs[i]})},
+ *         }
+ *     end
+ *
+ * Here, every command only holds a reference to `flags` and its four other
+ * elements. Rules::add writes the list out by walking the segments.
+ *
+ * An argv list supports `#`, indexing, `ipairs`, and the method totable(). It
+ * is also accepted by table.join, table.append, and rules.expand_compile.
+ */
+
+/**
+ * Pushes the argv library onto the stack so that it can be registered. It has
+ * the functions:
+ *
+ *  - join(...): Returns a new argv list of the given values. Argv list and
+ *    table arguments have their elements added instead. Like table.join, this
+ *    stops at the first nil argument.
+ *  - totable(list): Converts the argv list to a table.
+ */
+int luaopen_argv(lua_State* L);
+
+/**
+ * Returns true if the value at the given index is an argv list.
+ */
+bool lua_isargv(lua_State* L, int idx);
+
+/**
+ * Calls the function for each element of the argv list at the given index, in
+ * order. The element is on the top of the stack during the call and the
+ * function must leave the stack as it was.
+ */
+void lua_argveach(lua_State* L, int idx,
+        const std::function<void(lua_State*)>& f);
@@ -0,0 +1,369 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * File system queries that are answered from the directory cache.
+ */
+#include "lua.hpp"
+
+#include <stdio.h>
+
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "lua_fs.h"
+#include "lua_globals.h"
+#include "lua_path.h"
+#include "mappedfile.h"
+
+namespace {
+
+const char* prefetcherType = "buttonlua.FsPrefetcher";
+
+// Like io.open, paths are relative to the working directory.
+const Path cwd("");
+
+/**
+ * Files smaller than this are read into memory. Mapping them costs more than
+ * copying them.
+ */
+const size_t mapThreshold = 64 * 1024;
+
+/**
+ * A file that is being read (or has been read) on the thread pool.
+ */
+struct FileData {
+    // Contents of small files.
+    std::string contents;
+
+    // Large files are mapped instead.
+    MappedFile file;
+    bool mapped;
+
+    bool ok;
+
+    FileData() : mapped(false), ok(false) {}
+
+    const char* data() const {
+        return mapped ? file.data() : contents.data();
+    }
+
+    size_t length() const {
+        return mapped ? file.length() : contents.length();
+    }
+};
+
+/**
+ * Reads files on the thread pool ahead of time. There is one of these for each
+ * Lua state, and it is only used from the thread that owns the state.
+ */
+class Prefetcher {
+public:
+    explicit Prefetcher(ThreadPool& pool) : _group(pool) {}
+
+    /**
+     * Starts reading the given files. The paths must be normalized. Files that
+     * are already being read are skipped.
+     */
+    void prefetch(const std::vector<std::string>& paths);
+
+    /**
+     * Takes a file that was prefetched, waiting for it if necessary. Returns
+     * NULL if the file was never prefetched.
+     */
+    std::unique_ptr<FileData> take(const std::string& path);
+
+private:
+    // Number of files read by each task.
+    static const size_t batchSize = 16;
+
+    typedef std::vector<std::pair<const char*, FileData*>> Batch;
+
+    std::map<std::string, std::unique_ptr<FileData>> _files;
+
+    // Must be declared last such that it waits for the tasks before the files
+    // are destroyed.
+    TaskGroup _group;
+};
+
+/**
+ * Reads a file. Large files are mapped and each page is touched so that it is
+ * in memory by the time it is copied into a Lua string.
+ */
+void readFile(const char* path, FileData& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return;
+
+    static thread_local std::vector<char> buf(mapThreshold);
+
+    const size_t n = fread(buf.data(), 1, buf.size(), f);
+    const bool error = ferror(f) != 0;
+    const bool small = n < buf.size() || fgetc(f) == EOF;
+
+    fclose(f);
+
+    if (error)
+        return;
+
+    if (small) {
+        data.contents.assign(buf.data(), n);
+        data.ok = true;
+        return;
+    }
+
+    data.mapped = true;
+    data.ok = data.file.open(path);
+
+    const char* p = data.file.data();
+    const size_t length = data.file.length();
+
+    volatile char sink = 0;
+    for (size_t i = 0; i < length; i += 4096)
+        sink ^= p[i];
+
+    (void)sink;
+}
+
+void Prefetcher::prefetch(const std::vector<std::string>& paths) {
+    std::shared_ptr<Batch> batch;
+
+    for (auto&& path: paths) {
+        auto it = _files.find(path);
+        if (it != _files.end())
+            continue;
+
+        it = _files.insert(std::make_pair(path,
+                    std::unique_ptr<FileData>(new FileData()))).first;
+
+        if (!batch)
+            batch = std::make_shared<Batch>();
+
+        batch->push_back(std::make_pair(it->first.c_str(), it->second.get()));
+
+        if (batch->size() == batchSize) {
+            _group.run([batch] {
+                for (auto&& f: *batch)
+                    readFile(f.first, *f.second);
+            });
+
+            batch.reset();
+        }
+    }
+
+    if (batch) {
+        _group.run([batch] {
+            for (auto&& f: *batch)
+                readFile(f.first, *f.second);
+        });
+    }
+}
+
+std::unique_ptr<FileData> Prefetcher::take(const std::string& path) {
+    std::unique_ptr<FileData> data;
+
+    auto it = _files.find(path);
+    if (it == _files.end())
+        return data;
+
+    // The tasks only touch the files themselves, so this can't wait for just
+    // the one file.
+    _group.wait();
+
+    data = std::move(it->second);
+    _files.erase(it);
+    return data;
+}
+
+Prefetcher& getPrefetcher(lua_State* L) {
+    return *(Prefetcher*)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+int prefetcher_gc(lua_State* L) {
+    ((Prefetcher*)luaL_checkudata(L, 1, prefetcherType))->~Prefetcher();
+    return 0;
+}
+
+/**
+ * Gets the normalized path at the given index.
+ */
+void checkNormPath(lua_State* L, int arg, std::string& buf) {
+    size_t len;
+    const char* path = lua_checkpath(L, arg, &len);
+
+    buf.clear();
+    Path(path, len).norm(buf);
+}
+
+/**
+ * Gets the normalized paths in the table at the given index.
+ */
+void checkNormPaths(lua_State* L, int arg, std::vector<std::string>& paths) {
+    luaL_checktype(L, arg, LUA_TTABLE);
+
+    for (int i = 1; ; ++i) {
+        lua_rawgeti(L, arg, i);
+
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+        if (!path)
+            luaL_error(L, "bad element #%d of argument #%d (string expected, "
+                    "got %s)", i, arg, luaL_typename(L, -1));
+
+        std::string buf;
+        Path(path, len).norm(buf);
+        paths.push_back(std::move(buf));
+
+        lua_pop(L, 1);
+    }
+}
+
+/**
+ * Reads a file (from the prefetcher if it was prefetched) and pushes its
+ * contents. Pushes nil if it could not be read. The file is reported as a
+ * dependency either way.
+ */
+bool pushFile(lua_State* L, Prefetcher& prefetcher, const std::string& path) {
+    lua_globals::implicitDeps(L).addInputOnce(path.data(), path.length());
+
+    std::unique_ptr<FileData> data = prefetcher.take(path);
+
+    if (!data) {
+        data.reset(new FileData());
+        readFile(path.c_str(), *data);
+    }
+
+    if (!data->ok) {
+        lua_pushnil(L);
+        return false;
+    }
+
+    lua_pushlstring(L, data->data(), data->length());
+    return true;
+}
+
+int fs_exists(lua_State* L) {
+    size_t len;
+    const char* path = lua_checkpath(L, 1, &len);
+
+    const DirEntry* entry = lua_globals::dirCache(L).find(
+            cwd, Path(path, len));
+
+    lua_pushboolean(L, entry != NULL);
+    return 1;
+}
+
+int fs_isdir(lua_State* L) {
+    size_t len;
+    const char* path = lua_checkpath(L, 1, &len);
+
+    const DirEntry* entry = lua_globals::dirCache(L).find(
+            cwd, Path(path, len));
+
+    lua_pushboolean(L, entry && entry->isDir);
+    return 1;
+}
+
+int fs_list(lua_State* L) {
+    size_t len;
+    const char* path = lua_checkpath(L, 1, &len);
+
+    const DirEntries& entries = lua_globals::dirCache(L).dirEntries(
+            cwd, Path(path, len));
+
+    lua_createtable(L, (int)entries.size(), 0);
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        lua_pushlstring(L, entries[i].name.data(), entries[i].name.length());
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+
+    return 1;
+}
+
+int fs_read(lua_State* L) {
+    Prefetcher& prefetcher = getPrefetcher(L);
+
+    if (lua_type(L, 1) == LUA_TTABLE) {
+        std::vector<std::string> paths;
+        checkNormPaths(L, 1, paths);
+
+        prefetcher.prefetch(paths);
+
+        lua_createtable(L, (int)paths.size(), 0);
+
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (!pushFile(L, prefetcher, paths[i])) {
+                lua_pop(L, 1);
+                lua_pushboolean(L, 0);
+            }
+
+            lua_rawseti(L, -2, (lua_Integer)i + 1);
+        }
+
+        return 1;
+    }
+
+    std::string path;
+    checkNormPath(L, 1, path);
+
+    if (!pushFile(L, prefetcher, path)) {
+        lua_pushfstring(L, "cannot read '%s'", path.c_str());
+        return 2;
+    }
+
+    return 1;
+}
+
+int fs_prefetch(lua_State* L) {
+    std::vector<std::string> paths;
+
+    if (lua_type(L, 1) == LUA_TTABLE) {
+        checkNormPaths(L, 1, paths);
+    }
+    else {
+        paths.resize(1);
+        checkNormPath(L, 1, paths[0]);
+    }
+
+    getPrefetcher(L).prefetch(paths);
+    return 0;
+}
+
+const luaL_Reg fslib[] = {
+    {"exists", fs_exists},
+    {"isdir", fs_isdir},
+    {"list", fs_list},
+    {"read", fs_read},
+    {"prefetch", fs_prefetch},
+    {NULL, NULL}
+};
+
+}
+
+int luaopen_fs(lua_State* L) {
+    luaL_newlibtable(L, fslib);
+
+    void* p = lua_newuserdata(L, sizeof(Prefetcher));
+    new (p) Prefetcher(lua_globals::threadPool(L));
+
+    if (luaL_newmetatable(L, prefetcherType)) {
+        lua_pushcfunction(L, prefetcher_gc);
+        lua_setfield(L, -2, "__gc");
+    }
+
+    lua_setmetatable(L, -2);
+
+    luaL_setfuncs(L, fslib, 1);
+    return 1;
+}
@@ -0,0 +1,37 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * File system queries that are answered from the directory cache.
+ */
+#pragma once
+
+struct lua_State;
+
+/**
+ * Pushes the fs library onto the stack so that it can be registered. It has
+ * the functions:
+ *
+ *  - exists(path): Returns true if the path exists.
+ *  - isdir(path): Returns true if the path is a directory.
+ *  - list(dir): Returns a sorted table of the names in the directory. If the
+ *    directory doesn't exist, the table is empty.
+ *  - read(path): Returns the contents of the file, or nil and an error message
+ *    if it could not be read. Given a table of paths instead, returns a table
+ *    of their contents in the same order, where files that could not be read
+ *    are false. The files are read on the thread pool.
+ *  - prefetch(paths): Starts reading the files on the thread pool in the
+ *    background such that a later call to read() doesn't have to wait for
+ *    them.
+ *
+ * Instead of checking the path itself, exists() and isdir() look it up in the
+ * cached listing of its parent directory. Thus, the file system is only
+ * touched once per directory and the directory is what gets reported as a
+ * dependency. Symbolic links are not followed.
+ *
+ * Large files are memory mapped. Each file that is read is reported as a
+ * dependency only once, no matter how many times it is read.
+ */
+int luaopen_fs(lua_State* L);
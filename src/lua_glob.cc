@@ -11,35 +11,265 @@
 #include <ctype.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <set>
+#include <vector>
+#include <new>
 
 #include "lua.hpp"
 
 #include "lua_glob.h"
+#include "lua_path.h"
 #include "path.h"
 #include "lua_globals.h"
 
-int lua_glob(lua_State* L) {
+namespace {
 
-    DirCache& dirCache = lua_globals::dirCache(L);
-    ThreadPool& pool = lua_globals::threadPool(L);
+const char* globResultType = "buttonlua.GlobResult";
+const char* globHandleType = "buttonlua.GlobHandle";
 
-    std::mutex mutex;
-    std::set<std::string> paths;
+/**
+ * A sorted list of matched paths. All paths are stored back-to-back in a single
+ * buffer. A Lua string is only created for a path when it is accessed.
+ */
+class GlobResult {
+private:
+    // All of the paths, concatenated together.
+    std::string _buf;
 
-    // Adds a path to the set.
-    MatchCallback include = [&] (Path path) {
-        std::lock_guard<std::mutex> lock(mutex);
-        paths.emplace(path.path, path.length);
-    };
+    // Offset of the start of each path in the buffer. There is one extra offset
+    // at the end such that the length of path i is _offsets[i+1]-_offsets[i].
+    std::vector<size_t> _offsets;
 
-    // Removes a path from the set.
-    MatchCallback exclude = [&] (Path path) {
-        std::lock_guard<std::mutex> lock(mutex);
-        paths.erase(std::string(path.path, path.length));
-    };
+    // File metadata for each path. Empty if it wasn't requested.
+    std::vector<FileStat> _stats;
+
+public:
+    GlobResult() : _offsets(1, 0) {}
+
+    size_t size() const {
+        return _offsets.size() - 1;
+    }
+
+    Path operator[](size_t i) const {
+        return Path(_buf.data() + _offsets[i], _offsets[i+1] - _offsets[i]);
+    }
+
+    void reserve(size_t count, size_t bytes) {
+        _offsets.reserve(count + 1);
+        _buf.reserve(bytes);
+    }
+
+    void add(const char* path, size_t length) {
+        _buf.append(path, length);
+        _offsets.push_back(_buf.size());
+    }
+
+    void add(const char* path, size_t length, const FileStat& st) {
+        add(path, length);
+        _stats.push_back(st);
+    }
+
+    bool hasStats() const {
+        return !_stats.empty() || size() == 0;
+    }
+
+    const FileStat& stat(size_t i) const {
+        return _stats[i];
+    }
+};
+
+/**
+ * Globs for a single pattern. Patterns starting with '!' remove matches from
+ * the set instead of adding them.
+ */
+template<class Include, class Exclude>
+void globPattern(DirCache& dirCache, ThreadPool* pool, Path root,
+        const GlobOptions& options, const char* path, size_t len,
+        Include& include, Exclude& exclude) {
+    if (len > 0 && path[0] == '!')
+        dirCache.glob(root, Path(path+1, len-1), exclude, pool, options);
+    else
+        dirCache.glob(root, Path(path, len), include, pool, options);
+}
+
+/**
+ * The arguments of a glob call. Everything is copied out of the Lua state such
+ * that the glob can still be evaluated after the call returns.
+ */
+struct GlobRequest {
+    // Directory that all patterns are relative to.
+    std::string root;
+
+    // Patterns in the order they were given.
+    std::vector<std::string> patterns;
+
+    GlobOptions options;
+
+    // Inline ignore patterns. The options point to these.
+    IgnoreRules rules;
+
+    // Gather the size and modification time of each match.
+    bool stat;
+
+    GlobRequest() : stat(false) {}
+
+    GlobRequest(const GlobRequest&) = delete;
+    GlobRequest& operator=(const GlobRequest&) = delete;
+};
+
+/**
+ * Calls the function for the string, or each string in the table, at the top
+ * of the stack.
+ */
+template<class F>
+void forEachString(lua_State* L, F f) {
+    size_t len;
+    const char* s;
+
+    if (lua_type(L, -1) == LUA_TTABLE) {
+        for (int j = 1; ; ++j) {
+            lua_rawgeti(L, -1, j);
+            if (lua_type(L, -1) != LUA_TSTRING) {
+                lua_pop(L, 1);
+                break;
+            }
+
+            s = lua_tolstring(L, -1, &len);
+            f(s, len);
+            lua_pop(L, 1);
+        }
+    }
+    else if ((s = lua_tolstring(L, -1, &len))) {
+        f(s, len);
+    }
+}
+
+/**
+ * Raises an error if any of the glob options are invalid. This must be called
+ * before anything is allocated since raising an error skips destructors.
+ */
+void checkGlobArgs(lua_State* L, int first) {
+    int argc = lua_gettop(L);
+
+    for (int i = first; i <= argc; ++i) {
+        if (lua_type(L, i) != LUA_TTABLE)
+            continue;
+
+        lua_getfield(L, i, "max_depth");
+        if (!lua_isnil(L, -1)) {
+            int isnum;
+            lua_tointegerx(L, -1, &isnum);
+            if (!isnum)
+                luaL_argerror(L, i, "'max_depth' must be an integer");
+        }
+        lua_pop(L, 1);
+    }
+}
+
+/**
+ * Reads the glob options from any tables in the arguments. The options are:
+ *
+ *  - ignore: A pattern or list of patterns of paths to skip. The syntax is the
+ *    same as a .gitignore file.
+ *  - ignore_file: Path or list of paths to .gitignore-style files, relative to
+ *    the script directory.
+ *  - max_depth: Maximum number of directories to descend into.
+ *  - stat: If true, the size and modification time of each match is gathered.
+ *
+ * Inline ignore patterns are compiled into the request's rules. The options
+ * must have been checked with checkGlobArgs.
+ */
+void globOptions(lua_State* L, int first, DirCache& dirCache,
+        GlobRequest& request) {
+
+    GlobOptions& options = request.options;
+    IgnoreRules& rules = request.rules;
+
+    int argc = lua_gettop(L);
+
+    for (int i = first; i <= argc; ++i) {
+        if (lua_type(L, i) != LUA_TTABLE)
+            continue;
+
+        lua_getfield(L, i, "ignore");
+        forEachString(L, [&] (const char* s, size_t len) {
+            rules.add(s, len);
+        });
+        lua_pop(L, 1);
+
+        lua_getfield(L, i, "ignore_file");
+        forEachString(L, [&] (const char* s, size_t len) {
+            std::string buf(request.root);
+            Path(s, len).join(buf);
+            options.ignore.push_back(&dirCache.ignoreFile(buf));
+        });
+        lua_pop(L, 1);
+
+        lua_getfield(L, i, "max_depth");
+        if (!lua_isnil(L, -1)) {
+            lua_Integer depth = lua_tointeger(L, -1);
+            options.maxDepth = depth < 0 ? 0 : (size_t)depth;
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, i, "stat");
+        if (lua_toboolean(L, -1))
+            request.stat = true;
+        lua_pop(L, 1);
+    }
+
+    if (!rules.empty())
+        options.ignore.push_back(&rules);
+}
+
+/**
+ * Gets the metadata for all of the paths. Rather than a task per file, files
+ * are split into batches with one task per batch. If there is no thread pool,
+ * all files are done serially. Each path is reported as an input.
+ */
+void statPaths(DirCache& dirCache, ThreadPool* pool, Path root,
+        const std::set<std::string>& paths, std::vector<FileStat>& stats) {
+
+    const size_t batchSize = 256;
+
+    std::vector<const std::string*> names;
+    names.reserve(paths.size());
+
+    for (auto&& p: paths)
+        names.push_back(&p);
+
+    stats.resize(names.size());
+
+    // Not worth the overhead of the thread pool.
+    if (!pool || names.size() <= batchSize) {
+        for (size_t i = 0; i < names.size(); ++i)
+            stats[i] = dirCache.statInput(root, *names[i]);
+        return;
+    }
+
+    TaskGroup group(*pool);
+
+    for (size_t begin = 0; begin < names.size(); begin += batchSize) {
+        const size_t end = std::min(begin + batchSize, names.size());
+
+        group.run([&, begin, end] {
+            for (size_t i = begin; i < end; ++i)
+                stats[i] = dirCache.statInput(root, *names[i]);
+        });
+    }
+
+    group.wait();
+}
+
+/**
+ * Reads the glob patterns and options on the stack, starting at index `first`.
+ */
+void parseGlobArgs(lua_State* L, int first, DirCache& dirCache,
+        GlobRequest& request) {
 
     int argc = lua_gettop(L);
 
@@ -50,14 +280,16 @@ int lua_glob(lua_State* L) {
     if (!scriptDir || scriptDir[0] == '\0')
         scriptDir = ".";
 
-    Path root = scriptDir;
+    request.root = scriptDir;
 
     lua_pop(L, 1); // Pop SCRIPT_DIR
 
+    globOptions(L, first, dirCache, request);
+
     size_t len;
     const char* path;
 
-    for (int i = 1; i <= argc; ++i) {
+    for (int i = first; i <= argc; ++i) {
         const int type = lua_type(L, i);
 
         if (type == LUA_TTABLE) {
@@ -68,29 +300,83 @@ int lua_glob(lua_State* L) {
                     break;
                 }
 
-                path = lua_tolstring(L, -1, &len);
-                if (path) {
-                    if (len > 0 && path[0] == '!')
-                        dirCache.glob(root, Path(path+1, len-1), exclude, &pool);
-                    else
-                        dirCache.glob(root, Path(path, len), include, &pool);
-                }
+                path = lua_topath(L, -1, &len);
+                if (path)
+                    request.patterns.emplace_back(path, len);
 
                 lua_pop(L, 1); // Pop path
             }
         }
-        else if (type == LUA_TSTRING) {
-            path = luaL_checklstring(L, i, &len);
-
-            if (len > 0 && path[0] == '!')
-                dirCache.glob(root, Path(path+1, len-1), exclude, &pool);
-            else
-                dirCache.glob(root, Path(path, len), include, &pool);
+        else if (type == LUA_TSTRING || type == LUA_TUSERDATA) {
+            // Patterns can also be path handles.
+            path = lua_topath(L, i, &len);
+            if (path)
+                request.patterns.emplace_back(path, len);
         }
     }
+}
+
+/**
+ * Evaluates a glob request and returns the set of matching paths. If the stat
+ * option was given, the metadata for each path is also returned (in the same
+ * order as the set) and true is returned.
+ *
+ * This does not touch the Lua state and so can be run on any thread.
+ */
+bool runGlob(DirCache& dirCache, ThreadPool* pool, const GlobRequest& request,
+        std::set<std::string>& paths, std::vector<FileStat>& stats) {
+
+    std::mutex mutex;
+
+    // Adds a path to the set.
+    auto include = [&] (Path path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths.emplace(path.path, path.length);
+    };
+
+    // Removes a path from the set.
+    auto exclude = [&] (Path path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths.erase(std::string(path.path, path.length));
+    };
+
+    const Path root = request.root;
+
+    for (auto&& p: request.patterns)
+        globPattern(dirCache, pool, root, request.options, p.data(), p.size(),
+                include, exclude);
+
+    if (request.stat)
+        statPaths(dirCache, pool, root, paths, stats);
 
-    // Construct the Lua table.
-    lua_newtable(L);
+    return request.stat;
+}
+
+/**
+ * Evaluates all of the glob patterns on the stack, starting at index `first`,
+ * and returns the set of matching paths. See runGlob.
+ */
+bool globArgs(lua_State* L, int first, std::set<std::string>& paths,
+        std::vector<FileStat>& stats) {
+
+    DirCache& dirCache = lua_globals::dirCache(L);
+    ThreadPool& pool = lua_globals::threadPool(L);
+
+    GlobRequest request;
+    parseGlobArgs(L, first, dirCache, request);
+
+    return runGlob(dirCache, &pool, request, paths, stats);
+}
+
+/**
+ * Pushes the table of paths. If there are stats, also pushes the tables of
+ * sizes and modification times that line up with the table of paths. Returns
+ * the number of values pushed.
+ */
+int pushGlobTables(lua_State* L, const std::set<std::string>& paths,
+        const std::vector<FileStat>& stats, bool stat) {
+
+    lua_createtable(L, (int)paths.size(), 0);
     lua_Integer n = 1;
 
     for (auto&& p: paths) {
@@ -99,5 +385,427 @@ int lua_glob(lua_State* L) {
         ++n;
     }
 
+    if (!stat)
+        return 1;
+
+    lua_createtable(L, (int)stats.size(), 0);
+    lua_createtable(L, (int)stats.size(), 0);
+
+    for (size_t i = 0; i < stats.size(); ++i) {
+        lua_pushinteger(L, (lua_Integer)stats[i].size);
+        lua_rawseti(L, -3, (lua_Integer)i + 1);
+
+        lua_pushnumber(L, stats[i].mtime);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+
+    return 3;
+}
+
+/**
+ * A glob running in the background. This is shared between the Lua handle and
+ * the task evaluating it, such that either one can go away first.
+ */
+struct AsyncGlob {
+    GlobRequest request;
+
+    // Results. Only valid once done is set.
+    std::set<std::string> paths;
+    std::vector<FileStat> stats;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done;
+
+    AsyncGlob() : done(false) {}
+
+    bool ready() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done;
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return done; });
+    }
+};
+
+typedef std::shared_ptr<AsyncGlob> GlobHandle;
+
+AsyncGlob& checkGlobHandle(lua_State* L, int i) {
+    return **(GlobHandle*)luaL_checkudata(L, i, globHandleType);
+}
+
+int globhandle_gc(lua_State* L) {
+    ((GlobHandle*)luaL_checkudata(L, 1, globHandleType))->~GlobHandle();
+    return 0;
+}
+
+/**
+ * Creates the metatable for glob handles.
+ */
+void registerGlobHandle(lua_State* L) {
+    if (!luaL_newmetatable(L, globHandleType)) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    lua_pushcfunction(L, globhandle_gc);
+    lua_setfield(L, -2, "__gc");
+
+    lua_pop(L, 1); // Pop metatable
+}
+
+/**
+ * Starts a glob in the thread pool and returns a handle to it immediately.
+ */
+int glob_async(lua_State* L) {
+    DirCache* dirCache = &lua_globals::dirCache(L);
+    ThreadPool* pool = &lua_globals::threadPool(L);
+
+    checkGlobArgs(L, 1);
+
+    GlobHandle handle = std::make_shared<AsyncGlob>();
+
+    parseGlobArgs(L, 1, *dirCache, handle->request);
+
+    void* p = lua_newuserdata(L, sizeof(GlobHandle));
+    new (p) GlobHandle(handle);
+    luaL_setmetatable(L, globHandleType);
+
+    // The glob's own tasks are waited on from inside of this task. That is
+    // fine since waiting threads run other tasks in the meantime.
+    pool->enqueueTask([dirCache, pool, handle] {
+        AsyncGlob& g = *handle;
+
+        runGlob(*dirCache, pool, g.request, g.paths, g.stats);
+
+        {
+            std::lock_guard<std::mutex> lock(g.mutex);
+            g.done = true;
+        }
+
+        g.cond.notify_all();
+    });
+
+    return 1;
+}
+
+/**
+ * Returns true if the asynchronous glob has finished such that glob.await
+ * won't block.
+ */
+int glob_ready(lua_State* L) {
+    lua_pushboolean(L, checkGlobHandle(L, 1).ready());
+    return 1;
+}
+
+/**
+ * Waits for an asynchronous glob to finish and returns the same values as
+ * glob.
+ */
+int glob_await(lua_State* L) {
+    AsyncGlob& g = checkGlobHandle(L, 1);
+
+    g.wait();
+
+    return pushGlobTables(L, g.paths, g.stats, g.request.stat);
+}
+
+/**
+ * Creates a new, empty glob result on the top of the stack.
+ */
+GlobResult* newGlobResult(lua_State* L) {
+    void* p = lua_newuserdata(L, sizeof(GlobResult));
+    GlobResult* result = new (p) GlobResult();
+    luaL_setmetatable(L, globResultType);
+    return result;
+}
+
+GlobResult* checkGlobResult(lua_State* L, int i) {
+    return (GlobResult*)luaL_checkudata(L, i, globResultType);
+}
+
+/**
+ * Pushes the path at the given 1-based index. Pushes nil if the index is out of
+ * bounds.
+ */
+void pushGlobResultPath(lua_State* L, const GlobResult* result, lua_Integer i) {
+    if (i >= 1 && (size_t)i <= result->size()) {
+        Path p = (*result)[(size_t)i - 1];
+        lua_pushlstring(L, p.path, p.length);
+    }
+    else {
+        lua_pushnil(L);
+    }
+}
+
+int globresult_gc(lua_State* L) {
+    checkGlobResult(L, 1)->~GlobResult();
+    return 0;
+}
+
+int globresult_len(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)checkGlobResult(L, 1)->size());
+    return 1;
+}
+
+/**
+ * Indexing with an integer returns the path at that index. Anything else is
+ * looked up in the method table (the first upvalue).
+ */
+int globresult_index(lua_State* L) {
+    const GlobResult* result = checkGlobResult(L, 1);
+
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        pushGlobResultPath(L, result, lua_tointeger(L, 2));
+        return 1;
+    }
+
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    return 1;
+}
+
+int globresult_next(lua_State* L) {
+    const GlobResult* result = checkGlobResult(L, 1);
+    lua_Integer i = luaL_checkinteger(L, 2) + 1;
+
+    if (i < 1 || (size_t)i > result->size())
+        return 0;
+
+    lua_pushinteger(L, i);
+    pushGlobResultPath(L, result, i);
+    return 2;
+}
+
+/**
+ * Only needed for Lua 5.2. Later versions of ipairs respect __index.
+ */
+int globresult_ipairs(lua_State* L) {
+    checkGlobResult(L, 1);
+    lua_pushcfunction(L, globresult_next);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+
+/**
+ * Returns true if the path's extension is in the list of extensions.
+ */
+bool hasExtension(Path path, const std::vector<Path>& exts) {
+    const Path ext = path.splitExtension().tail;
+
+    for (auto&& e: exts) {
+        if (ext == e)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Returns a new glob result with only the paths that have one of the given
+ * extensions. The extensions can be given as strings or tables of strings.
+ */
+int globresult_filter(lua_State* L) {
+    const GlobResult* result = checkGlobResult(L, 1);
+
+    int argc = lua_gettop(L);
+
+    // Checked before anything is allocated since raising an error skips
+    // destructors.
+    for (int i = 2; i <= argc; ++i) {
+        if (lua_type(L, i) != LUA_TTABLE)
+            luaL_checkstring(L, i);
+    }
+
+    std::vector<Path> exts;
+
+    size_t len;
+    const char* ext;
+
+    // Note that the extension strings remain valid because they stay on the
+    // stack (or in a table on the stack) until we return.
+    for (int i = 2; i <= argc; ++i) {
+        if (lua_type(L, i) == LUA_TTABLE) {
+            for (int j = 1; ; ++j) {
+                lua_rawgeti(L, i, j);
+                if (lua_type(L, -1) != LUA_TSTRING) {
+                    lua_pop(L, 1);
+                    break;
+                }
+
+                ext = lua_tolstring(L, -1, &len);
+                lua_pop(L, 1);
+
+                exts.push_back(Path(ext, len));
+            }
+        }
+        else {
+            ext = lua_tolstring(L, i, &len);
+            exts.push_back(Path(ext, len));
+        }
+    }
+
+    GlobResult* filtered = newGlobResult(L);
+
+    const bool stats = result->hasStats();
+
+    for (size_t i = 0; i < result->size(); ++i) {
+        Path p = (*result)[i];
+        if (!hasExtension(p, exts))
+            continue;
+
+        if (stats)
+            filtered->add(p.path, p.length, result->stat(i));
+        else
+            filtered->add(p.path, p.length);
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the size and modification time of the path at the given index. Only
+ * available if the glob was done with the stat option.
+ */
+int globresult_stat(lua_State* L) {
+    const GlobResult* result = checkGlobResult(L, 1);
+    lua_Integer i = luaL_checkinteger(L, 2);
+
+    luaL_argcheck(L, i >= 1 && (size_t)i <= result->size(), 2,
+            "index out of bounds");
+
+    if (!result->hasStats())
+        return luaL_error(L, "glob was not done with the 'stat' option");
+
+    const FileStat& st = result->stat((size_t)i - 1);
+    lua_pushinteger(L, (lua_Integer)st.size);
+    lua_pushnumber(L, st.mtime);
+    return 2;
+}
+
+/**
+ * Converts the glob result to a table of strings.
+ */
+int globresult_totable(lua_State* L) {
+    const GlobResult* result = checkGlobResult(L, 1);
+
+    const size_t n = result->size();
+
+    lua_createtable(L, (int)n, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        Path p = (*result)[i];
+        lua_pushlstring(L, p.path, p.length);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+
+    return 1;
+}
+
+const luaL_Reg globresult_methods[] = {
+    {"filter", globresult_filter},
+    {"totable", globresult_totable},
+    {"stat", globresult_stat},
+    {NULL, NULL}
+};
+
+/**
+ * Creates the metatable for glob results.
+ */
+void registerGlobResult(lua_State* L) {
+    if (!luaL_newmetatable(L, globResultType)) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    lua_pushcfunction(L, globresult_gc);
+    lua_setfield(L, -2, "__gc");
+
+    lua_pushcfunction(L, globresult_len);
+    lua_setfield(L, -2, "__len");
+
+    lua_pushcfunction(L, globresult_ipairs);
+    lua_setfield(L, -2, "__ipairs");
+
+    luaL_newlib(L, globresult_methods);
+    lua_pushcclosure(L, globresult_index, 1);
+    lua_setfield(L, -2, "__index");
+
+    lua_pop(L, 1); // Pop metatable
+}
+
+/**
+ * Called when the glob table is called like a function. The first argument is
+ * the glob table itself.
+ */
+int glob_call(lua_State* L) {
+    lua_remove(L, 1);
+    return lua_glob(L);
+}
+
+const luaL_Reg globlib[] = {
+    {"lazy", lua_glob_lazy},
+    {"async", glob_async},
+    {"await", glob_await},
+    {"ready", glob_ready},
+    {NULL, NULL}
+};
+
+}
+
+int lua_glob(lua_State* L) {
+
+    checkGlobArgs(L, 1);
+
+    std::set<std::string> paths;
+    std::vector<FileStat> stats;
+
+    const bool stat = globArgs(L, 1, paths, stats);
+
+    return pushGlobTables(L, paths, stats, stat);
+}
+
+int lua_glob_lazy(lua_State* L) {
+
+    checkGlobArgs(L, 1);
+
+    std::set<std::string> paths;
+    std::vector<FileStat> stats;
+
+    const bool stat = globArgs(L, 1, paths, stats);
+
+    size_t bytes = 0;
+    for (auto&& p: paths)
+        bytes += p.length();
+
+    GlobResult* result = newGlobResult(L);
+    result->reserve(paths.size(), bytes);
+
+    size_t i = 0;
+    for (auto&& p: paths) {
+        if (stat)
+            result->add(p.data(), p.length(), stats[i++]);
+        else
+            result->add(p.data(), p.length());
+    }
+
+    return 1;
+}
+
+int luaopen_glob(lua_State* L) {
+    registerGlobResult(L);
+    registerGlobHandle(L);
+
+    luaL_newlib(L, globlib);
+
+    // Make the module table callable such that `glob {...}` still works.
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, glob_call);
+    lua_setfield(L, -2, "__call");
+    lua_setmetatable(L, -2);
+
     return 1;
 }
@@ -18,6 +18,51 @@ struct lua_State;
  * Arguments:
  *  - pattern: A pattern string or table of pattern strings
  *
- * Returns: A table of the matching files.
+ * A table of patterns can also have these options:
+ *  - ignore: Pattern(s) of paths to skip, using .gitignore syntax.
+ *  - ignore_file: Path(s) to .gitignore-style files to take patterns from.
+ *  - max_depth: Maximum number of directories to descend into.
+ *  - stat: If true, also gets the size and modification time of each file.
+ *
+ * Ignored directories are never listed. Metadata is gathered in batches on the
+ * thread pool after the set of matching paths is known, so excluded paths are
+ * never stat'd. If a file could not be stat'd, its size is -1.
+ *
+ * Returns: A table of the matching files. With the stat option, tables of the
+ * sizes and modification times are also returned.
  */
 int lua_glob(lua_State* L);
+
+/**
+ * Like lua_glob, but returns a userdata result set instead of a table. Strings
+ * are only created for the paths that are accessed. The result set supports
+ * `#`, indexing, `ipairs`, and the methods:
+ *
+ *  - filter(ext, ...): Returns a new result set with only the paths that have
+ *    one of the given extensions.
+ *  - totable(): Converts the result set to a table of strings.
+ *  - stat(i): Returns the size and modification time of path i. Only available
+ *    with the stat option.
+ */
+int lua_glob_lazy(lua_State* L);
+
+/**
+ * The glob library also has functions for overlapping many globs with the
+ * evaluation of the script:
+ *
+ *  - async(pattern): Takes the same arguments as lua_glob, but starts the glob
+ *    in the thread pool and immediately returns a handle to it.
+ *  - await(handle): Waits for the glob to finish and returns the same values as
+ *    lua_glob.
+ *  - ready(handle): Returns true if await would not block. A coroutine can
+ *    yield until this is true.
+ *
+ * Synchronous globs only wait for their own tasks, so they are not held up by
+ * asynchronous globs that are still running.
+ */
+
+/**
+ * Pushes the glob library onto the stack so that it can be registered. The
+ * library table can be called directly as an alias for lua_glob.
+ */
+int luaopen_glob(lua_State* L);
@@ -44,4 +44,55 @@ DirCache& dirCache(lua_State* L) {
     return *dirCache;
 }
 
+ScriptCache& scriptCache(lua_State* L) {
+    // Get the script cache object.
+    lua_getglobal(L, "__SCRIPT_CACHE");
+    ScriptCache* scriptCache = (ScriptCache*)lua_topointer(L, -1);
+    lua_pop(L, 1); // Pop __SCRIPT_CACHE
+
+    if (!scriptCache) {
+        // This would probably only happen if someone messes with this global
+        // variable in a Lua script.
+        luaL_error(L, "__SCRIPT_CACHE does not point to any object");
+
+        // Never returns.
+    }
+
+    return *scriptCache;
+}
+
+PathTable& pathTable(lua_State* L) {
+    // Get the path table object.
+    lua_getglobal(L, "__PATH_TABLE");
+    PathTable* pathTable = (PathTable*)lua_topointer(L, -1);
+    lua_pop(L, 1); // Pop __PATH_TABLE
+
+    if (!pathTable) {
+        // This would probably only happen if someone messes with this global
+        // variable in a Lua script.
+        luaL_error(L, "__PATH_TABLE does not point to any object");
+
+        // Never returns.
+    }
+
+    return *pathTable;
+}
+
+ImplicitDeps& implicitDeps(lua_State* L) {
+    // Get the implicit dependencies object.
+    lua_getglobal(L, "__DEPS");
+    ImplicitDeps* deps = (ImplicitDeps*)lua_topointer(L, -1);
+    lua_pop(L, 1); // Pop __DEPS
+
+    if (!deps) {
+        // This would probably only happen if someone messes with this global
+        // variable in a Lua script.
+        luaL_error(L, "__DEPS does not point to any object");
+
+        // Never returns.
+    }
+
+    return *deps;
+}
+
 }
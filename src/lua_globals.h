@@ -10,6 +10,9 @@
 
 #include "threadpool.h"
 #include "dircache.h"
+#include "scriptcache.h"
+#include "pathtable.h"
+#include "deps.h"
 
 namespace lua_globals {
 
@@ -26,4 +29,19 @@ ThreadPool& threadPool(lua_State* L);
  */
 DirCache& dirCache(lua_State* L);
 
+/**
+ * Like threadPool, but returns the script cache object.
+ */
+ScriptCache& scriptCache(lua_State* L);
+
+/**
+ * Like threadPool, but returns the path table object.
+ */
+PathTable& pathTable(lua_State* L);
+
+/**
+ * Like threadPool, but returns the object for reporting implicit dependencies.
+ */
+ImplicitDeps& implicitDeps(lua_State* L);
+
 }
@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Hashing of strings and files.
+ */
+#include "lua.hpp"
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lua_hash.h"
+#include "lua_globals.h"
+#include "lua_path.h"
+#include "mappedfile.h"
+#include "sha256.h"
+#include "xxh3.h"
+
+namespace {
+
+enum class Algorithm {
+    xxh3,
+    sha256,
+};
+
+const char* const algorithms[] = {"xxh3", "sha256", NULL};
+
+/**
+ * Number of files hashed by each task.
+ */
+const size_t batchSize = 8;
+
+struct Digest {
+    uint8_t bytes[Sha256::digestSize];
+    size_t length;
+};
+
+/**
+ * A file to be hashed on the thread pool.
+ */
+struct FileHash {
+    std::string path;
+    Digest digest;
+    bool ok;
+
+    explicit FileHash(std::string path) : path(std::move(path)), ok(false) {}
+};
+
+Algorithm checkAlgorithm(lua_State* L, int arg) {
+    return (Algorithm)luaL_checkoption(L, arg, "xxh3", algorithms);
+}
+
+void computeDigest(Algorithm algorithm, const void* data, size_t length,
+        Digest& digest) {
+
+    if (algorithm == Algorithm::sha256) {
+        Sha256::hash(data, length, digest.bytes);
+        digest.length = Sha256::digestSize;
+        return;
+    }
+
+    // Big endian such that the hex string is the same as the number.
+    const uint64_t h = xxh3(data, length);
+
+    for (size_t i = 0; i < 8; ++i)
+        digest.bytes[i] = (uint8_t)(h >> (56 - 8 * i));
+
+    digest.length = 8;
+}
+
+void pushDigest(lua_State* L, const Digest& digest) {
+    static const char hexDigits[] = "0123456789abcdef";
+
+    char hex[2 * Sha256::digestSize];
+
+    for (size_t i = 0; i < digest.length; ++i) {
+        hex[2 * i]     = hexDigits[digest.bytes[i] >> 4];
+        hex[2 * i + 1] = hexDigits[digest.bytes[i] & 0xF];
+    }
+
+    lua_pushlstring(L, hex, 2 * digest.length);
+}
+
+void hashFile(Algorithm algorithm, FileHash& f) {
+    MappedFile file;
+
+    f.ok = file.open(f.path.c_str());
+    if (f.ok)
+        computeDigest(algorithm, file.data(), file.length(), f.digest);
+}
+
+/**
+ * Reports the file as a dependency, with its checksum if it is known.
+ */
+void addInput(lua_State* L, Algorithm algorithm, const FileHash& f) {
+    ImplicitDeps& deps = lua_globals::implicitDeps(L);
+
+    if (!f.ok || algorithm != Algorithm::sha256) {
+        deps.addInputOnce(f.path.data(), f.path.length());
+        return;
+    }
+
+    std::vector<char> buf(sizeof(Dependency) + f.path.length());
+
+    Dependency* dep = (Dependency*)buf.data();
+    dep->status = 2;
+    memcpy(dep->checksum, f.digest.bytes, sizeof(dep->checksum));
+    dep->length = (uint32_t)f.path.length();
+    memcpy(dep->name, f.path.data(), f.path.length());
+
+    deps.addInputOnce(*dep);
+}
+
+/**
+ * Gets the normalized path at the given index.
+ */
+std::string checkNormPath(lua_State* L, int arg) {
+    size_t len;
+    const char* path = lua_checkpath(L, arg, &len);
+
+    std::string buf;
+    Path(path, len).norm(buf);
+    return buf;
+}
+
+int hash_string(lua_State* L) {
+    size_t len;
+    const char* s = luaL_checklstring(L, 1, &len);
+
+    Digest digest;
+    computeDigest(checkAlgorithm(L, 2), s, len, digest);
+
+    pushDigest(L, digest);
+    return 1;
+}
+
+int hash_file(lua_State* L) {
+    const Algorithm algorithm = checkAlgorithm(L, 2);
+    FileHash f(checkNormPath(L, 1));
+
+    hashFile(algorithm, f);
+    addInput(L, algorithm, f);
+
+    if (!f.ok) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cannot read '%s'", f.path.c_str());
+        return 2;
+    }
+
+    pushDigest(L, f.digest);
+    return 1;
+}
+
+int hash_files(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    const Algorithm algorithm = checkAlgorithm(L, 2);
+
+    std::vector<FileHash> files;
+
+    for (int i = 1; ; ++i) {
+        lua_rawgeti(L, 1, i);
+
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+        if (!path)
+            return luaL_error(L, "bad element #%d of argument #1 (string "
+                    "expected, got %s)", i, luaL_typename(L, -1));
+
+        std::string buf;
+        Path(path, len).norm(buf);
+        files.push_back(FileHash(std::move(buf)));
+
+        lua_pop(L, 1);
+    }
+
+    {
+        TaskGroup group(lua_globals::threadPool(L));
+
+        FileHash* data = files.data();
+
+        for (size_t begin = 0; begin < files.size(); begin += batchSize) {
+            const size_t end = (files.size() - begin > batchSize) ?
+                begin + batchSize : files.size();
+
+            group.run([=] {
+                for (size_t i = begin; i < end; ++i)
+                    hashFile(algorithm, data[i]);
+            });
+        }
+    }
+
+    lua_createtable(L, (int)files.size(), 0);
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        addInput(L, algorithm, files[i]);
+
+        if (files[i].ok)
+            pushDigest(L, files[i].digest);
+        else
+            lua_pushboolean(L, 0);
+
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+
+    return 1;
+}
+
+const luaL_Reg hashlib[] = {
+    {"string", hash_string},
+    {"file", hash_file},
+    {"files", hash_files},
+    {NULL, NULL}
+};
+
+}
+
+int luaopen_hash(lua_State* L) {
+    luaL_newlib(L, hashlib);
+    return 1;
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Hashing of strings and files.
+ */
+#pragma once
+
+struct lua_State;
+
+/**
+ * Pushes the hash library onto the stack so that it can be registered. It has
+ * the functions:
+ *
+ *  - string(s, algorithm): Returns the hash of the string.
+ *  - file(path, algorithm): Returns the hash of the file's contents, or nil
+ *    and an error message if it could not be read.
+ *  - files(paths, algorithm): Returns a table of the hashes of the files in
+ *    the same order, where files that could not be read are false. The files
+ *    are hashed on the thread pool.
+ *
+ * The algorithm is either "xxh3" (the default), which is very fast and good
+ * enough for cache keys, or "sha256". Hashes are returned as lowercase hex
+ * strings in the same form as xxhsum and sha256sum print them.
+ *
+ * Files are memory mapped and reported as dependencies. When the algorithm is
+ * SHA-256, the checksum is sent along with the dependency such that the parent
+ * build system doesn't have to compute it again.
+ */
+int luaopen_hash(lua_State* L);
@@ -0,0 +1,637 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Parallel importing of build scripts.
+ */
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "lua.hpp"
+
+#include "lua_import.h"
+#include "lua_globals.h"
+#include "button-lua.h"
+#include "embedded.h"
+#include "deps.h"
+#include "path.h"
+#include "luaalloc.h"
+#include "lua_path.h"
+
+namespace {
+
+/**
+ * A recorded function call.
+ */
+struct Call {
+    // Value of SCRIPT_DIR when the call was made.
+    std::string scriptDir;
+
+    // Module to get the function from. If empty, the function is a global.
+    std::string module;
+    std::string function;
+
+    // The encoded arguments.
+    std::string args;
+    int nargs;
+};
+
+/**
+ * A build script to evaluate in its own Lua state.
+ */
+struct ImportJob {
+    // Path to load the script from.
+    std::string file;
+
+    // Value of SCRIPT_DIR for the script.
+    std::string scriptDir;
+
+    std::vector<Call> calls;
+
+    // Set if the script failed.
+    bool failed;
+    std::string error;
+
+    ImportJob() : failed(false) {}
+};
+
+/**
+ * Type tags for encoded values.
+ */
+enum Tag : char {
+    tagNil     = 'n',
+    tagTrue    = 't',
+    tagFalse   = 'f',
+    tagInteger = 'i',
+    tagNumber  = 'd',
+    tagString  = 's',
+    tagTable   = 'T',
+    tagPath    = 'p',
+};
+
+template<class T>
+void encodeRaw(std::string& buf, T x) {
+    buf.append((const char*)&x, sizeof(x));
+}
+
+template<class T>
+T decodeRaw(const char*& p) {
+    T x;
+    memcpy(&x, p, sizeof(x));
+    p += sizeof(x);
+    return x;
+}
+
+/**
+ * Orders table keys such that tables are always copied in the same order.
+ * Numbers come first, then strings, then booleans.
+ */
+struct Key {
+    int type;
+    lua_Number number;
+    std::string string;
+    bool boolean;
+
+    Key() : type(0), number(0), boolean(false) {}
+
+    bool operator<(const Key& other) const {
+        if (type != other.type)
+            return type < other.type;
+
+        switch (type) {
+            case LUA_TNUMBER:  return number < other.number;
+            case LUA_TSTRING:  return string < other.string;
+            default:           return boolean < other.boolean;
+        }
+    }
+};
+
+int keyOrder(int type) {
+    switch (type) {
+        case LUA_TNUMBER: return 0;
+        case LUA_TSTRING: return 1;
+        default:          return 2;
+    }
+}
+
+/**
+ * Converts the number to an integer if it is one. The range is checked first
+ * since converting an out of range float is undefined.
+ */
+bool toInteger(lua_Number n, lua_Integer& k) {
+    const lua_Number min = (lua_Number)std::numeric_limits<lua_Integer>::min();
+
+    if (!(n >= min && n < -min))
+        return false;
+
+    k = (lua_Integer)n;
+    return (lua_Number)k == n;
+}
+
+bool encode(lua_State* L, int i, std::string& buf,
+        std::vector<const void*>& tables, std::string& error);
+
+/**
+ * Encodes the table at the given index. Returns false and sets the error
+ * message if it can't be copied.
+ *
+ * Errors are returned rather than raised such that the destructors of the
+ * keys still run.
+ */
+bool encodeTable(lua_State* L, int i, std::string& buf,
+        std::vector<const void*>& tables, std::string& error) {
+
+    const void* p = lua_topointer(L, i);
+
+    if (std::find(tables.begin(), tables.end(), p) != tables.end()) {
+        error = "cannot pass a table that contains itself to import_all";
+        return false;
+    }
+
+    if (lua_getmetatable(L, i)) {
+        lua_pop(L, 1);
+        error = "cannot pass a table with a metatable to import_all";
+        return false;
+    }
+
+    tables.push_back(p);
+
+    std::vector<Key> keys;
+
+    lua_pushnil(L);
+    while (lua_next(L, i)) {
+        lua_pop(L, 1); // Pop value
+
+        Key key;
+        key.type = lua_type(L, -1);
+
+        switch (key.type) {
+            case LUA_TNUMBER:
+                key.number = lua_tonumber(L, -1);
+                break;
+            case LUA_TSTRING: {
+                size_t len;
+                const char* s = lua_tolstring(L, -1, &len);
+                key.string.assign(s, len);
+                break;
+            }
+            case LUA_TBOOLEAN:
+                key.boolean = lua_toboolean(L, -1) != 0;
+                break;
+            default:
+                error = std::string("cannot pass a table with ") +
+                    luaL_typename(L, -1) + " keys to import_all";
+                lua_pop(L, 1); // Pop key
+                return false;
+        }
+
+        key.type = keyOrder(key.type);
+        keys.push_back(key);
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    buf.push_back(tagTable);
+    encodeRaw(buf, keys.size());
+
+    for (auto&& key: keys) {
+        switch (key.type) {
+            case 0:  lua_pushnumber(L, key.number); break;
+            case 1:  lua_pushlstring(L, key.string.data(), key.string.size()); break;
+            default: lua_pushboolean(L, key.boolean); break;
+        }
+
+        // Integer keys are looked up as integers such that arrays stay arrays.
+        lua_Integer k;
+        if (key.type == 0 && toInteger(key.number, k)) {
+            lua_pop(L, 1);
+            lua_pushinteger(L, k);
+        }
+
+        if (!encode(L, lua_gettop(L), buf, tables, error)) {
+            lua_pop(L, 1);
+            return false;
+        }
+
+        lua_rawget(L, i);
+        const bool ok = encode(L, lua_gettop(L), buf, tables, error);
+        lua_pop(L, 1);
+
+        if (!ok)
+            return false;
+    }
+
+    tables.pop_back();
+    return true;
+}
+
+/**
+ * Encodes the value at the given index. Returns false and sets the error
+ * message if the value can't be copied to another Lua state.
+ */
+bool encode(lua_State* L, int i, std::string& buf,
+        std::vector<const void*>& tables, std::string& error) {
+
+    switch (lua_type(L, i)) {
+        case LUA_TNIL:
+            buf.push_back(tagNil);
+            break;
+
+        case LUA_TBOOLEAN:
+            buf.push_back(lua_toboolean(L, i) ? tagTrue : tagFalse);
+            break;
+
+        case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(L, i)) {
+                buf.push_back(tagInteger);
+                encodeRaw(buf, lua_tointeger(L, i));
+                break;
+            }
+#endif
+            buf.push_back(tagNumber);
+            encodeRaw(buf, lua_tonumber(L, i));
+            break;
+
+        case LUA_TSTRING: {
+            size_t len;
+            const char* s = lua_tolstring(L, i, &len);
+            buf.push_back(tagString);
+            encodeRaw(buf, len);
+            buf.append(s, len);
+            break;
+        }
+
+        case LUA_TTABLE:
+            return encodeTable(L, i, buf, tables, error);
+
+        case LUA_TUSERDATA: {
+            // The path table is shared by all Lua states, so only the ID of a
+            // path handle is needed.
+            PathTable* table;
+            PathId id;
+            if (lua_topathid(L, i, &table, &id)) {
+                buf.push_back(tagPath);
+                encodeRaw(buf, id);
+                break;
+            }
+        }
+
+            // Result sets (e.g., from glob.lazy) can be converted to tables.
+            if (luaL_getmetafield(L, i, "__index")) {
+                lua_pop(L, 1);
+                lua_getfield(L, i, "totable");
+                if (lua_type(L, -1) == LUA_TFUNCTION) {
+                    lua_pushvalue(L, i);
+
+                    if (lua_pcall(L, 1, 1, 0) != LUA_OK) {
+                        const char* msg = lua_tostring(L, -1);
+                        error = msg ? msg : "unknown error";
+                        lua_pop(L, 1);
+                        return false;
+                    }
+
+                    const bool ok = lua_type(L, -1) == LUA_TTABLE &&
+                        encodeTable(L, lua_gettop(L), buf, tables, error);
+                    lua_pop(L, 1);
+                    if (!ok && error.empty())
+                        error = "totable did not return a table";
+                    return ok;
+                }
+                lua_pop(L, 1);
+            }
+
+            // Fall through
+
+        default:
+            error = std::string("cannot pass a ") + luaL_typename(L, i) +
+                " to import_all";
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Pushes the next encoded value.
+ */
+void decode(lua_State* L, const char*& p) {
+    luaL_checkstack(L, 3, "too many nested tables");
+
+    switch (*p++) {
+        case tagNil:
+            lua_pushnil(L);
+            break;
+
+        case tagTrue:
+            lua_pushboolean(L, 1);
+            break;
+
+        case tagFalse:
+            lua_pushboolean(L, 0);
+            break;
+
+        case tagInteger:
+            lua_pushinteger(L, decodeRaw<lua_Integer>(p));
+            break;
+
+        case tagNumber:
+            lua_pushnumber(L, decodeRaw<lua_Number>(p));
+            break;
+
+        case tagString: {
+            size_t len = decodeRaw<size_t>(p);
+            lua_pushlstring(L, p, len);
+            p += len;
+            break;
+        }
+
+        case tagPath:
+            lua_pushpath(L, lua_globals::pathTable(L), decodeRaw<PathId>(p));
+            break;
+
+        case tagTable: {
+            size_t n = decodeRaw<size_t>(p);
+            lua_createtable(L, 0, 0);
+            for (size_t i = 0; i < n; ++i) {
+                decode(L, p); // Key
+                decode(L, p); // Value
+                lua_rawset(L, -3);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Records a call made by a build script running in a worker state. The first
+ * upvalue is the import job.
+ */
+int record(lua_State* L) {
+    ImportJob* job = (ImportJob*)lua_touserdata(L, lua_upvalueindex(1));
+
+    const char* module = luaL_checkstring(L, 1);
+    const char* function = luaL_checkstring(L, 2);
+
+    const int argc = lua_gettop(L);
+
+    lua_getglobal(L, "SCRIPT_DIR");
+    const char* dir = lua_tostring(L, -1);
+
+    // Errors are raised once the call has been destroyed. Raising an error
+    // skips destructors.
+    bool ok;
+
+    {
+        Call call;
+        call.module = module;
+        call.function = function;
+        if (dir)
+            call.scriptDir = dir;
+
+        std::vector<const void*> tables;
+        std::string error;
+
+        ok = true;
+        for (int i = 3; ok && i <= argc; ++i)
+            ok = encode(L, i, call.args, tables, error);
+
+        call.nargs = argc - 2;
+
+        if (ok)
+            job->calls.push_back(std::move(call));
+        else
+            lua_pushlstring(L, error.data(), error.size());
+    }
+
+    if (!ok)
+        return lua_error(L);
+
+    return 0;
+}
+
+/**
+ * Evaluates a build script in a new Lua state and records the calls it makes.
+ */
+void runImport(ImportJob& job, DirCache& dirCache, ThreadPool& pool,
+        ImplicitDeps& deps, ScriptCache& scriptCache, PathTable& pathTable) {
+
+    // Must outlive the Lua state.
+    LuaAllocator allocator;
+
+    lua_State* L = lua_newstate(LuaAllocator::alloc, &allocator);
+    if (!L) {
+        job.failed = true;
+        job.error = "failed to create Lua state";
+        return;
+    }
+
+    if (buttonlua::init(L) == 0) {
+        buttonlua::setup(L, dirCache, pool, deps, scriptCache, pathTable);
+
+        lua_pushlstring(L, job.scriptDir.data(), job.scriptDir.size());
+        lua_setglobal(L, "SCRIPT_DIR");
+
+        deps.addInput(job.file.data(), job.file.size());
+
+        if (load_worker(L) == LUA_OK) {
+            lua_pushlightuserdata(L, &job);
+            lua_pushcclosure(L, record, 1);
+
+            if (lua_pcall(L, 1, 0, 0) == LUA_OK &&
+                scriptCache.load(L, job.file.c_str()) == LUA_OK &&
+                lua_pcall(L, 0, 0, 0) == LUA_OK) {
+                lua_close(L);
+                return;
+            }
+        }
+    }
+
+    job.failed = true;
+
+    if (const char* msg = lua_tostring(L, -1))
+        job.error = msg;
+    else
+        job.error = "unknown error";
+
+    lua_close(L);
+}
+
+/**
+ * Makes the recorded call given as light userdata. This is called with
+ * lua_pcall such that errors never skip the destructors of the import jobs.
+ */
+int replay(lua_State* L) {
+    const Call* call = (const Call*)lua_touserdata(L, 1);
+
+    lua_pushlstring(L, call->scriptDir.data(), call->scriptDir.size());
+    lua_setglobal(L, "SCRIPT_DIR");
+
+    if (call->module.empty()) {
+        lua_getglobal(L, call->function.c_str());
+    }
+    else {
+        lua_getglobal(L, "require");
+        lua_pushlstring(L, call->module.data(), call->module.size());
+        lua_call(L, 1, 1);
+        lua_getfield(L, -1, call->function.c_str());
+        lua_remove(L, -2); // Pop module
+    }
+
+    luaL_checkstack(L, call->nargs, "too many arguments");
+
+    const char* p = call->args.data();
+    for (int i = 0; i < call->nargs; ++i)
+        decode(L, p);
+
+    lua_call(L, call->nargs, 0);
+    return 0;
+}
+
+/**
+ * Raises an error if an argument to import_all is not a path or a list of
+ * paths.
+ */
+void checkArgs(lua_State* L) {
+    const int argc = lua_gettop(L);
+
+    for (int i = 1; i <= argc; ++i) {
+        if (lua_type(L, i) != LUA_TTABLE) {
+            lua_checkpath(L, i, NULL);
+            continue;
+        }
+
+        for (int j = 1; ; ++j) {
+            lua_rawgeti(L, i, j);
+            if (lua_isnil(L, -1)) {
+                lua_pop(L, 1);
+                break;
+            }
+
+            if (!lua_topath(L, -1, NULL))
+                luaL_error(L, "bad argument #%d to 'import_all' "
+                        "(path expected at index %d, got %s)", i, j,
+                        luaL_typename(L, -1));
+
+            lua_pop(L, 1);
+        }
+    }
+}
+
+}
+
+int lua_import_all(lua_State* L) {
+    ImplicitDeps* deps = (ImplicitDeps*)lua_touserdata(L, lua_upvalueindex(1));
+    DirCache& dirCache = lua_globals::dirCache(L);
+    ThreadPool& pool = lua_globals::threadPool(L);
+    ScriptCache& scriptCache = lua_globals::scriptCache(L);
+    PathTable& pathTable = lua_globals::pathTable(L);
+
+    if (!deps)
+        return luaL_error(L, "import_all is missing its dependency handler");
+
+    // Raising an error skips destructors. Thus, the arguments are checked
+    // before anything is allocated and later errors are raised once the jobs
+    // have been destroyed.
+    checkArgs(L);
+
+    const int argc = lua_gettop(L);
+    bool ok = true;
+
+    {
+        lua_getglobal(L, "SCRIPT_DIR");
+        std::string oldDir;
+        if (const char* dir = lua_tostring(L, -1))
+            oldDir = dir;
+        lua_pop(L, 1);
+
+        // Like import(), the script directory is relative to the current
+        // script directory, but the script itself is loaded relative to it.
+        std::vector<ImportJob> jobs;
+
+        auto add = [&] (int i) {
+            size_t len;
+            const char* s = lua_topath(L, i, &len);
+            const Path file(s, len);
+
+            ImportJob job;
+            job.file = oldDir;
+            file.join(job.file);
+
+            const Path dir = file.dirname();
+            job.scriptDir.assign(dir.path, dir.length);
+
+            jobs.push_back(std::move(job));
+        };
+
+        for (int i = 1; i <= argc; ++i) {
+            if (lua_type(L, i) == LUA_TTABLE) {
+                for (int j = 1; ; ++j) {
+                    lua_rawgeti(L, i, j);
+                    if (lua_isnil(L, -1)) {
+                        lua_pop(L, 1);
+                        break;
+                    }
+
+                    add(lua_gettop(L));
+                    lua_pop(L, 1);
+                }
+            }
+            else {
+                add(i);
+            }
+        }
+
+        {
+            TaskGroup group(pool);
+
+            for (auto& job: jobs) {
+                ImportJob* j = &job;
+                group.run([j, &dirCache, &pool, deps, &scriptCache,
+                        &pathTable] {
+                    runImport(*j, dirCache, pool, *deps, scriptCache,
+                            pathTable);
+                });
+            }
+
+            group.wait();
+        }
+
+        // Replay everything in order. The first failure in that order is
+        // reported such that errors are deterministic too. The error message
+        // is left on the stack.
+        for (auto& job: jobs) {
+            if (job.failed) {
+                lua_pushlstring(L, job.error.data(), job.error.size());
+                ok = false;
+                break;
+            }
+
+            for (auto& call: job.calls) {
+                lua_pushcfunction(L, replay);
+                lua_pushlightuserdata(L, &call);
+                if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+                    ok = false;
+                    break;
+                }
+            }
+
+            if (!ok)
+                break;
+        }
+
+        lua_pushlstring(L, oldDir.data(), oldDir.size());
+        lua_setglobal(L, "SCRIPT_DIR");
+    }
+
+    if (!ok)
+        return lua_error(L);
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Parallel importing of build scripts.
+ */
+#pragma once
+
+struct lua_State;
+
+/**
+ * Imports a number of independent build scripts in parallel. Each script is
+ * evaluated in its own Lua state on the thread pool. Calls to the functions of
+ * rule modules (e.g., cc.binary) are recorded and then made again in this Lua
+ * state, in the same order as if the scripts were imported one at a time with
+ * import(). Thus, the output is deterministic.
+ *
+ * Because the scripts run in separate states, they must be independent:
+ *  - Global variables set by one script are not visible to others.
+ *  - Targets can only be added through functions of "rules.*" modules.
+ *  - The arguments to such functions must be plain data (strings, numbers,
+ *    booleans, and tables of them). Lazy glob results are converted to tables.
+ *
+ * Arguments:
+ *  - files: Paths to build scripts, relative to the current script directory.
+ *    Can be given as strings or tables of strings.
+ *
+ * The first upvalue must be the ImplicitDeps object.
+ */
+int lua_import_all(lua_State* L);
@@ -0,0 +1,455 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * JSON decoding.
+ */
+#include "lua.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <new>
+#include <string>
+
+#include "lua_json.h"
+#include "lua_globals.h"
+#include "lua_path.h"
+#include "json.h"
+#include "mappedfile.h"
+
+namespace {
+
+const char* lazyType = "buttonlua.JsonLazy";
+
+/**
+ * A document that is decoded lazily. It is shared by all of its lazy values.
+ */
+struct LazyDocument {
+    // The input is either a copy of a string or a mapped file.
+    std::string source;
+    MappedFile file;
+
+    json::Document doc;
+};
+
+typedef std::shared_ptr<LazyDocument> LazyDocumentPtr;
+
+/**
+ * A lazy object or array. The members are decoded into a table the first time
+ * they are needed and kept as the user value.
+ */
+struct LazyValue {
+    LazyDocumentPtr document;
+    uint32_t index;
+};
+
+LazyValue* checkLazy(lua_State* L, int i) {
+    return (LazyValue*)luaL_checkudata(L, i, lazyType);
+}
+
+/**
+ * JSON null is a light userdata that is also available as json.null.
+ */
+void pushNull(lua_State* L) {
+    lua_pushlightuserdata(L, NULL);
+}
+
+void pushNumber(lua_State* L, json::Slice s) {
+    const char* p = s.data;
+    const char* end = s.data + s.length;
+
+    const bool negative = (*p == '-');
+    if (negative)
+        ++p;
+
+    // Integers are by far the most common, so they are converted here as long
+    // as they fit in 64 bits.
+    const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : INT64_MAX;
+
+    uint64_t value = 0;
+    bool overflow = false;
+
+    const char* q = p;
+    for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+        const unsigned d = (unsigned)(*q - '0');
+        if (value > (limit - d) / 10) {
+            overflow = true;
+            break;
+        }
+
+        value = value * 10 + d;
+    }
+
+    if (q == end && !overflow) {
+        const int64_t n = negative ? (int64_t)(0 - value) : (int64_t)value;
+#if LUA_VERSION_NUM >= 503
+        lua_pushinteger(L, (lua_Integer)n);
+#else
+        lua_pushnumber(L, (lua_Number)n);
+#endif
+        return;
+    }
+
+    // Anything else is converted like a Lua numeral since, unlike strtod, that
+    // doesn't depend on the locale, which scripts can change. An exponent
+    // makes sure that integers too big for 64 bits become floats.
+    const bool exponent = memchr(s.data, 'e', s.length) ||
+        memchr(s.data, 'E', s.length);
+
+    char small[64];
+    std::string large;
+    char* buf = small;
+
+    if (s.length + 3 > sizeof(small)) {
+        large.resize(s.length + 3);
+        buf = &large[0];
+    }
+
+    memcpy(buf, s.data, s.length);
+    strcpy(buf + s.length, exponent ? "" : "e0");
+
+#if LUA_VERSION_NUM >= 503
+    if (lua_stringtonumber(L, buf) == 0)
+        lua_pushnumber(L, 0);
+#else
+    lua_pushstring(L, buf);
+    const lua_Number n = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    lua_pushnumber(L, n);
+#endif
+}
+
+uint32_t pushValue(lua_State* L, const json::Document& doc, uint32_t i,
+        std::string& buf, const LazyDocumentPtr* lazy);
+
+/**
+ * Pushes a table of the members of the object or array at token i. If lazy is
+ * given, objects and arrays in it are pushed as lazy values.
+ */
+void pushContainer(lua_State* L, const json::Document& doc, uint32_t i,
+        std::string& buf, const LazyDocumentPtr* lazy) {
+
+    const json::Token& t = doc[i];
+
+    luaL_checkstack(L, 3, "JSON document is too deeply nested");
+
+    uint32_t j = i + 1;
+
+    if (doc.type(i) == json::Type::object) {
+        lua_createtable(L, 0, (int)t.count);
+
+        for (uint32_t n = 0; n < t.count; ++n) {
+            const json::Slice key = doc.string(j, buf);
+            lua_pushlstring(L, key.data, key.length);
+
+            j = pushValue(L, doc, j + 1, buf, lazy);
+            lua_rawset(L, -3);
+        }
+    }
+    else {
+        lua_createtable(L, (int)t.count, 0);
+
+        for (uint32_t n = 0; n < t.count; ++n) {
+            j = pushValue(L, doc, j, buf, lazy);
+            lua_rawseti(L, -2, (lua_Integer)n + 1);
+        }
+    }
+}
+
+/**
+ * Pushes the value at token i. Returns the index of the token after it.
+ */
+uint32_t pushValue(lua_State* L, const json::Document& doc, uint32_t i,
+        std::string& buf, const LazyDocumentPtr* lazy) {
+
+    switch (doc.type(i)) {
+        case json::Type::object:
+        case json::Type::array:
+            if (lazy) {
+                void* p = lua_newuserdata(L, sizeof(LazyValue));
+                new (p) LazyValue {*lazy, i};
+                luaL_setmetatable(L, lazyType);
+            }
+            else {
+                pushContainer(L, doc, i, buf, NULL);
+            }
+
+            return doc[i].next;
+
+        case json::Type::string: {
+            const json::Slice s = doc.string(i, buf);
+            lua_pushlstring(L, s.data, s.length);
+            break;
+        }
+
+        case json::Type::number:
+            pushNumber(L, doc.number(i));
+            break;
+
+        case json::Type::boolean:
+            lua_pushboolean(L, doc.boolean(i));
+            break;
+
+        case json::Type::null:
+            pushNull(L);
+            break;
+    }
+
+    return i + 1;
+}
+
+/**
+ * Pushes the table of members of the lazy value at the given index, decoding
+ * them if they haven't been yet.
+ */
+void pushMembers(lua_State* L, int idx) {
+    LazyValue* v = checkLazy(L, idx);
+
+    lua_getuservalue(L, idx);
+    if (lua_type(L, -1) == LUA_TTABLE)
+        return;
+
+    lua_pop(L, 1);
+
+    std::string buf;
+    pushContainer(L, v->document->doc, v->index, buf, &v->document);
+
+    lua_pushvalue(L, -1);
+    lua_setuservalue(L, idx);
+}
+
+int lazy_gc(lua_State* L) {
+    checkLazy(L, 1)->~LazyValue();
+    return 0;
+}
+
+int lazy_index(lua_State* L) {
+    pushMembers(L, 1);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    return 1;
+}
+
+int lazy_newindex(lua_State* L) {
+    return luaL_error(L, "cannot modify a lazy JSON value");
+}
+
+int lazy_len(lua_State* L) {
+    const LazyValue* v = checkLazy(L, 1);
+    const json::Document& doc = v->document->doc;
+
+    if (doc.type(v->index) == json::Type::array)
+        lua_pushinteger(L, (lua_Integer)doc[v->index].count);
+    else
+        lua_pushinteger(L, 0);
+
+    return 1;
+}
+
+int lazy_next(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 2);
+
+    if (lua_next(L, 1))
+        return 2;
+
+    lua_pushnil(L);
+    return 1;
+}
+
+int lazy_pairs(lua_State* L) {
+    lua_pushcfunction(L, lazy_next);
+    pushMembers(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+int lazy_inext(lua_State* L) {
+    const lua_Integer i = luaL_checkinteger(L, 2) + 1;
+
+    lua_pushinteger(L, i);
+    lua_rawgeti(L, 1, i);
+
+    return lua_isnil(L, -1) ? 1 : 2;
+}
+
+/**
+ * Only needed for Lua 5.2. Later versions of ipairs respect __index.
+ */
+int lazy_ipairs(lua_State* L) {
+    lua_pushcfunction(L, lazy_inext);
+    pushMembers(L, 1);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+
+/**
+ * Creates the metatable for lazy values.
+ */
+void registerLazy(lua_State* L) {
+    if (!luaL_newmetatable(L, lazyType)) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    lua_pushcfunction(L, lazy_gc);
+    lua_setfield(L, -2, "__gc");
+
+    lua_pushcfunction(L, lazy_index);
+    lua_setfield(L, -2, "__index");
+
+    lua_pushcfunction(L, lazy_newindex);
+    lua_setfield(L, -2, "__newindex");
+
+    lua_pushcfunction(L, lazy_len);
+    lua_setfield(L, -2, "__len");
+
+    lua_pushcfunction(L, lazy_pairs);
+    lua_setfield(L, -2, "__pairs");
+
+    lua_pushcfunction(L, lazy_ipairs);
+    lua_setfield(L, -2, "__ipairs");
+
+    lua_pop(L, 1); // Pop metatable
+}
+
+/**
+ * Returns true if the options at the given index ask for lazy decoding.
+ */
+bool isLazy(lua_State* L, int i) {
+    if (lua_isnoneornil(L, i))
+        return false;
+
+    luaL_checktype(L, i, LUA_TTABLE);
+
+    lua_getfield(L, i, "lazy");
+    const bool lazy = lua_toboolean(L, -1) != 0;
+    lua_pop(L, 1);
+
+    return lazy;
+}
+
+/**
+ * Decodes the input and pushes the result. If it is not valid JSON, pushes an
+ * error message instead and returns false. The error is left for the caller to
+ * raise such that no destructors are skipped.
+ */
+bool decode(lua_State* L, const char* data, size_t length, const char* name) {
+    json::Document doc;
+
+    if (!doc.parse(data, length)) {
+        lua_pushfstring(L, "%s: %s", name, doc.error().c_str());
+        return false;
+    }
+
+    std::string buf;
+    pushValue(L, doc, 0, buf, NULL);
+    return true;
+}
+
+/**
+ * Like decode, but objects and arrays are lazy. The input must already be in
+ * the document.
+ */
+bool decodeLazy(lua_State* L, const LazyDocumentPtr& d, const char* data,
+        size_t length, const char* name) {
+
+    if (!d->doc.parse(data, length)) {
+        lua_pushfstring(L, "%s: %s", name, d->doc.error().c_str());
+        return false;
+    }
+
+    std::string buf;
+    pushValue(L, d->doc, 0, buf, &d);
+    return true;
+}
+
+int decodeString(lua_State* L) {
+    size_t len;
+    const char* s = luaL_checklstring(L, 1, &len);
+
+    if (!isLazy(L, 2))
+        return decode(L, s, len, "invalid JSON") ? 1 : -1;
+
+    LazyDocumentPtr d = std::make_shared<LazyDocument>();
+    d->source.assign(s, len);
+
+    return decodeLazy(L, d, d->source.data(), d->source.length(),
+            "invalid JSON") ? 1 : -1;
+}
+
+int loadFile(lua_State* L) {
+    size_t len;
+    const char* p = lua_checkpath(L, 1, &len);
+
+    const bool lazy = isLazy(L, 2);
+
+    std::string path;
+    Path(p, len).norm(path);
+
+    lua_globals::implicitDeps(L).addInputOnce(path.data(), path.length());
+
+    const std::string name = path + ": invalid JSON";
+
+    LazyDocumentPtr d = std::make_shared<LazyDocument>();
+
+    if (!d->file.open(path.c_str())) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cannot read '%s'", path.c_str());
+        return 2;
+    }
+
+    if (!lazy)
+        return decode(L, d->file.data(), d->file.length(), name.c_str()) ? 1 : -1;
+
+    return decodeLazy(L, d, d->file.data(), d->file.length(), name.c_str())
+        ? 1 : -1;
+}
+
+int json_decode(lua_State* L) {
+    const int n = decodeString(L);
+    return (n < 0) ? lua_error(L) : n;
+}
+
+int json_load(lua_State* L) {
+    const int n = loadFile(L);
+    return (n < 0) ? lua_error(L) : n;
+}
+
+int json_totable(lua_State* L) {
+    luaL_checkany(L, 1);
+
+    const LazyValue* v = (const LazyValue*)luaL_testudata(L, 1, lazyType);
+    if (!v) {
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    std::string buf;
+    pushValue(L, v->document->doc, v->index, buf, NULL);
+    return 1;
+}
+
+const luaL_Reg jsonlib[] = {
+    {"decode", json_decode},
+    {"load", json_load},
+    {"totable", json_totable},
+    {NULL, NULL}
+};
+
+}
+
+int luaopen_json(lua_State* L) {
+    registerLazy(L);
+
+    luaL_newlib(L, jsonlib);
+
+    pushNull(L);
+    lua_setfield(L, -2, "null");
+
+    return 1;
+}
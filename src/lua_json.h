@@ -0,0 +1,34 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * JSON decoding.
+ */
+#pragma once
+
+struct lua_State;
+
+/**
+ * Pushes the json library onto the stack so that it can be registered. It has
+ * the functions:
+ *
+ *  - decode(s, opts): Decodes the JSON string. Raises an error if it is not
+ *    valid JSON.
+ *  - load(path, opts): Decodes the JSON file. The file is reported as an
+ *    input. If it could not be read, returns nil and an error message.
+ *  - totable(v): Fully decodes a lazy object or array into tables. Other
+ *    values are returned as they are.
+ *
+ * and the value `null`, which JSON nulls are decoded as such that they don't
+ * disappear from arrays and objects.
+ *
+ * Objects and arrays are decoded as tables. With the option `lazy = true`,
+ * they are decoded as read-only userdata instead. The members of a lazy object
+ * or array are only decoded when it is first indexed or iterated, and any
+ * objects or arrays in it are lazy too. Thus, scripts that only look at part
+ * of a large document don't pay for decoding the rest. Lazy values support
+ * indexing, `#` (for arrays), `pairs`, and `ipairs`.
+ */
+int luaopen_json(lua_State* L);
@@ -8,14 +8,184 @@
  */
 #include "lua_path.h"
 
+#include <string.h>
+#include <string>
+
 #include "path.h"
+#include "pathtable.h"
+#include "lua_globals.h"
 
 #include "lua.hpp"
 
+namespace {
+
+const char* pathHandleType = "buttonlua.PathHandle";
+
+// Registry keys for the cache of handles and the cache of their strings.
+const char* pathHandlesKey = "buttonlua.PathHandles";
+const char* pathStringsKey = "buttonlua.PathStrings";
+
+struct PathHandle {
+    PathTable* table;
+    PathId id;
+};
+
+/**
+ * Gets a table from the registry, creating it with the given weak mode if it
+ * doesn't exist.
+ */
+void getWeakTable(lua_State* L, const char* key, const char* mode) {
+    if (!luaL_getsubtable(L, LUA_REGISTRYINDEX, key)) {
+        lua_createtable(L, 0, 1);
+        lua_pushstring(L, mode);
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+    }
+}
+
+PathHandle* checkPathHandle(lua_State* L, int i) {
+    return (PathHandle*)luaL_checkudata(L, i, pathHandleType);
+}
+
+/**
+ * Gets the path table and the ID of the path argument, which can either be a
+ * string or a handle. Strings are interned.
+ */
+PathId checkPathId(lua_State* L, int arg, PathTable*& table) {
+    PathId id;
+    if (lua_topathid(L, arg, &table, &id))
+        return id;
+
+    size_t len;
+    const char* s = luaL_checklstring(L, arg, &len);
+
+    table = &lua_globals::pathTable(L);
+    return table->intern(Path(s, len));
+}
+
+int pathhandle_str(lua_State* L) {
+    checkPathHandle(L, 1);
+
+    size_t len;
+    const char* s = lua_topath(L, 1, &len);
+    lua_pushlstring(L, s, len);
+    return 1;
+}
+
+int pathhandle_concat(lua_State* L) {
+    size_t len;
+
+    for (int i = 1; i <= 2; ++i) {
+        if (!lua_topath(L, i, &len)) {
+            return luaL_error(L, "attempt to concatenate a %s value",
+                    luaL_typename(L, i));
+        }
+    }
+
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+
+    for (int i = 1; i <= 2; ++i) {
+        const char* s = lua_topath(L, i, &len);
+        luaL_addlstring(&b, s, len);
+    }
+
+    luaL_pushresult(&b);
+    return 1;
+}
+
+int pathhandle_id(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)checkPathHandle(L, 1)->id);
+    return 1;
+}
+
+int pathhandle_parent(lua_State* L) {
+    PathHandle* h = checkPathHandle(L, 1);
+    lua_pushpath(L, *h->table, h->table->parent(h->id));
+    return 1;
+}
+
+int pathhandle_basename(lua_State* L) {
+    PathHandle* h = checkPathHandle(L, 1);
+    const std::string name = h->table->basename(h->id);
+    lua_pushlstring(L, name.data(), name.length());
+    return 1;
+}
+
+/**
+ * Joins any number of paths to the handle. Like path.join followed by
+ * path.norm, but returns a handle.
+ */
+int pathhandle_join(lua_State* L) {
+    PathHandle* h = checkPathHandle(L, 1);
+
+    PathId id = h->id;
+
+    const int argc = lua_gettop(L);
+    for (int i = 2; i <= argc; ++i) {
+        size_t len;
+        const char* s = lua_checkpath(L, i, &len);
+        id = h->table->intern(id, Path(s, len));
+    }
+
+    lua_pushpath(L, *h->table, id);
+    return 1;
+}
+
+const luaL_Reg pathhandle_methods[] = {
+    {"str", pathhandle_str},
+    {"id", pathhandle_id},
+    {"parent", pathhandle_parent},
+    {"basename", pathhandle_basename},
+    {"join", pathhandle_join},
+    {NULL, NULL}
+};
+
+/**
+ * Creates the metatable for path handles.
+ */
+void registerPathHandle(lua_State* L) {
+    if (!luaL_newmetatable(L, pathHandleType)) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    lua_pushcfunction(L, pathhandle_str);
+    lua_setfield(L, -2, "__tostring");
+
+    lua_pushcfunction(L, pathhandle_concat);
+    lua_setfield(L, -2, "__concat");
+
+    luaL_newlib(L, pathhandle_methods);
+    lua_setfield(L, -2, "__index");
+
+    lua_pop(L, 1); // Pop metatable
+}
+
+/**
+ * Returns a handle to the normalized path. The optional second argument is a
+ * base path to join it to first. Both can be strings or handles.
+ */
+int path_intern(lua_State* L) {
+    PathTable* table = &lua_globals::pathTable(L);
+
+    PathId base = PathTable::dot;
+    if (!lua_isnoneornil(L, 2))
+        base = checkPathId(L, 2, table);
+
+    size_t len;
+    const char* s = lua_checkpath(L, 1, &len);
+
+    lua_pushpath(L, *table, table->intern(base, Path(s, len)));
+    return 1;
+}
+
+}
+
 template<class Path>
 static int path_splitroot(lua_State* L) {
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     const Split<Path> s = Path(path, len).splitRoot();
     lua_pushlstring(L, s.head.path, s.head.length);
@@ -26,7 +196,7 @@ static int path_splitroot(lua_State* L) {
 template<class Path>
 static int path_isabs(lua_State* L) {
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
     lua_pushboolean(L, Path(path, len).isabs());
     return 1;
 }
@@ -44,7 +214,7 @@ static int path_join(lua_State* L) {
             continue;
 
         size_t len;
-        const char* path = luaL_checklstring(L, i, &len);
+        const char* path = lua_checkpath(L, i, &len);
 
         if (Path(path, len).isabs()) {
             // Path is absolute, reset the buffer length
@@ -67,7 +237,7 @@ template<class Path>
 static int path_split(lua_State* L) {
 
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     Split<Path> s = Path(path, len).split();
 
@@ -80,7 +250,7 @@ static int path_split(lua_State* L) {
 template<class Path>
 static int path_basename(lua_State* L) {
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     Split<Path> s = Path(path, len).split();
     lua_pushlstring(L, s.tail.path, s.tail.length);
@@ -90,7 +260,7 @@ static int path_basename(lua_State* L) {
 template<class Path>
 static int path_dirname(lua_State* L) {
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     Split<Path> s = Path(path, len).split();
     lua_pushlstring(L, s.head.path, s.head.length);
@@ -101,7 +271,7 @@ template<class Path>
 static int path_splitext(lua_State* L) {
 
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     Split<Path> s = Path(path, len).splitExtension();
 
@@ -114,7 +284,7 @@ static int path_splitext(lua_State* L) {
 template<class Path>
 static int path_getext(lua_State* L) {
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     Split<Path> s = Path(path, len).splitExtension();
 
@@ -125,8 +295,8 @@ static int path_getext(lua_State* L) {
 template<class Path>
 static int path_setext(lua_State* L) {
     size_t pathlen, extlen;
-    const char* path = luaL_checklstring(L, 1, &pathlen);
-    const char* ext = luaL_checklstring(L, 2, &extlen);
+    const char* path = lua_checkpath(L, 1, &pathlen);
+    const char* ext = lua_checkpath(L, 2, &extlen);
 
     Split<Path> s = Path(path, pathlen).splitExtension();
 
@@ -141,7 +311,7 @@ template<class Path>
 static int path_components(lua_State* L) {
 
     size_t len;
-    if (const char* str = luaL_checklstring(L, 1, &len))
+    if (const char* str = lua_checkpath(L, 1, &len))
         return Path(str, len).components(L);
 
     return 0;
@@ -151,7 +321,7 @@ template<class Path>
 static int path_norm(lua_State* L) {
 
     size_t len;
-    const char* path = luaL_checklstring(L, 1, &len);
+    const char* path = lua_checkpath(L, 1, &len);
 
     auto buf = Path(path, len).norm();
 
@@ -163,12 +333,235 @@ static int path_norm(lua_State* L) {
 template<class Path>
 int path_matches(lua_State* L) {
     size_t len, patlen;
-    const char* path = luaL_checklstring(L, 1, &len);
-    const char* pattern = luaL_checklstring(L, 2, &patlen);
+    const char* path = lua_checkpath(L, 1, &len);
+    const char* pattern = lua_checkpath(L, 2, &patlen);
     lua_pushboolean(L, Path(path, len).matches(Path(pattern, patlen)));
     return 1;
 }
 
+/**
+ * Checks that the argument is a list of paths and returns its length. Path
+ * handles and numbers are accepted too, like lua_checkpath does.
+ */
+static int check_path_list(lua_State* L, int arg) {
+    luaL_checktype(L, arg, LUA_TTABLE);
+
+    const int n = (int)lua_rawlen(L, arg);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, arg, i);
+
+        if (!lua_topath(L, -1, NULL)) {
+            return luaL_argerror(L, arg, lua_pushfstring(L,
+                        "string expected at index %d, got %s", i,
+                        luaL_typename(L, -1)));
+        }
+
+        lua_pop(L, 1);
+    }
+
+    return n;
+}
+
+/**
+ * Normalizes every path in a list, optionally joining each one to a base path
+ * first. That is, path.norm_all(list, base) is the same as calling
+ * path.norm(path.join(base, p)) for every path in the list, but without calling
+ * into C for each path. Returns a new list.
+ */
+template<class Path>
+static int path_norm_all(lua_State* L) {
+    const int n = check_path_list(L, 1);
+
+    size_t baselen = 0;
+    const char* base = lua_isnoneornil(L, 2) ? "" : lua_checkpath(L, 2, &baselen);
+
+    // Scratch buffers reused for every path.
+    std::string joined, normed;
+
+    lua_createtable(L, n, 0);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 1, i);
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+
+        joined.assign(base, baselen);
+        Path(path, len).join(joined);
+
+        normed.clear();
+        Path(joined).norm(normed);
+
+        lua_pop(L, 1);
+
+        lua_pushlstring(L, normed.data(), normed.length());
+        lua_rawseti(L, -2, i);
+    }
+
+    return 1;
+}
+
+/**
+ * Joins every path in a list to a base path. That is, path.join_all(list, base)
+ * is the same as calling path.join(base, p) for every path in the list. Returns
+ * a new list.
+ */
+template<class Path>
+static int path_join_all(lua_State* L) {
+    const int n = check_path_list(L, 1);
+
+    size_t baselen;
+    const char* base = lua_checkpath(L, 2, &baselen);
+
+    std::string joined;
+
+    lua_createtable(L, n, 0);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 1, i);
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+
+        joined.assign(base, baselen);
+        Path(path, len).join(joined);
+
+        lua_pop(L, 1);
+
+        lua_pushlstring(L, joined.data(), joined.length());
+        lua_rawseti(L, -2, i);
+    }
+
+    return 1;
+}
+
+/**
+ * Changes the extension of every path in a list. That is,
+ * path.setext_all(list, ext) is the same as calling path.setext(p, ext) for
+ * every path in the list. Returns a new list.
+ */
+template<class Path>
+static int path_setext_all(lua_State* L) {
+    const int n = check_path_list(L, 1);
+
+    size_t extlen;
+    const char* ext = lua_checkpath(L, 2, &extlen);
+
+    std::string buf;
+
+    lua_createtable(L, n, 0);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 1, i);
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+
+        Split<Path> s = Path(path, len).splitExtension();
+
+        buf.assign(s.head.path, s.head.length);
+        buf.append(ext, extlen);
+
+        lua_pop(L, 1);
+
+        lua_pushlstring(L, buf.data(), buf.length());
+        lua_rawseti(L, -2, i);
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the paths in a list that have one of the given extensions. The
+ * extensions can either be a list (e.g., {".c", ".h"}) or a set (e.g., the
+ * result of table.set). Extensions are compared exactly.
+ */
+template<class Path>
+static int path_filter_ext(lua_State* L) {
+    const int n = check_path_list(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    const int extCount = (int)lua_rawlen(L, 2);
+
+    lua_createtable(L, n, 0);
+
+    int count = 0;
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 1, i);
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+
+        const Path ext = Path(path, len).splitExtension().tail;
+
+        bool match = false;
+
+        if (extCount > 0) {
+            for (int j = 1; j <= extCount && !match; ++j) {
+                lua_rawgeti(L, 2, j);
+
+                size_t l;
+                const char* e = lua_tolstring(L, -1, &l);
+                match = e && l == ext.length &&
+                    memcmp(e, ext.path, l) == 0;
+
+                lua_pop(L, 1);
+            }
+        }
+        else {
+            lua_pushlstring(L, ext.path, ext.length);
+            lua_rawget(L, 2);
+            match = lua_toboolean(L, -1) != 0;
+            lua_pop(L, 1);
+        }
+
+        if (match)
+            lua_rawseti(L, -2, ++count);
+        else
+            lua_pop(L, 1);
+    }
+
+    return 1;
+}
+
+/**
+ * Like path.intern, but for a list of paths. Returns a new list of handles.
+ */
+static int path_intern_all(lua_State* L) {
+    const int n = check_path_list(L, 1);
+
+    PathTable* table = &lua_globals::pathTable(L);
+
+    PathId base = PathTable::dot;
+    if (!lua_isnoneornil(L, 2))
+        base = checkPathId(L, 2, table);
+
+    lua_createtable(L, n, 0);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 1, i);
+
+        size_t len;
+        const char* path = lua_topath(L, -1, &len);
+        const PathId id = table->intern(base, Path(path, len));
+
+        lua_pop(L, 1);
+
+        lua_pushpath(L, *table, id);
+        lua_rawseti(L, -2, i);
+    }
+
+    return 1;
+}
+
+static const luaL_Reg pathlib_intern[] = {
+    {"intern", path_intern},
+    {"intern_all", path_intern_all},
+    {NULL, NULL}
+};
+
 static const luaL_Reg pathlib_posix[] = {
     {"splitroot", path_splitroot<PosixPath>},
     {"isabs", path_isabs<PosixPath>},
@@ -182,6 +575,10 @@ static const luaL_Reg pathlib_posix[] = {
     {"components", path_components<PosixPath>},
     {"norm", path_norm<PosixPath>},
     {"matches", path_matches<PosixPath>},
+    {"norm_all", path_norm_all<PosixPath>},
+    {"join_all", path_join_all<PosixPath>},
+    {"setext_all", path_setext_all<PosixPath>},
+    {"filter_ext", path_filter_ext<PosixPath>},
     {NULL, NULL}
 };
 
@@ -198,6 +595,10 @@ static const luaL_Reg pathlib_win[] = {
     {"components", path_components<WinPath>},
     {"norm", path_norm<WinPath>},
     {"matches", path_matches<WinPath>},
+    {"norm_all", path_norm_all<WinPath>},
+    {"join_all", path_join_all<WinPath>},
+    {"setext_all", path_setext_all<WinPath>},
+    {"filter_ext", path_filter_ext<WinPath>},
     {NULL, NULL}
 };
 
@@ -207,6 +608,9 @@ int luaopen_path(lua_State* L) {
 #else
     luaL_newlib(L, pathlib_posix);
 #endif
+
+    // Interning is only done with the platform's paths.
+    luaL_setfuncs(L, pathlib_intern, 0);
     return 1;
 }
 
@@ -219,3 +623,79 @@ int luaopen_winpath(lua_State* L) {
     luaL_newlib(L, pathlib_win);
     return 1;
 }
+
+void lua_pushpath(lua_State* L, PathTable& table, PathId id) {
+    luaL_checkstack(L, 3, NULL);
+
+    // Handles are cached such that there is only one per path.
+    getWeakTable(L, pathHandlesKey, "v");
+
+    lua_rawgeti(L, -1, (lua_Integer)id);
+    if (!lua_isnil(L, -1)) {
+        lua_remove(L, -2);
+        return;
+    }
+
+    lua_pop(L, 1);
+
+    PathHandle* h = (PathHandle*)lua_newuserdata(L, sizeof(PathHandle));
+    h->table = &table;
+    h->id = id;
+
+    registerPathHandle(L);
+    luaL_setmetatable(L, pathHandleType);
+
+    lua_pushvalue(L, -1);
+    lua_rawseti(L, -3, (lua_Integer)id);
+
+    lua_remove(L, -2); // Pop the cache
+}
+
+bool lua_topathid(lua_State* L, int idx, PathTable** table, PathId* id) {
+    PathHandle* h = (PathHandle*)luaL_testudata(L, idx, pathHandleType);
+    if (!h)
+        return false;
+
+    *table = h->table;
+    *id = h->id;
+    return true;
+}
+
+const char* lua_topath(lua_State* L, int idx, size_t* len) {
+    PathHandle* h = (PathHandle*)luaL_testudata(L, idx, pathHandleType);
+    if (!h)
+        return lua_tolstring(L, idx, len);
+
+    idx = lua_absindex(L, idx);
+
+    // The string is only created once and then kept for as long as the handle
+    // is alive.
+    getWeakTable(L, pathStringsKey, "k");
+
+    lua_pushvalue(L, idx);
+    lua_rawget(L, -2);
+
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+
+        static thread_local std::string buf;
+        h->table->str(h->id, buf);
+
+        lua_pushlstring(L, buf.data(), buf.length());
+        lua_pushvalue(L, idx);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -4);
+    }
+
+    // The string stays referenced by the cache.
+    const char* s = lua_tolstring(L, -1, len);
+    lua_pop(L, 2);
+    return s;
+}
+
+const char* lua_checkpath(lua_State* L, int arg, size_t* len) {
+    if (const char* s = lua_topath(L, arg, len))
+        return s;
+
+    return luaL_checklstring(L, arg, len);
+}
@@ -8,6 +8,10 @@
  */
 #pragma once
 
+#include <stddef.h>
+
+#include "pathtable.h"
+
 struct lua_State;
 
 /**
@@ -16,3 +20,27 @@ struct lua_State;
 int luaopen_path(lua_State* L);
 int luaopen_posixpath(lua_State* L);
 int luaopen_winpath(lua_State* L);
+
+/**
+ * Pushes a handle to a path in the path table. Handles for the same path are
+ * the same userdata, so they can be compared with == and used as table keys.
+ */
+void lua_pushpath(lua_State* L, PathTable& table, PathId id);
+
+/**
+ * Returns true if the value at the given index is a path handle and gets its
+ * table and ID.
+ */
+bool lua_topathid(lua_State* L, int idx, PathTable** table, PathId* id);
+
+/**
+ * Like lua_tolstring, but path handles are converted to strings as well. The
+ * string of a handle stays valid for as long as the handle does. Returns NULL
+ * if the value is neither a string, number, nor path handle.
+ */
+const char* lua_topath(lua_State* L, int idx, size_t* len);
+
+/**
+ * Like luaL_checklstring, but path handles are accepted as well.
+ */
+const char* lua_checkpath(lua_State* L, int arg, size_t* len);
@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Additions to the standard table library. These are used heavily by the rule
+ * generators (often once or more for every source file) and so are implemented
+ * in C.
+ */
+#include "lua.hpp"
+
+#include "lua_table.h"
+#include "lua_argv.h"
+
+namespace {
+
+/**
+ * Returns true if elements can be read from the list at the given index with
+ * lua_rawgeti.
+ */
+bool isRawList(lua_State* L, int i) {
+    if (lua_type(L, i) != LUA_TTABLE)
+        return false;
+
+    if (lua_getmetatable(L, i)) {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Pushes element n of the list at the given index. Like ipairs(), this respects
+ * the __index metamethod such that lazy glob results work too.
+ */
+void getElement(lua_State* L, int i, bool raw, lua_Integer n) {
+    if (raw) {
+        lua_rawgeti(L, i, n);
+    }
+    else {
+        lua_pushinteger(L, n);
+        lua_gettable(L, i);
+    }
+}
+
+/**
+ * Returns the number of elements in the list at the given index, stopping at
+ * the first nil like ipairs() does. Only used to pre-size tables.
+ */
+lua_Integer listLength(lua_State* L, int i) {
+    lua_Integer n = (lua_Integer)lua_rawlen(L, i);
+
+    // The border found by the length operator isn't necessarily the first nil.
+    lua_rawgeti(L, i, n + 1);
+    const bool exact = lua_isnil(L, -1);
+    lua_pop(L, 1);
+
+    return exact ? n : 0;
+}
+
+/**
+ * Appends the arguments starting at the given index to the table at index 1,
+ * starting at position n+1. Table and argv list arguments have their elements
+ * appended instead. Like ipairs(), this stops at the first nil argument.
+ */
+void append(lua_State* L, int first, lua_Integer n) {
+    const int argc = lua_gettop(L);
+
+    for (int i = first; i <= argc; ++i) {
+        const int type = lua_type(L, i);
+
+        if (type == LUA_TNIL)
+            break;
+
+        if (lua_isargv(L, i)) {
+            lua_argveach(L, i, [&](lua_State* L) {
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, 1, ++n);
+            });
+            continue;
+        }
+
+        if (type != LUA_TTABLE) {
+            lua_pushvalue(L, i);
+            lua_rawseti(L, 1, ++n);
+            continue;
+        }
+
+        const bool raw = isRawList(L, i);
+
+        for (lua_Integer j = 1; ; ++j) {
+            getElement(L, i, raw, j);
+            if (lua_isnil(L, -1)) {
+                lua_pop(L, 1);
+                break;
+            }
+
+            lua_rawseti(L, 1, ++n);
+        }
+    }
+}
+
+/**
+ * Returns the number of elements append() will add, as far as it can be known
+ * cheaply.
+ */
+lua_Integer appendCount(lua_State* L, int first) {
+    const int argc = lua_gettop(L);
+
+    lua_Integer count = 0;
+
+    for (int i = first; i <= argc; ++i) {
+        const int type = lua_type(L, i);
+
+        if (type == LUA_TNIL)
+            break;
+        else if (type == LUA_TTABLE)
+            count += listLength(L, i);
+        else if (lua_isargv(L, i))
+            count += luaL_len(L, i);
+        else
+            ++count;
+    }
+
+    return count;
+}
+
+/**
+ * Appends the given values to the table. Table and argv list arguments have
+ * their elements appended instead.
+ *
+ * Returns the table.
+ */
+int table_append(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    // Elements are always appended at the end, even if the table has
+    // metamethods.
+    append(L, 2, (lua_Integer)lua_rawlen(L, 1));
+
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * Returns a new table with the given values. Table and argv list arguments have
+ * their elements added instead.
+ */
+int table_join(lua_State* L) {
+    const lua_Integer count = appendCount(L, 1);
+
+    lua_createtable(L, (int)count, 0);
+    lua_insert(L, 1);
+
+    append(L, 2, 0);
+
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * Checks if the given list contains the given value. Returns true if the value
+ * is in the list, false otherwise.
+ *
+ * For checking many values against the same list, use table.set() instead.
+ */
+int table_contains(lua_State* L) {
+    const bool raw = isRawList(L, 1);
+
+    for (lua_Integer i = 1; ; ++i) {
+        getElement(L, 1, raw, i);
+
+        if (lua_isnil(L, -1))
+            break;
+
+        if (lua_compare(L, -1, 2, LUA_OPEQ)) {
+            lua_pushboolean(L, 1);
+            return 1;
+        }
+
+        lua_pop(L, 1);
+    }
+
+    lua_pushboolean(L, 0);
+    return 1;
+}
+
+/**
+ * Returns a set of the values in the given list. That is, a table where each
+ * value is a key that maps to true. Checking if a value is in the set is then
+ * just an index operation.
+ */
+int table_set(lua_State* L) {
+    const bool raw = isRawList(L, 1);
+
+    lua_createtable(L, 0, raw ? (int)listLength(L, 1) : 0);
+
+    for (lua_Integer i = 1; ; ++i) {
+        getElement(L, 1, raw, i);
+
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        lua_pushboolean(L, 1);
+        lua_rawset(L, -3);
+    }
+
+    return 1;
+}
+
+/**
+ * Returns a new table with only the items that the predicate returns true for.
+ */
+int table_filter(lua_State* L) {
+    luaL_checkany(L, 2);
+
+    const bool raw = isRawList(L, 1);
+
+    lua_newtable(L);
+    const int filtered = lua_gettop(L);
+
+    lua_Integer n = 0;
+
+    for (lua_Integer i = 1; ; ++i) {
+        getElement(L, 1, raw, i);
+
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_call(L, 1, 1);
+
+        const bool keep = lua_toboolean(L, -1) != 0;
+        lua_pop(L, 1);
+
+        if (keep)
+            lua_rawseti(L, filtered, ++n);
+        else
+            lua_pop(L, 1);
+    }
+
+    return 1;
+}
+
+const luaL_Reg tablelib[] = {
+    {"append", table_append},
+    {"join", table_join},
+    {"contains", table_contains},
+    {"set", table_set},
+    {"filter", table_filter},
+    {NULL, NULL}
+};
+
+}
+
+int luaopen_tableext(lua_State* L) {
+    lua_getglobal(L, "table");
+    luaL_setfuncs(L, tablelib, 0);
+    return 1;
+}
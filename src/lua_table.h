@@ -0,0 +1,17 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Additions to the standard table library.
+ */
+#pragma once
+
+struct lua_State;
+
+/**
+ * Adds the functions to the global "table" library and pushes it onto the
+ * stack.
+ */
+int luaopen_tableext(lua_State* L);
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "luaalloc.h"
+
+namespace {
+
+size_t sizeClass(size_t size) {
+    return (size - 1) / LuaAllocator::granularity;
+}
+
+size_t classSize(size_t sizeClass) {
+    return (sizeClass + 1) * LuaAllocator::granularity;
+}
+
+}
+
+LuaAllocator::LuaAllocator(bool pooled)
+    : _bump(NULL), _bumpEnd(NULL), _bytes(0), _largeBytes(0), _pooled(pooled) {
+
+    for (size_t i = 0; i < sizeClasses; ++i)
+        _free[i] = NULL;
+
+    phase("init");
+}
+
+LuaAllocator::~LuaAllocator() {
+    for (auto chunk: _chunks)
+        free(chunk);
+}
+
+void* LuaAllocator::alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    LuaAllocator* a = (LuaAllocator*)ud;
+
+    if (nsize == 0) {
+        if (ptr)
+            a->deallocate(ptr, osize);
+        return NULL;
+    }
+
+    // If ptr is NULL, osize is the type of the object being created and not a
+    // size.
+    if (!ptr)
+        return a->allocate(nsize);
+
+    return a->reallocate(ptr, osize, nsize);
+}
+
+void LuaAllocator::phase(const char* name) {
+    Stats s;
+    s.phase = name;
+    s.allocs = 0;
+    s.frees = 0;
+    s.reallocs = 0;
+    s.bytesAllocated = 0;
+    s.peakBytes = _bytes;
+    _phases.push_back(s);
+}
+
+void LuaAllocator::grow(size_t size) {
+    Stats& s = _phases.back();
+
+    _bytes += size;
+    s.bytesAllocated += size;
+
+    if (_bytes > s.peakBytes)
+        s.peakBytes = _bytes;
+}
+
+void LuaAllocator::shrink(size_t size) {
+    _bytes -= size;
+}
+
+void* LuaAllocator::allocatePooled(size_t c) {
+    if (FreeBlock* b = _free[c]) {
+        _free[c] = b->next;
+        return b;
+    }
+
+    const size_t size = classSize(c);
+
+    if ((size_t)(_bumpEnd - _bump) < size) {
+        // The rest of the current chunk is wasted. It is less than the largest
+        // size class.
+        char* chunk = (char*)malloc(chunkSize);
+        if (!chunk)
+            return NULL;
+
+        _chunks.push_back(chunk);
+        _bump = chunk;
+        _bumpEnd = chunk + chunkSize;
+    }
+
+    void* p = _bump;
+    _bump += size;
+    return p;
+}
+
+void* LuaAllocator::rawAllocate(size_t size) {
+    if (isPooled(size))
+        return allocatePooled(sizeClass(size));
+
+    void* p = malloc(size);
+    if (p)
+        _largeBytes += size;
+    return p;
+}
+
+void LuaAllocator::rawFree(void* ptr, size_t size) {
+    if (isPooled(size)) {
+        FreeBlock* b = (FreeBlock*)ptr;
+        const size_t c = sizeClass(size);
+        b->next = _free[c];
+        _free[c] = b;
+    }
+    else {
+        free(ptr);
+        _largeBytes -= size;
+    }
+}
+
+void* LuaAllocator::allocate(size_t size) {
+    void* p = rawAllocate(size);
+    if (!p)
+        return NULL;
+
+    ++_phases.back().allocs;
+    grow(size);
+    return p;
+}
+
+void LuaAllocator::deallocate(void* ptr, size_t size) {
+    rawFree(ptr, size);
+
+    ++_phases.back().frees;
+    shrink(size);
+}
+
+void* LuaAllocator::reallocate(void* ptr, size_t osize, size_t nsize) {
+    const bool oldPooled = isPooled(osize);
+    const bool newPooled = isPooled(nsize);
+
+    void* p;
+
+    if (!oldPooled && !newPooled) {
+        p = realloc(ptr, nsize);
+        if (p) {
+            _largeBytes -= osize;
+            _largeBytes += nsize;
+        }
+    }
+    else if (oldPooled && newPooled && sizeClass(osize) == sizeClass(nsize)) {
+        // Still fits.
+        p = ptr;
+    }
+    else {
+        p = rawAllocate(nsize);
+        if (p) {
+            memcpy(p, ptr, osize < nsize ? osize : nsize);
+            rawFree(ptr, osize);
+        }
+    }
+
+    if (!p) {
+        if (nsize > osize)
+            return NULL;
+
+        // Lua assumes that shrinking a block never fails, so the old block is
+        // kept. It is big enough, but Lua frees it with the new size, so it
+        // must be booked under the new size's class.
+        if (!newPooled) {
+            // Both came from malloc.
+            _largeBytes -= osize - nsize;
+        }
+        else if (!oldPooled) {
+            // It will be freed into a pool, where it can be reused like any
+            // other block of that class. It is never returned to malloc, but
+            // this only happens when out of memory.
+            _largeBytes -= osize;
+        }
+
+        // Blocks moving to a smaller pool waste the difference until the
+        // allocator is destroyed.
+        shrink(osize - nsize);
+        return ptr;
+    }
+
+    ++_phases.back().reallocs;
+
+    if (nsize > osize)
+        grow(nsize - osize);
+    else
+        shrink(osize - nsize);
+
+    return p;
+}
+
+void LuaAllocator::report(FILE* f) const {
+    fprintf(f, "Lua memory usage (%s):\n",
+            _pooled ? "pooled" : "malloc");
+    fprintf(f, "  %-10s %12s %12s %12s %14s %12s\n", "phase", "allocs",
+            "frees", "reallocs", "allocated KiB", "peak KiB");
+
+    Stats total = {"total", 0, 0, 0, 0, 0};
+
+    for (auto&& s: _phases) {
+        fprintf(f, "  %-10s %12zu %12zu %12zu %14zu %12zu\n", s.phase,
+                s.allocs, s.frees, s.reallocs, s.bytesAllocated / 1024,
+                s.peakBytes / 1024);
+
+        total.allocs += s.allocs;
+        total.frees += s.frees;
+        total.reallocs += s.reallocs;
+        total.bytesAllocated += s.bytesAllocated;
+        if (s.peakBytes > total.peakBytes)
+            total.peakBytes = s.peakBytes;
+    }
+
+    fprintf(f, "  %-10s %12zu %12zu %12zu %14zu %12zu\n", total.phase,
+            total.allocs, total.frees, total.reallocs,
+            total.bytesAllocated / 1024, total.peakBytes / 1024);
+
+    fprintf(f, "  in use: %zu KiB (%zu KiB from malloc), pool chunks: %zu "
+            "(%zu KiB)\n", _bytes / 1024, _largeBytes / 1024, _chunks.size(),
+            reservedBytes() / 1024);
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Memory allocator for Lua states.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <vector>
+
+/**
+ * Allocator for a Lua state (see lua_Alloc). Small blocks are taken from pools
+ * of fixed size classes. The pools are carved out of large chunks with a bump
+ * pointer, and freed blocks are kept on a free list for their size class.
+ * Larger blocks go to malloc. Memory in the pools is only returned to the
+ * system when the allocator is destroyed, so it must outlive the Lua state.
+ *
+ * Lua tells the allocator the size of the block being freed or resized, so no
+ * header is needed for each block. This saves memory for the many small
+ * strings and tables created while generating rules.
+ *
+ * Allocations are counted per phase (e.g., "init", "script") such that the
+ * memory usage of each can be reported.
+ *
+ * This is not thread safe. Each Lua state needs its own allocator.
+ */
+class LuaAllocator {
+public:
+    // Blocks up to this size are pooled.
+    static const size_t maxPooledSize = 512;
+
+    // Size classes are multiples of this.
+    static const size_t granularity = 16;
+
+    static const size_t sizeClasses = maxPooledSize / granularity;
+
+    // Size of the chunks the pools are carved from.
+    static const size_t chunkSize = 64 * 1024;
+
+    /**
+     * Allocation statistics.
+     */
+    struct Stats {
+        const char* phase;
+
+        size_t allocs;
+        size_t frees;
+        size_t reallocs;
+
+        // Total number of bytes requested by allocations and reallocations
+        // that grew a block.
+        size_t bytesAllocated;
+
+        // Highest number of bytes in use.
+        size_t peakBytes;
+    };
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    FreeBlock* _free[sizeClasses];
+
+    // Current chunk being carved up.
+    char* _bump;
+    char* _bumpEnd;
+
+    std::vector<void*> _chunks;
+
+    // Bytes currently in use by Lua.
+    size_t _bytes;
+
+    // Bytes currently in use by Lua that came from malloc.
+    size_t _largeBytes;
+
+    // Statistics for each phase. The last one is the current phase.
+    std::vector<Stats> _phases;
+
+    // If false, all blocks go to malloc. This is only for comparison.
+    bool _pooled;
+
+public:
+    LuaAllocator(bool pooled = true);
+    ~LuaAllocator();
+
+    LuaAllocator(const LuaAllocator&) = delete;
+    LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+    /**
+     * The lua_Alloc function. The user data must point to a LuaAllocator.
+     */
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    /**
+     * Starts a new phase. Subsequent allocations are counted toward it. The
+     * name must outlive the allocator.
+     */
+    void phase(const char* name);
+
+    /**
+     * Returns the statistics of each phase so far.
+     */
+    const std::vector<Stats>& phases() const {
+        return _phases;
+    }
+
+    /**
+     * Bytes currently in use by Lua.
+     */
+    size_t bytes() const {
+        return _bytes;
+    }
+
+    /**
+     * Bytes reserved for the pools.
+     */
+    size_t reservedBytes() const {
+        return _chunks.size() * chunkSize;
+    }
+
+    /**
+     * Prints a report of the memory usage.
+     */
+    void report(FILE* f) const;
+
+private:
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+    void* reallocate(void* ptr, size_t osize, size_t nsize);
+
+    // Allocates or frees a block without counting it.
+    void* rawAllocate(size_t size);
+    void rawFree(void* ptr, size_t size);
+
+    void* allocatePooled(size_t sizeClass);
+
+    bool isPooled(size_t size) const {
+        return _pooled && size <= maxPooledSize;
+    }
+
+    // Updates the number of bytes in use.
+    void grow(size_t size);
+    void shrink(size_t size);
+};
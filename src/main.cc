@@ -6,14 +6,38 @@
  * Description:
  * Program entry point.
  */
-#include <iostream>
+#include <stdio.h>
 
 #include "button-lua.h"
+#include "luaalloc.h"
+
+namespace {
+
+/**
+ * Called on errors outside of a protected call. Same as the panic function set
+ * by luaL_newstate.
+ */
+int panic(lua_State* L) {
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n",
+            lua_tostring(L, -1));
+    return 0;
+}
+
+}
 
 int main(int argc, char **argv) {
-    lua_State *L = luaL_newstate();
+    // Nothing to evaluate if nothing changed since the last run.
+    if (buttonlua::upToDate(argc, argv))
+        return 0;
+
+    // Must outlive the Lua state.
+    LuaAllocator allocator;
+
+    lua_State *L = lua_newstate(LuaAllocator::alloc, &allocator);
     if (!L) return 1;
 
+    lua_atpanic(L, panic);
+
     int ret;
 
     ret = buttonlua::init(L);
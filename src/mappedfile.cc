@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif // _WIN32
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : _data(NULL), _length(0), _mapping(NULL) {}
+
+bool MappedFile::open(const char* path) {
+    close();
+
+    HANDLE h = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(h, &size)) {
+        CloseHandle(h);
+        return false;
+    }
+
+    // Empty files can't be mapped.
+    if (size.QuadPart == 0) {
+        CloseHandle(h);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(h);
+
+    if (!mapping)
+        return false;
+
+    void* p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!p) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    _mapping = mapping;
+    _data = (const char*)p;
+    _length = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        UnmapViewOfFile(_data);
+
+    if (_mapping)
+        CloseHandle(_mapping);
+
+    _data = NULL;
+    _length = 0;
+    _mapping = NULL;
+}
+
+#else // _WIN32
+
+MappedFile::MappedFile() : _data(NULL), _length(0) {}
+
+bool MappedFile::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    // Only regular files can be mapped.
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Empty files can't be mapped.
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED)
+        return false;
+
+    _data = (const char*)p;
+    _length = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        munmap((void*)_data, _length);
+
+    _data = NULL;
+    _length = 0;
+}
+
+#endif // !_WIN32
+
+MappedFile::~MappedFile() {
+    close();
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Read-only memory mapped files.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * A file that is mapped into memory for reading. The mapping is removed when
+ * this object is destroyed.
+ */
+class MappedFile {
+private:
+    const char* _data;
+    size_t _length;
+
+#ifdef _WIN32
+    void* _mapping;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Maps the file at the given path. Returns false on failure. Any file that
+     * was previously mapped is unmapped first.
+     */
+    bool open(const char* path);
+
+    /**
+     * Unmaps the file.
+     */
+    void close();
+
+    /**
+     * The contents of the file. Empty files have a length of zero and may
+     * have a null data pointer.
+     */
+    const char* data() const {
+        return _data;
+    }
+
+    size_t length() const {
+        return _length;
+    }
+};
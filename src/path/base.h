@@ -25,6 +25,11 @@ struct Split {
     T tail;
 };
 
+/**
+ * Common path operations. The platform-specific parts (rootLength, isSep, etc.)
+ * are provided by the derived class, PathImpl, and are resolved at compile time
+ * instead of through virtual calls.
+ */
 template<class PathImpl>
 class BasePath {
 public:
@@ -48,7 +53,8 @@ public:
     int compare(const PathImpl& rhs) const;
 
     /**
-     * Returns the length of the root portion of the path.
+     * Returns the length of the root portion of the path. This is implemented
+     * by PathImpl.
      *
      * On Posix, simply returns "/" if the path starts with it.
      *
@@ -57,7 +63,9 @@ public:
      *
      * If the path is not rooted, returns a path of length 0.
      */
-    virtual size_t rootLength() const = 0;
+    size_t rootLength() const {
+        return impl().rootLength();
+    }
 
     /**
      * Returns a split where the head is the root part of the path and the tail
@@ -164,6 +172,27 @@ public:
      * Returns true if the path matches the given glob pattern.
      */
     bool matches(const PathImpl& pattern) const;
+
+private:
+    const PathImpl& impl() const {
+        return *static_cast<const PathImpl*>(this);
+    }
+
+    /**
+     * Returns the position of the first path separator in [p, end), or end if
+     * there is none.
+     */
+    static const char* findSep(const char* p, const char* end) {
+        return PathImpl::findSep(p, end);
+    }
+
+    /**
+     * Calls f(path, length) for each component of the path. The root (if any)
+     * comes first, followed by the parts between separators. Empty parts are
+     * skipped.
+     */
+    template<class F>
+    void eachComponent(F f) const;
 };
 
 template<class PathImpl>
@@ -283,51 +312,42 @@ std::vector<PathImpl> BasePath<PathImpl>::components() const {
 }
 
 template<class PathImpl>
-void BasePath<PathImpl>::components(std::vector<PathImpl>& v) const {
-    Split<PathImpl> s = split();
+template<class F>
+void BasePath<PathImpl>::eachComponent(F f) const {
+    const size_t root = rootLength();
+    if (root)
+        f(path, root);
 
-    if (s.head.isRoot() && !s.tail.length) {
-        v.push_back(s.head);
-        return;
-    }
+    const char* end = path + length;
 
-    if (s.head.length)
-    {
-        s.head.components(v);
+    for (const char* p = path + root; p < end; ) {
+        const char* sep = findSep(p, end);
 
-        if (s.tail.length)
-            v.push_back(s.tail);
-    }
-    else if (s.tail.length) {
-        v.push_back(s.tail);
+        if (sep != p)
+            f(p, (size_t)(sep - p));
+
+        p = sep + 1;
     }
 }
 
 template<class PathImpl>
-int BasePath<PathImpl>::components(lua_State* L) const {
-    Split<PathImpl> s = split();
-
-    if (s.head.isRoot() && !s.tail.length) {
-        lua_pushlstring(L, s.head.path, s.head.length);
-        return 1;
-    }
+void BasePath<PathImpl>::components(std::vector<PathImpl>& v) const {
+    eachComponent([&](const char* p, size_t len) {
+        v.push_back(PathImpl(p, len));
+    });
+}
 
-    if (s.head.length)
-    {
-        int n = s.head.components(L);
-        if (s.tail.length) {
-            lua_pushlstring(L, s.tail.path, s.tail.length);
-            return n + 1;
-        }
+template<class PathImpl>
+int BasePath<PathImpl>::components(lua_State* L) const {
+    int n = 0;
 
-        return n;
-    }
-    else if (s.tail.length) {
-        lua_pushlstring(L, s.tail.path, s.tail.length);
-        return 1;
-    }
+    eachComponent([&](const char* p, size_t len) {
+        luaL_checkstack(L, 1, "too many path components");
+        lua_pushlstring(L, p, len);
+        ++n;
+    });
 
-    return 0;
+    return n;
 }
 
 template<class PathImpl>
@@ -337,38 +357,88 @@ std::string BasePath<PathImpl>::norm() const {
     return buf;
 }
 
+/**
+ * The path is normalized in a single pass over its components, which are
+ * appended to the buffer as they are found. Instead of keeping a stack of
+ * components, ".." removes the last component from the end of the buffer. Each
+ * character is thus written and removed at most once.
+ *
+ * Like join(), the result is appended to the buffer if the path is relative.
+ */
 template<class PathImpl>
 void BasePath<PathImpl>::norm(std::string& buf) const {
+    const size_t root = rootLength();
+
+    if (root)
+        buf.assign(path, root);
+
+    // Start of the components we've added. We never remove anything before it.
+    const size_t base = buf.size();
+
+    // Number of components after base that can be removed by "..". Any ".."
+    // components that could not be resolved come before these.
+    size_t removable = 0;
+
+    // Whether anything has been added after base.
+    bool empty = true;
+
+    const char* end = path + length;
 
-    // Stack of path components that we build up.
-    std::vector<PathImpl> stack;
+    for (const char* p = path + root; p < end; ) {
+        const char* sep = findSep(p, end);
+        const size_t len = (size_t)(sep - p);
+        const char* c = p;
 
-    for (auto&& c: components()) {
-        if (c.isDot()) {
-            // Filter out "." path components
+        p = sep + 1;
+
+        if (len == 0 || (len == 1 && c[0] == '.')) {
+            // Filter out empty and "." path components
             continue;
         }
-        else if (c.isDotDot() && !stack.empty() && !stack.back().isDotDot()) {
-            if (!stack.back().isabs())
-                stack.pop_back();
+
+        if (len == 2 && c[0] == '.' && c[1] == '.') {
+            if (removable > 0) {
+                // Remove the last component along with the separator that was
+                // added before it (if any).
+                size_t i = buf.size();
+                while (i > base && !PathImpl::isSep(buf[i-1]))
+                    --i;
+
+                if (i > base)
+                    --i;
+
+                buf.resize(i);
+                --removable;
+                empty = buf.size() == base;
+                continue;
+            }
+
+            if (root) {
+                // Can't go above the root.
+                continue;
+            }
         }
         else {
-            stack.push_back(c);
+            ++removable;
         }
+
+        const size_t n = buf.size();
+        if (n > 0 && !PathImpl::isSep(buf[n-1]))
+            buf.push_back(PathImpl::defaultSep);
+
+        buf.append(c, len);
+        empty = false;
     }
 
-    if (stack.empty()) {
+    if (empty && !root)
         PathImpl(".").join(buf);
-    }
-    else {
-        for (auto&& c: stack)
-            c.join(buf);
-    }
 
-    // Normalize path separators. This should get optimized out for Posix paths.
-    for (auto& ch: buf) {
-        if (PathImpl::isSep(ch) && ch != PathImpl::defaultSep)
-            ch = PathImpl::defaultSep;
+    // Normalize path separators. Components don't contain separators and only
+    // the default one is added between them, so only the part before them
+    // needs to be checked. This should get optimized out for Posix paths.
+    for (size_t i = 0; i < base; ++i) {
+        if (PathImpl::isSep(buf[i]) && buf[i] != PathImpl::defaultSep)
+            buf[i] = PathImpl::defaultSep;
     }
 }
 
@@ -28,5 +28,14 @@ public:
         return c == '/';
     }
 
+    /**
+     * Returns the position of the first path separator in [p, end), or end if
+     * there is none. memchr is vectorized by the C library.
+     */
+    static inline const char* findSep(const char* p, const char* end) {
+        const void* sep = memchr(p, '/', (size_t)(end - p));
+        return sep ? (const char*)sep : end;
+    }
+
     size_t rootLength() const;
 };
@@ -13,6 +13,15 @@
 #include <string>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define WINPATH_SSE2
+#   include <emmintrin.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   endif
+#endif
+
 #include "path/base.h"
 
 class WinPath : public BasePath<WinPath> {
@@ -28,5 +37,41 @@ public:
         return c == '/' || c == '\\';
     }
 
+    /**
+     * Returns the position of the first path separator in [p, end), or end if
+     * there is none. Since there are two separators, memchr can't be used.
+     * Instead, 16 bytes are checked at a time with SSE2 if it is available.
+     */
+    static inline const char* findSep(const char* p, const char* end) {
+#ifdef WINPATH_SSE2
+        const __m128i slash = _mm_set1_epi8('/');
+        const __m128i backslash = _mm_set1_epi8('\\');
+
+        for (; end - p >= 16; p += 16) {
+            const __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+            const int mask = _mm_movemask_epi8(_mm_or_si128(
+                        _mm_cmpeq_epi8(chunk, slash),
+                        _mm_cmpeq_epi8(chunk, backslash)));
+
+            if (mask != 0) {
+#   ifdef _MSC_VER
+                unsigned long i;
+                _BitScanForward(&i, (unsigned long)mask);
+                return p + i;
+#   else
+                return p + __builtin_ctz((unsigned)mask);
+#   endif
+            }
+        }
+#endif
+
+        for (; p < end; ++p) {
+            if (isSep(*p))
+                return p;
+        }
+
+        return end;
+    }
+
     size_t rootLength() const;
 };
@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Table of interned paths.
+ */
+#include "pathtable.h"
+
+#include <string.h>
+
+const PathId PathTable::dot;
+
+namespace {
+
+const size_t initialSlots = 1024;
+
+uint32_t hashChild(PathId parent, const char* name, size_t len) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(parent); ++i) {
+        h ^= (uint8_t)(parent >> (i * 8));
+        h *= 16777619u;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+}
+
+PathTable::PathTable() : _slots(initialSlots, 0) {
+    Node node = {};
+    node.parent = dot;
+    node.length = 1;
+    node.kind = kindDot;
+
+    _nodes.push_back(node);
+}
+
+void PathTable::grow() {
+    std::vector<PathId> slots(_slots.size() * 2, 0);
+    const size_t mask = slots.size() - 1;
+
+    for (PathId id = 1; id < (PathId)_nodes.size(); ++id) {
+        size_t i = _nodes[id].hash & mask;
+        while (slots[i] != 0)
+            i = (i + 1) & mask;
+
+        slots[i] = id;
+    }
+
+    _slots.swap(slots);
+}
+
+PathId PathTable::child(PathId parent, const char* name, size_t len,
+        Kind kind) {
+
+    const uint32_t hash = hashChild(parent, name, len);
+    const size_t mask = _slots.size() - 1;
+
+    size_t i = hash & mask;
+
+    for (; _slots[i] != 0; i = (i + 1) & mask) {
+        const Node& node = _nodes[_slots[i]];
+        if (node.hash == hash && node.parent == parent &&
+                node.nameLength == len &&
+                memcmp(_names.data() + node.name, name, len) == 0)
+            return _slots[i];
+    }
+
+    const PathId id = (PathId)_nodes.size();
+
+    const Node& p = _nodes[parent];
+
+    Node node;
+    node.parent = parent;
+    node.name = (uint32_t)_names.size();
+    node.nameLength = (uint32_t)len;
+    node.hash = hash;
+    node.kind = kind;
+
+    if (parent == dot) {
+        node.sep = false;
+        node.length = (uint32_t)len;
+    }
+    else {
+        node.sep = !Path::isSep(_names[p.name + p.nameLength - 1]);
+        node.length = p.length + node.sep + (uint32_t)len;
+    }
+
+    _names.append(name, len);
+    _nodes.push_back(node);
+
+    _slots[i] = id;
+
+    // Keep the load factor at or below one half.
+    if (_nodes.size() * 2 > _slots.size())
+        grow();
+
+    return id;
+}
+
+PathId PathTable::intern(PathId base, Path path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    PathId id = base;
+
+    const size_t root = path.rootLength();
+
+    if (root) {
+        // Normalize the separators in the root.
+        std::string r(path.path, root);
+        for (auto& ch: r) {
+            if (Path::isSep(ch))
+                ch = Path::defaultSep;
+        }
+
+        id = child(dot, r.data(), r.length(), kindRoot);
+    }
+
+    const char* end = path.path + path.length;
+
+    for (const char* p = path.path + root; p < end; ) {
+        const char* sep = Path::findSep(p, end);
+        const size_t len = (size_t)(sep - p);
+        const char* c = p;
+
+        p = sep + 1;
+
+        if (len == 0 || (len == 1 && c[0] == '.')) {
+            // Filter out empty and "." path components
+            continue;
+        }
+
+        if (len == 2 && c[0] == '.' && c[1] == '.') {
+            switch (_nodes[id].kind) {
+                case kindName:
+                    id = _nodes[id].parent;
+                    break;
+                case kindRoot:
+                    // Can't go above the root.
+                    break;
+                default:
+                    id = child(id, c, len, kindDotDot);
+                    break;
+            }
+
+            continue;
+        }
+
+        id = child(id, c, len, kindName);
+    }
+
+    return id;
+}
+
+PathId PathTable::parent(PathId id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const Node& node = _nodes[id];
+
+    switch (node.kind) {
+        case kindName:
+            return node.parent;
+        case kindDotDot:
+            return child(id, "..", 2, kindDotDot);
+        default:
+            return id;
+    }
+}
+
+std::string PathTable::basename(PathId id) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const Node& node = _nodes[id];
+
+    if (id == dot)
+        return ".";
+
+    return std::string(_names.data() + node.name, node.nameLength);
+}
+
+void PathTable::str(PathId id, std::string& buf) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (id == dot) {
+        buf.assign(".");
+        return;
+    }
+
+    // Fill in the components from the end.
+    buf.resize(_nodes[id].length);
+
+    size_t i = buf.size();
+
+    while (id != dot) {
+        const Node& node = _nodes[id];
+
+        i -= node.nameLength;
+        memcpy(&buf[i], _names.data() + node.name, node.nameLength);
+
+        if (node.sep)
+            buf[--i] = Path::defaultSep;
+
+        id = node.parent;
+    }
+}
+
+size_t PathTable::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _nodes.size();
+}
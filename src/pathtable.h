@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Table of interned paths.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "path.h"
+
+/**
+ * Identifies a path in a PathTable.
+ */
+typedef uint32_t PathId;
+
+/**
+ * A table of interned, normalized paths. Paths are stored as a prefix tree of
+ * their components such that common directories are only stored once. Each
+ * path is identified by the index of its node in the tree. Since paths are
+ * normalized when they are added, two paths are equal if and only if they have
+ * the same ID. Note that paths are compared exactly, even on Windows.
+ *
+ * The root of the tree is the empty path, ".". Absolute paths start with a node
+ * for their root (e.g., "/" or "C:\").
+ *
+ * This is thread safe.
+ */
+class PathTable {
+public:
+    /**
+     * ID of the path ".".
+     */
+    static const PathId dot = 0;
+
+    PathTable();
+
+    PathTable(const PathTable&) = delete;
+    PathTable& operator=(const PathTable&) = delete;
+
+    /**
+     * Adds a path if it isn't in the table already and returns its ID. The path
+     * is normalized like path.norm().
+     */
+    PathId intern(Path path) {
+        return intern(dot, path);
+    }
+
+    /**
+     * Joins a path to another one and adds the result. This is like
+     * path.norm(path.join(base, path)), but without creating any strings.
+     */
+    PathId intern(PathId base, Path path);
+
+    /**
+     * Returns the directory that contains the path. The root and "." are
+     * their own parents. The parent of ".." is "../..".
+     */
+    PathId parent(PathId id);
+
+    /**
+     * Returns the last component of the path. For roots, this is the root
+     * itself.
+     */
+    std::string basename(PathId id) const;
+
+    /**
+     * Replaces the contents of the buffer with the path.
+     */
+    void str(PathId id, std::string& buf) const;
+
+    std::string str(PathId id) const {
+        std::string buf;
+        str(id, buf);
+        return buf;
+    }
+
+    /**
+     * Returns the number of paths in the table, including ".".
+     */
+    size_t size() const;
+
+private:
+    enum Kind : uint8_t {
+        kindDot,     // "."
+        kindRoot,    // A root such as "/" or "C:\"
+        kindDotDot,  // ".."
+        kindName,    // Any other component
+    };
+
+    struct Node {
+        PathId parent;
+
+        // Length of the whole path as a string.
+        uint32_t length;
+
+        // Position and length of the last component in the names buffer.
+        uint32_t name;
+        uint32_t nameLength;
+
+        // Hash of the parent ID and the name.
+        uint32_t hash;
+
+        Kind kind;
+
+        // True if a separator comes between the parent and the name.
+        bool sep;
+    };
+
+    /**
+     * Returns the child of a node with the given name, adding it if needed. The
+     * mutex must be held.
+     */
+    PathId child(PathId parent, const char* name, size_t len, Kind kind);
+
+    /**
+     * Doubles the size of the hash table.
+     */
+    void grow();
+
+    std::vector<Node> _nodes;
+
+    // The names of all components, one after the other.
+    std::string _names;
+
+    // Open addressing hash table of nodes, keyed by their parent ID and name.
+    // Since "." is never a child, 0 marks an empty slot.
+    std::vector<PathId> _slots;
+
+    mutable std::mutex _mutex;
+};
@@ -9,7 +9,14 @@
 #include "lua.hpp"
 
 #include <stdio.h>
+
+#include <string>
+#include <vector>
+
 #include "rules.h"
+#include "path.h"
+#include "lua_path.h"
+#include "lua_argv.h"
 
 namespace {
 
@@ -20,6 +27,7 @@ int json_print(lua_State* L, FILE* f);
 const char* json_escape_sequence(char c);
 void json_print_string(const char* s, size_t len, FILE* f);
 int json_print_table(lua_State* L, FILE* f);
+void json_print_argv(lua_State* L, FILE* f);
 int json_print(lua_State* L, FILE* f);
 
 /**
@@ -41,13 +49,19 @@ const char* json_escape_sequence(char c) {
 void json_print_string(const char* s, size_t len, FILE* f) {
     fputc('"', f); // Opening quote
 
+    // Write out runs of characters that don't need escaping in one go.
+    size_t start = 0;
+
     for (size_t i = 0; i < len; ++i) {
-        if (const char* r = json_escape_sequence(s[i]))
+        if (const char* r = json_escape_sequence(s[i])) {
+            fwrite(s + start, 1, i - start, f);
             fputs(r, f);
-        else
-            fputc(s[i], f);
+            start = i + 1;
+        }
     }
 
+    fwrite(s + start, 1, len - start, f);
+
     fputc('"', f); // Closing quote
 }
 
@@ -83,6 +97,25 @@ int json_print_table(lua_State* L, FILE* f) {
     return 0;
 }
 
+/**
+ * Prints the argv list at the top of the stack by walking its segments.
+ */
+void json_print_argv(lua_State* L, FILE* f) {
+    fputs("[", f);
+
+    bool first = true;
+
+    lua_argveach(L, -1, [&](lua_State* L) {
+        if (!first)
+            fputs(", ", f);
+
+        first = false;
+        json_print(L, f);
+    });
+
+    fputs("]", f);
+}
+
 /**
  * Prints the value at the top of the stack.
  */
@@ -111,6 +144,25 @@ int json_print(lua_State* L, FILE* f) {
             json_print_string(s, len, f);
         break;
 
+    case LUA_TUSERDATA: {
+        // Path handles are written straight from the path table.
+        PathTable* table;
+        PathId id;
+        if (lua_topathid(L, -1, &table, &id)) {
+            static thread_local std::string buf;
+            table->str(id, buf);
+            json_print_string(buf.data(), buf.length(), f);
+            break;
+        }
+
+        if (lua_isargv(L, -1)) {
+            json_print_argv(L, f);
+            break;
+        }
+    }
+
+        // Fall through
+
     default:
         return luaL_error(L, "cannot represent type %s as JSON",
                 luaL_typename(L, -1));
@@ -119,6 +171,251 @@ int json_print(lua_State* L, FILE* f) {
     return 0;
 }
 
+/**
+ * Prints the given list of strings as a JSON array.
+ */
+void json_print_strings(const buttonlua::StringRefs& list, FILE* f) {
+    fputs("[", f);
+
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (i > 0)
+            fputs(", ", f);
+
+        json_print_string(list[i].data, list[i].length, f);
+    }
+
+    fputs("]", f);
+}
+
+/**
+ * Returns true if the value at the top of the stack is a string or a path
+ * handle.
+ */
+bool is_string(lua_State* L) {
+    const int type = lua_type(L, -1);
+    return (type == LUA_TSTRING || type == LUA_TUSERDATA) &&
+        lua_topath(L, -1, NULL);
+}
+
+/**
+ * Raises an error if the value at the top of the stack is not a list of
+ * strings. The list can be a table or an argv list. Returns its length.
+ *
+ * The lists of expandCompile are checked with this before anything is
+ * allocated since raising an error skips destructors.
+ */
+size_t check_strings(lua_State* L, const char* field) {
+
+    size_t n = 0;
+
+    // Index and type of the first element that isn't a string.
+    size_t bad = 0;
+    const char* badType = NULL;
+
+    if (lua_isargv(L, -1)) {
+        // Errors must not be raised from inside of the callback.
+        lua_argveach(L, -1, [&](lua_State* L) {
+            ++n;
+            if (!bad && !is_string(L)) {
+                bad = n;
+                badType = luaL_typename(L, -1);
+            }
+        });
+    }
+    else if (lua_type(L, -1) == LUA_TTABLE) {
+        while (!bad) {
+            lua_rawgeti(L, -1, (lua_Integer)n + 1);
+
+            if (lua_isnil(L, -1)) {
+                lua_pop(L, 1);
+                break;
+            }
+
+            ++n;
+            if (!is_string(L)) {
+                bad = n;
+                badType = luaL_typename(L, -1);
+            }
+
+            lua_pop(L, 1);
+        }
+    }
+    else {
+        luaL_error(L, "bad type for field '%s' (table expected, got %s)",
+                field, luaL_typename(L, -1));
+    }
+
+    if (bad)
+        luaL_error(L, "bad type for element %d of field '%s' "
+                "(string expected, got %s)", (int)bad, field, badType);
+
+    return n;
+}
+
+/**
+ * Raises an error if the field of the table at the given index is not a list
+ * of strings. Nil is only allowed if the field is optional. Returns the length
+ * of the list.
+ */
+size_t check_string_list(lua_State* L, int i, const char* field,
+        bool optional) {
+    lua_getfield(L, i, field);
+
+    size_t n = 0;
+
+    if (!lua_isnil(L, -1))
+        n = check_strings(L, field);
+    else if (!optional)
+        luaL_error(L, "missing field '%s'", field);
+
+    lua_pop(L, 1);
+    return n;
+}
+
+/**
+ * Raises an error if the field of the table at the given index is neither nil
+ * nor a string.
+ */
+void check_string(lua_State* L, int i, const char* field) {
+    lua_getfield(L, i, field);
+
+    if (!lua_isnil(L, -1) && !is_string(L))
+        luaL_error(L, "bad type for field '%s' (string expected, got %s)",
+                field, luaL_typename(L, -1));
+
+    lua_pop(L, 1);
+}
+
+/**
+ * Checks the src_deps field of the table at the given index and pushes a copy
+ * of it where every key is a string. Sources given as path handles are looked
+ * up by their string, so keys given as path handles must be strings too.
+ * Pushes nil if there is no such field.
+ */
+void push_src_deps(lua_State* L, int i) {
+    lua_getfield(L, i, "src_deps");
+    if (lua_isnil(L, -1))
+        return;
+
+    if (lua_type(L, -1) != LUA_TTABLE)
+        luaL_error(L, "bad type for field '%s' (table expected, got %s)",
+                "src_deps", luaL_typename(L, -1));
+
+    const int t = lua_gettop(L);
+    lua_newtable(L);
+
+    lua_pushnil(L);
+    while (lua_next(L, t)) {
+        if (!lua_isnil(L, -1))
+            check_strings(L, "src_deps");
+
+        // Converting the key itself would confuse lua_next.
+        lua_pushvalue(L, -2);
+
+        size_t len;
+        const char* key = lua_topath(L, -1, &len);
+        if (!key)
+            luaL_error(L, "bad key type in field '%s' (string expected, "
+                    "got %s)", "src_deps", luaL_typename(L, -1));
+
+        lua_pushlstring(L, key, len);
+        lua_pushvalue(L, -3);
+        lua_rawset(L, t + 1);
+
+        lua_pop(L, 2); // Pop value and the copy of the key
+    }
+
+    lua_remove(L, t);
+}
+
+/**
+ * Adds the strings in the list at the top of the stack to the vector. The list
+ * must have been checked with check_strings.
+ */
+void get_strings(lua_State* L, buttonlua::StringRefs& list) {
+
+    if (lua_isargv(L, -1)) {
+        lua_argveach(L, -1, [&](lua_State* L) {
+            buttonlua::StringRef s;
+            s.data = lua_topath(L, -1, &s.length);
+            list.push_back(s);
+        });
+        return;
+    }
+
+    for (int j = 1; ; ++j) {
+        lua_rawgeti(L, -1, j);
+
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        buttonlua::StringRef s;
+        s.data = lua_topath(L, -1, &s.length);
+        list.push_back(s);
+
+        lua_pop(L, 1);
+    }
+}
+
+/**
+ * Gets a list of strings from the field of the table at the given index. The
+ * list is left on the stack such that the strings stay alive. Returns false if
+ * the field is nil. The field must have been checked with check_string_list.
+ */
+bool get_string_list(lua_State* L, int i, const char* field,
+        buttonlua::StringRefs& list) {
+
+    lua_getfield(L, i, field);
+
+    if (lua_isnil(L, -1))
+        return false;
+
+    get_strings(L, list);
+    return true;
+}
+
+/**
+ * Gets an optional string from the field of the table at the given index. The
+ * string is left on the stack. Returns false if the field is nil, in which case
+ * the string is empty. The field must have been checked with check_string.
+ */
+bool get_string(lua_State* L, int i, const char* field,
+        buttonlua::StringRef& s) {
+
+    s.data = "";
+    s.length = 0;
+
+    lua_getfield(L, i, field);
+
+    if (lua_isnil(L, -1))
+        return false;
+
+    s.data = lua_topath(L, -1, &s.length);
+    return true;
+}
+
+/**
+ * Joins the path to the script directory and normalizes it. Like
+ * path.norm(path.join(dir, p)).
+ */
+void script_path(const buttonlua::StringRef& dir, const buttonlua::StringRef& p,
+        std::string& tmp, std::string& buf) {
+    tmp.assign(dir.data, dir.length);
+    Path(p.data, p.length).join(tmp);
+
+    buf.clear();
+    Path(tmp).norm(buf);
+}
+
+/**
+ * Returns true if the value at the given index is a table or an argv list.
+ */
+bool is_list(lua_State* L, int i) {
+    return lua_type(L, i) == LUA_TTABLE || lua_isargv(L, i);
+}
+
 /**
  * Prints a single field of a JSON dictionary.
  */
@@ -154,7 +451,7 @@ int Rules::add(lua_State* L) {
 
     // Inputs (required)
     lua_getfield(L, 1, "inputs");
-    if (lua_type(L, -1) == LUA_TTABLE)
+    if (is_list(L, -1))
         json_print_field(L, "inputs", _f);
     else
         return luaL_error(L, "bad type for field '%s' (table expected, got %s)",
@@ -162,7 +459,7 @@ int Rules::add(lua_State* L) {
 
     // Task (required)
     lua_getfield(L, 1, "task");
-    if (lua_type(L, -1) == LUA_TTABLE) {
+    if (is_list(L, -1)) {
         fputs(",\n        ", _f);
         json_print_field(L, "task", _f);
     }
@@ -172,7 +469,7 @@ int Rules::add(lua_State* L) {
 
     // Outputs (required)
     lua_getfield(L, 1, "outputs");
-    if (lua_type(L, -1) == LUA_TTABLE) {
+    if (is_list(L, -1)) {
         fputs(",\n        ", _f);
         json_print_field(L, "outputs", _f);
     }
@@ -184,6 +481,7 @@ int Rules::add(lua_State* L) {
     lua_getfield(L, 1, "cwd");
     switch (lua_type(L, -1))
     {
+    case LUA_TUSERDATA:
     case LUA_TSTRING:
         fputs(",\n        ", _f);
         json_print_field(L, "cwd", _f);
@@ -218,4 +516,118 @@ int Rules::add(lua_State* L) {
     return 0;
 }
 
+void Rules::add(const StringRefs& inputs, const StringRefs& task,
+        const StringRefs& outputs, const StringRef* display) {
+
+    if (_n > 0)
+        fputs(",", _f);
+
+    fputs("\n    {\n        \"inputs\": ", _f);
+    json_print_strings(inputs, _f);
+
+    fputs(",\n        \"task\": [", _f);
+    json_print_strings(task, _f);
+    fputs("]", _f);
+
+    fputs(",\n        \"outputs\": ", _f);
+    json_print_strings(outputs, _f);
+
+    if (display) {
+        fputs(",\n        \"display\": ", _f);
+        json_print_string(display->data, display->length, _f);
+    }
+
+    fputs("\n    }", _f);
+
+    ++_n;
+}
+
+int Rules::expandCompile(lua_State* L) {
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    // Everything is checked before anything is allocated since raising an
+    // error skips destructors.
+    check_string_list(L, 1, "args", false);
+    check_string_list(L, 1, "headers", true);
+    const size_t sourceCount = check_string_list(L, 1, "sources", false);
+    const size_t objectCount = check_string_list(L, 1, "objects", false);
+    check_string(L, 1, "scriptdir");
+    check_string(L, 1, "display");
+
+    if (sourceCount != objectCount)
+        return luaL_error(L, "number of sources (%d) and objects (%d) differ",
+                (int)sourceCount, (int)objectCount);
+
+    push_src_deps(L, 1);
+    const int srcDeps = lua_gettop(L);
+
+    StringRefs args, headers, sources, objects;
+
+    get_string_list(L, 1, "args", args);
+    get_string_list(L, 1, "headers", headers);
+    get_string_list(L, 1, "sources", sources);
+    get_string_list(L, 1, "objects", objects);
+
+    StringRef scriptDir, display;
+    get_string(L, 1, "scriptdir", scriptDir);
+    const bool hasDisplay = get_string(L, 1, "display", display);
+
+    // These buffers are reused for every source.
+    std::string tmp, src, displayBuf;
+    std::vector<std::string> deps;
+    StringRefs depRefs, inputs, task, outputs(1);
+
+    const StringRef compileFlag = {"-c", 2};
+    const StringRef outputFlag = {"-o", 2};
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const int top = lua_gettop(L);
+
+        // Additional dependencies for this source.
+        depRefs.clear();
+        if (!lua_isnil(L, srcDeps)) {
+            lua_pushlstring(L, sources[i].data, sources[i].length);
+            lua_rawget(L, srcDeps);
+            if (!lua_isnil(L, -1))
+                get_strings(L, depRefs);
+        }
+
+        if (deps.size() < depRefs.size())
+            deps.resize(depRefs.size());
+
+        for (size_t j = 0; j < depRefs.size(); ++j)
+            script_path(scriptDir, depRefs[j], tmp, deps[j]);
+
+        script_path(scriptDir, sources[i], tmp, src);
+
+        const StringRef srcRef = {src.data(), src.length()};
+
+        inputs.assign(headers.begin(), headers.end());
+        inputs.push_back(srcRef);
+        for (size_t j = 0; j < depRefs.size(); ++j) {
+            const StringRef dep = {deps[j].data(), deps[j].length()};
+            inputs.push_back(dep);
+        }
+
+        task.assign(args.begin(), args.end());
+        task.push_back(compileFlag);
+        task.push_back(srcRef);
+        task.push_back(outputFlag);
+        task.push_back(objects[i]);
+
+        outputs[0] = objects[i];
+
+        displayBuf.assign(display.data, display.length);
+        displayBuf.append(src);
+        const StringRef displayRef = {displayBuf.data(), displayBuf.length()};
+
+        add(inputs, task, outputs, hasDisplay ? &displayRef : NULL);
+
+        lua_settop(L, top);
+    }
+
+    return 0;
+}
+
 } // namespace buttonlua
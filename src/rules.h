@@ -10,10 +10,22 @@
 
 #include <stdio.h>
 
+#include <vector>
+
 struct lua_State;
 
 namespace buttonlua {
 
+/**
+ * A string that is not owned.
+ */
+struct StringRef {
+    const char* data;
+    size_t length;
+};
+
+typedef std::vector<StringRef> StringRefs;
+
 class Rules
 {
 private:
@@ -32,6 +44,45 @@ public:
      */
     int add(lua_State *L);
 
+    /**
+     * Outputs a rule with a single command to the file. The display string is
+     * optional.
+     */
+    void add(const StringRefs& inputs, const StringRefs& task,
+            const StringRefs& outputs, const StringRef* display = NULL);
+
+    /**
+     * Outputs a compile rule for each source file. This is equivalent to the
+     * following, but without creating any Lua tables for each source:
+     *
+     *     for i,src in ipairs(t.sources) do
+     *         local deps = {}
+     *         for _,v in ipairs(t.src_deps[src] or {}) do
+     *             table.insert(deps, path.norm(path.join(t.scriptdir, v)))
+     *         end
+     *
+     *         src = path.norm(path.join(t.scriptdir, src))
+     *
+     *         rule {
+     *             inputs  = table.join(t.headers, {src}, deps),
+     *             task    = {table.join(t.args, {"-c", src, "-o", t.objects[i]})},
+     *             outputs = {t.objects[i]},
+     *             display = t.display .. src,
+     *         }
+     *     end
+     *
+     * The table `t` is the first argument. The fields `headers`, `src_deps`,
+     * `scriptdir`, and `display` are optional.
+     */
+    int expandCompile(lua_State* L);
+
+    /**
+     * Returns the number of rules that have been output.
+     */
+    size_t count() const {
+        return _n;
+    }
+
 private:
     int stringToJSON(lua_State* L, const char* field, size_t i);
     int listToJSON(lua_State* L, const char* field, size_t i);
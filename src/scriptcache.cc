@@ -0,0 +1,251 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif // _WIN32
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "lua.hpp"
+
+#include "scriptcache.h"
+#include "mappedfile.h"
+#include "xxh3.h"
+
+namespace {
+
+/**
+ * 64-bit FNV-1a hash.
+ */
+uint64_t hash(uint64_t h, const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+
+    return h;
+}
+
+const uint64_t hashSeed = 14695981039346656037ull;
+
+/**
+ * Returns true if the buffer is a precompiled chunk.
+ */
+bool isBytecode(const char* data, size_t length) {
+    return length > 0 && data[0] == LUA_SIGNATURE[0];
+}
+
+/**
+ * Returns the number of bytes to skip at the start of a script. Like
+ * luaL_loadfile, a UTF-8 byte order mark and a first line starting with '#' are
+ * skipped. The new line is kept such that line numbers don't change.
+ */
+size_t skipHeader(const char* data, size_t length) {
+    size_t i = 0;
+
+    if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        i = 3;
+
+    if (i < length && data[i] == '#') {
+        while (i < length && data[i] != '\n')
+            ++i;
+    }
+
+    return i;
+}
+
+/**
+ * Comes before the bytecode in a cache entry. Lua doesn't verify bytecode, so a
+ * truncated or modified entry could crash the interpreter if it were loaded.
+ */
+struct EntryHeader {
+    uint64_t length;
+    uint64_t checksum;
+};
+
+/**
+ * Finds the bytecode in a cache entry. Returns false if it doesn't match its
+ * header.
+ */
+bool checkEntry(const char* data, size_t length, const char*& bytecode,
+        size_t& bytecodeLength) {
+
+    EntryHeader header;
+    if (length < sizeof(header))
+        return false;
+
+    memcpy(&header, data, sizeof(header));
+
+    bytecode = data + sizeof(header);
+    bytecodeLength = length - sizeof(header);
+
+    return header.length == bytecodeLength &&
+        header.checksum == xxh3(bytecode, bytecodeLength);
+}
+
+int writer(lua_State* L, const void* p, size_t sz, void* ud) {
+    ((std::string*)ud)->append((const char*)p, sz);
+    return 0;
+}
+
+/**
+ * Writes the file such that other processes and threads never see a partially
+ * written file. Returns false on failure.
+ */
+bool writeAtomic(const std::string& dir, const std::string& path,
+        const std::string& data) {
+
+    static std::atomic<unsigned> counter(0);
+
+#ifdef _WIN32
+    CreateDirectoryA(dir.c_str(), NULL);
+    const unsigned long pid = GetCurrentProcessId();
+#else
+    mkdir(dir.c_str(), 0755);
+    const unsigned long pid = (unsigned long)getpid();
+#endif
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", pid, counter++);
+
+    const std::string tmp = path + suffix;
+
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+
+    const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+
+    if (fclose(f) != 0 || !ok) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+#endif
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+ScriptCache::ScriptCache(const char* dir) {
+    if (dir)
+        _dir = dir;
+}
+
+int ScriptCache::load(lua_State* L, const char* path) {
+    if (path) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _loaded.push_back(path);
+    }
+
+    if (_dir.empty() || !path)
+        return luaL_loadfile(L, path);
+
+    MappedFile source;
+    if (!source.open(path))
+        return luaL_loadfile(L, path); // For the error message
+
+    // Already compiled
+    if (isBytecode(source.data(), source.length()))
+        return luaL_loadfile(L, path);
+
+    const size_t skip = skipHeader(source.data(), source.length());
+    const char* code = source.data() + skip;
+    const size_t codeLength = source.length() - skip;
+
+    lua_pushfstring(L, "@%s", path);
+    const char* chunkname = lua_tostring(L, -1);
+
+    // The path is part of the key because the bytecode includes the chunk name
+    // for error messages.
+    uint64_t h = hashSeed;
+    h = hash(h, LUA_RELEASE, sizeof(LUA_RELEASE));
+    h = hash(h, path, strlen(path) + 1);
+    h = hash(h, code, codeLength);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.luac", (unsigned long long)h);
+
+    std::string cachePath = _dir;
+    cachePath.push_back('/');
+    cachePath.append(name);
+
+    MappedFile cached;
+    const char* bytecode;
+    size_t bytecodeLength;
+
+    // Entries that don't match their header or that Lua rejects get replaced
+    // below.
+    if (cached.open(cachePath.c_str()) &&
+            checkEntry(cached.data(), cached.length(), bytecode,
+                bytecodeLength)) {
+        if (luaL_loadbufferx(L, bytecode, bytecodeLength, chunkname,
+                    "b") == LUA_OK) {
+            lua_remove(L, -2); // Pop chunk name
+            return LUA_OK;
+        }
+
+        lua_pop(L, 1);
+    }
+
+    cached.close();
+
+    const int result = luaL_loadbufferx(L, code, codeLength, chunkname, "t");
+    lua_remove(L, -2); // Pop chunk name
+
+    if (result != LUA_OK)
+        return result;
+
+    // The header is filled in once the bytecode is known.
+    std::string entry(sizeof(EntryHeader), '\0');
+
+#if LUA_VERSION_NUM >= 503
+    if (lua_dump(L, writer, &entry, 0) == 0) {
+#else
+    if (lua_dump(L, writer, &entry) == 0) {
+#endif
+        EntryHeader header;
+        header.length = entry.size() - sizeof(header);
+        header.checksum = xxh3(entry.data() + sizeof(header), header.length);
+        memcpy(&entry[0], &header, sizeof(header));
+
+        writeAtomic(_dir, cachePath, entry);
+    }
+
+    return LUA_OK;
+}
+
+bool ScriptCache::write(const char* name, const std::string& data) const {
+    if (_dir.empty())
+        return false;
+
+    std::string path = _dir;
+    path.push_back('/');
+    path.append(name);
+
+    return writeAtomic(_dir, path, data);
+}
+
+std::vector<std::string> ScriptCache::loaded() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _loaded;
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Caches compiled build scripts on disk.
+ */
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct lua_State;
+
+/**
+ * Caches the bytecode of build scripts such that unchanged scripts don't need
+ * to be parsed again on the next run. Each script is cached in its own file in
+ * the cache directory. The name of the file is a hash of the script's contents,
+ * its path, and the version of Lua. Thus, entries never need to be
+ * invalidated; a changed script simply gets a new entry. The bytecode is only
+ * loaded if its length and checksum match the ones stored with it.
+ *
+ * The path of every script that is loaded is kept, whether or not caching is
+ * enabled, such that runs can be fingerprinted.
+ *
+ * This is thread safe.
+ */
+class ScriptCache {
+private:
+    // Directory to store cached bytecode in. Empty if caching is disabled.
+    std::string _dir;
+
+    // Paths given to load(), in the order they were given.
+    mutable std::mutex _mutex;
+    std::vector<std::string> _loaded;
+
+public:
+    /**
+     * If the directory is NULL or empty, caching is disabled.
+     */
+    ScriptCache(const char* dir = NULL);
+
+    /**
+     * Like luaL_loadfile, but uses the cached bytecode if there is any. If
+     * there isn't, the script is parsed and its bytecode is added to the
+     * cache. Failing to write to the cache is not an error.
+     */
+    int load(lua_State* L, const char* path);
+
+    /**
+     * Writes a file to the cache directory such that other processes never see
+     * it partially written. Returns false on failure.
+     */
+    bool write(const char* name, const std::string& data) const;
+
+    /**
+     * Returns the path of every script that was loaded so far. A script may be
+     * listed more than once.
+     */
+    std::vector<std::string> loaded() const;
+};
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * SHA-256 hashing.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Computes a SHA-256 digest incrementally.
+ */
+class Sha256 {
+public:
+    static const size_t digestSize = 32;
+
+    Sha256();
+
+    /**
+     * Adds data to the digest.
+     */
+    void update(const void* data, size_t length);
+
+    /**
+     * Finishes the digest and writes it out. The object should not be used
+     * afterwards.
+     */
+    void finish(uint8_t digest[digestSize]);
+
+    /**
+     * Computes the digest of the data in one go.
+     */
+    static void hash(const void* data, size_t length,
+            uint8_t digest[digestSize]);
+
+private:
+    void transform(const uint8_t* block);
+
+    uint32_t _state[8];
+    uint64_t _length;
+
+    // Data waiting for a full block.
+    uint8_t _buffer[64];
+    size_t _buffered;
+};
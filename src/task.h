@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Move-only function wrapper for thread pool tasks.
+ */
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * A callable object that takes no arguments and returns nothing. Unlike
+ * std::function, this is move-only (so it can hold move-only objects such as
+ * std::packaged_task) and callables of up to `inlineSize` bytes are stored
+ * inline instead of on the heap.
+ */
+class Task {
+public:
+    static const size_t inlineSize = 48;
+
+    Task() : _ops(nullptr) {}
+
+    template<class F, class = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) {
+        typedef typename std::decay<F>::type Fn;
+        construct<Fn>(std::forward<F>(f), IsInline<Fn>());
+    }
+
+    Task(Task&& other) : _ops(other._ops) {
+        if (_ops) {
+            _ops->move(&_storage, &other._storage);
+            other._ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) {
+        if (this != &other) {
+            reset();
+
+            _ops = other._ops;
+
+            if (_ops) {
+                _ops->move(&_storage, &other._storage);
+                other._ops = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    void operator()() {
+        _ops->invoke(&_storage);
+    }
+
+    explicit operator bool() const {
+        return _ops != nullptr;
+    }
+
+private:
+    // Type-erased operations on the stored callable.
+    struct Ops {
+        void (*invoke)(void* storage);
+
+        // Moves the callable from src to dst and destroys the one in src.
+        void (*move)(void* dst, void* src);
+
+        void (*destroy)(void* storage);
+    };
+
+    template<class Fn>
+    struct IsInline : std::integral_constant<bool,
+        sizeof(Fn) <= inlineSize &&
+        alignof(Fn) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<Fn>::value> {};
+
+    // Operations for a callable stored in the buffer.
+    template<class Fn>
+    struct InlineOps {
+        static void invoke(void* s) {
+            (*static_cast<Fn*>(s))();
+        }
+
+        static void move(void* dst, void* src) {
+            Fn* f = static_cast<Fn*>(src);
+            new (dst) Fn(std::move(*f));
+            f->~Fn();
+        }
+
+        static void destroy(void* s) {
+            static_cast<Fn*>(s)->~Fn();
+        }
+
+        static const Ops ops;
+    };
+
+    // Operations for a callable stored on the heap. The buffer holds a pointer
+    // to it.
+    template<class Fn>
+    struct HeapOps {
+        static Fn*& get(void* s) {
+            return *static_cast<Fn**>(s);
+        }
+
+        static void invoke(void* s) {
+            (*get(s))();
+        }
+
+        static void move(void* dst, void* src) {
+            new (dst) Fn*(get(src));
+        }
+
+        static void destroy(void* s) {
+            delete get(s);
+        }
+
+        static const Ops ops;
+    };
+
+    template<class Fn, class F>
+    void construct(F&& f, std::true_type) {
+        new (&_storage) Fn(std::forward<F>(f));
+        _ops = &InlineOps<Fn>::ops;
+    }
+
+    template<class Fn, class F>
+    void construct(F&& f, std::false_type) {
+        new (&_storage) Fn*(new Fn(std::forward<F>(f)));
+        _ops = &HeapOps<Fn>::ops;
+    }
+
+    void reset() {
+        if (_ops) {
+            _ops->destroy(&_storage);
+            _ops = nullptr;
+        }
+    }
+
+    const Ops* _ops;
+
+    typename std::aligned_storage<inlineSize,
+             alignof(std::max_align_t)>::type _storage;
+};
+
+template<class Fn>
+const Task::Ops Task::InlineOps<Fn>::ops = {
+    &InlineOps<Fn>::invoke, &InlineOps<Fn>::move, &InlineOps<Fn>::destroy
+};
+
+template<class Fn>
+const Task::Ops Task::HeapOps<Fn>::ops = {
+    &HeapOps<Fn>::invoke, &HeapOps<Fn>::move, &HeapOps<Fn>::destroy
+};
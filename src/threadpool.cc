@@ -22,79 +22,371 @@
 #include "threadpool.h"
 
 #include <algorithm>
+#include <new>
+
+namespace {
+
+// The pool and deque index of the current thread. Set for workers and for an
+// outside thread while it helps with a task group.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentDeque = 0;
+
+// State for picking random victims to steal from.
+thread_local uint32_t stealSeed = 0;
+
+// Number of times an idle worker looks for work before going to sleep.
+const int spinCount = 64;
+
+// Number of task nodes to allocate at once.
+const size_t nodeBlockSize = 256;
+
+// Maximum number of nodes in a worker's free list.
+const size_t freeListSize = 128;
+
+uint32_t xorshift(uint32_t& state) {
+    if (state == 0)
+        state = (uint32_t)std::hash<std::thread::id>()(
+                std::this_thread::get_id()) | 1;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+}
 
 ThreadPool::ThreadPool(size_t threads) :
-    _threads(std::max((size_t)1, threads)), _tasksLeft(0), _stop(false)
+    _started(0), _maxThreads(std::max((size_t)1, threads)), _sharedSize(0),
+    _tasksLeft(0), _sleeping(0), _epoch(0), _free(nullptr), _stop(false)
 {
-    // Initialize worker threads.
-    for (auto& t: _threads)
-        t = std::thread([this] { worker(); });
+    // The extra deque is for an outside thread waiting on a task group.
+    for (size_t i = 0; i < _maxThreads + 1; ++i)
+        _workers.emplace_back(new Worker());
+
+    _threads.reserve(_maxThreads);
 }
 
 ThreadPool::~ThreadPool() {
-    _stop = true;
+    {
+        // No more threads can be started after this.
+        std::lock_guard<std::mutex> lock(_startMutex);
+        _stop = true;
+    }
 
     // Wake up all threads waiting for a new task.
-    _taskAvailableCond.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        ++_epoch;
+    }
+    _sleepCond.notify_all();
 
     for (auto& x : _threads) {
         if (x.joinable())
             x.join();
     }
+
+    // Destroy any tasks that never ran. The nodes themselves are freed along
+    // with their blocks.
+    for (auto& w : _workers) {
+        while (Node* node = w->deque.take())
+            node->get().~Task();
+    }
+
+    for (Node* node : _shared)
+        node->get().~Task();
 }
 
-void ThreadPool::enqueueTask(std::function<void()> task) {
-    {
-        std::lock_guard<std::mutex> lock(_queueMutex);
-        _queue.emplace(task);
+ThreadPool::Node* ThreadPool::allocSharedNode() {
+    if (!_free) {
+        Node* block = new Node[nodeBlockSize];
+        _blocks.emplace_back(block);
+
+        for (size_t i = 0; i < nodeBlockSize; ++i) {
+            block[i].next = _free;
+            _free = &block[i];
+        }
     }
 
-    {
-        std::lock_guard<std::mutex> lock(_tasksLeftMutex);
-        ++_tasksLeft;
+    Node* node = _free;
+    _free = node->next;
+    return node;
+}
+
+ThreadPool::Node* ThreadPool::allocNode() {
+    if (currentPool != this) {
+        std::lock_guard<std::mutex> lock(_freeMutex);
+        return allocSharedNode();
     }
 
-    _taskAvailableCond.notify_one();
+    Worker& w = *_workers[currentDeque];
+
+    if (!w.free) {
+        // Refill the local free list in one go.
+        std::lock_guard<std::mutex> lock(_freeMutex);
+
+        for (size_t i = 0; i < freeListSize / 2; ++i) {
+            Node* node = allocSharedNode();
+            node->next = w.free;
+            w.free = node;
+        }
+
+        w.freeCount = freeListSize / 2;
+    }
+
+    Node* node = w.free;
+    w.free = node->next;
+    --w.freeCount;
+    return node;
 }
 
-void ThreadPool::waitAll() {
-    std::unique_lock<std::mutex> lock(_tasksLeftMutex);
-    if (_tasksLeft > 0) {
-        _waitCond.wait(lock, [this] {
-                return _tasksLeft == 0;
-                });
+void ThreadPool::freeNode(Node* node) {
+    if (currentPool != this) {
+        std::lock_guard<std::mutex> lock(_freeMutex);
+        node->next = _free;
+        _free = node;
+        return;
+    }
+
+    Worker& w = *_workers[currentDeque];
+
+    node->next = w.free;
+    w.free = node;
+
+    // Threads that mostly run tasks don't need many nodes. Give half of them
+    // back to threads that mostly enqueue tasks.
+    if (++w.freeCount >= freeListSize) {
+        std::lock_guard<std::mutex> lock(_freeMutex);
+
+        for (size_t i = 0; i < freeListSize / 2; ++i) {
+            Node* n = w.free;
+            w.free = n->next;
+            n->next = _free;
+            _free = n;
+        }
+
+        w.freeCount -= freeListSize / 2;
     }
 }
 
-void ThreadPool::worker() {
-    while (true)
+void ThreadPool::enqueueTask(Task task) {
+    submit(std::move(task), nullptr);
+}
+
+void ThreadPool::submit(Task task, TaskGroup* group) {
+    Node* node = allocNode();
+    new (&node->task) Task(std::move(task));
+    node->group = group;
+
+    _tasksLeft.fetch_add(1, std::memory_order_relaxed);
+
+    if (currentPool == this) {
+        _workers[currentDeque]->deque.push(node);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(_sharedMutex);
+        _shared.push_back(node);
+        _sharedSize.store(_shared.size(), std::memory_order_relaxed);
+    }
+
+    notify();
+}
+
+void ThreadPool::notify() {
+    // Pairs with the fence in sleep(). Either the sleeping thread sees the new
+    // task or we see the sleeping thread. This makes waking up free when all
+    // workers are busy.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (_sleeping.load(std::memory_order_relaxed) == 0) {
+        grow();
+        return;
+    }
+
     {
-        std::function<void()> task;
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        ++_epoch;
+    }
 
-        {
-            std::unique_lock<std::mutex> lock(_queueMutex);
+    _sleepCond.notify_one();
+}
 
-            if (_stop) return;
+void ThreadPool::grow() {
+    const size_t started = _started.load(std::memory_order_relaxed);
 
-            // Wait for a task if we don't have any.
-            _taskAvailableCond.wait(lock, [this] {
-                    return _queue.size() > 0 || _stop;
-                    });
+    if (started == _maxThreads ||
+        _tasksLeft.load(std::memory_order_relaxed) <= started)
+        return;
 
-            if (_stop) return;
+    std::lock_guard<std::mutex> lock(_startMutex);
 
-            // Get task from the queue
-            task = std::move(_queue.front());
-            _queue.pop();
+    // Another thread may have been started in the meantime.
+    const size_t i = _threads.size();
+    if (_stop || i == _maxThreads)
+        return;
+
+    _threads.emplace_back([this, i] { worker(i); });
+    _started.store(i + 1, std::memory_order_relaxed);
+}
+
+void ThreadPool::waitAll() {
+    std::unique_lock<std::mutex> lock(_waitMutex);
+    _waitCond.wait(lock, [this] {
+            return _tasksLeft.load(std::memory_order_acquire) == 0;
+            });
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    auto done = [&group] {
+        return group._pending.load(std::memory_order_acquire) == 0;
+    };
+
+    // An outside thread borrows the extra deque (if nobody else has it) such
+    // that the tasks it enqueues while helping don't go through the shared
+    // queue.
+    const ThreadPool* prevPool = currentPool;
+    const size_t prevDeque = currentDeque;
+
+    std::unique_lock<std::mutex> external(_externalMutex, std::defer_lock);
+
+    if (currentPool != this && external.try_lock()) {
+        currentPool = this;
+        currentDeque = _maxThreads;
+    }
+
+    while (!done()) {
+        Node* node = nullptr;
+
+        for (int i = 0; i < spinCount && !node && !done(); ++i) {
+            node = findTask();
+            if (!node)
+                std::this_thread::yield();
         }
 
-        task();
+        if (!node && !done())
+            node = sleep(done);
+
+        if (node)
+            run(node);
+    }
+
+    currentPool = prevPool;
+    currentDeque = prevDeque;
+}
+
+ThreadPool::Node* ThreadPool::takeShared() {
+    if (_sharedSize.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(_sharedMutex);
+
+    if (_shared.empty())
+        return nullptr;
+
+    Node* node = _shared.front();
+    _shared.pop_front();
+    _sharedSize.store(_shared.size(), std::memory_order_relaxed);
+    return node;
+}
+
+ThreadPool::Node* ThreadPool::findTask() {
+    const bool own = currentPool == this;
+
+    if (own) {
+        if (Node* node = _workers[currentDeque]->deque.take())
+            return node;
+    }
+
+    if (Node* node = takeShared())
+        return node;
+
+    // Start at a random victim so that thieves spread out.
+    const size_t n = _workers.size();
+    const size_t start = xorshift(stealSeed) % n;
+
+    for (size_t i = 0; i < n; ++i) {
+        const size_t victim = (start + i) % n;
+        if (own && victim == currentDeque)
+            continue;
 
+        if (Node* node = _workers[victim]->deque.steal())
+            return node;
+    }
+
+    return nullptr;
+}
+
+void ThreadPool::run(Node* node) {
+    TaskGroup* group = node->group;
+
+    Task& task = node->get();
+    task();
+    task.~Task();
+
+    freeNode(node);
+
+    // Note that the group may be destroyed as soon as its count reaches zero.
+    if (group && group->_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Wake up the thread waiting on the group.
         {
-            std::lock_guard<std::mutex> lock(_tasksLeftMutex);
-            --_tasksLeft;
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            ++_epoch;
         }
+        _sleepCond.notify_all();
+    }
+
+    if (_tasksLeft.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // That was the last task. Note that the lock is needed such that the
+        // waiting thread can't miss the notification.
+        std::lock_guard<std::mutex> lock(_waitMutex);
+        _waitCond.notify_all();
+    }
+}
+
+template<class Pred>
+ThreadPool::Node* ThreadPool::sleep(Pred done) {
+    // The epoch is read first such that a wake up between here and the wait is
+    // not lost.
+    const size_t epoch = _epoch.load(std::memory_order_acquire);
+
+    _sleeping.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    Node* node = findTask();
+
+    if (!node) {
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleepCond.wait(lock, [&] {
+                return _epoch.load(std::memory_order_relaxed) != epoch ||
+                       done();
+                });
+    }
+
+    _sleeping.fetch_sub(1, std::memory_order_relaxed);
+
+    return node;
+}
+
+void ThreadPool::worker(size_t index) {
+    currentPool = this;
+    currentDeque = index;
+
+    auto stopped = [this] { return (bool)_stop; };
+
+    while (!_stop)
+    {
+        Node* node = nullptr;
+
+        for (int i = 0; i < spinCount && !node && !_stop; ++i) {
+            node = findTask();
+            if (!node)
+                std::this_thread::yield();
+        }
+
+        if (!node)
+            node = sleep(stopped);
 
-        _waitCond.notify_one();
+        if (node)
+            run(node);
     }
 }
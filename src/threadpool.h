@@ -30,13 +30,40 @@
 #include <functional>
 
 #include <vector>
-#include <queue>
+#include <deque>
+#include <memory>
+
+#include "workdeque.h"
+#include "task.h"
+
+class TaskGroup;
 
 /**
- * A thread pool.
+ * A work stealing thread pool.
+ *
+ * Each worker has its own deque. Tasks enqueued by a worker go onto its own
+ * deque without taking a lock and are run newest first, which keeps related
+ * work (e.g., the subdirectories of a directory) on the same core. Idle
+ * workers steal the oldest tasks from other workers. Tasks enqueued from
+ * outside of the pool go onto a shared queue.
+ *
+ * Use a TaskGroup to wait for a specific set of tasks.
+ *
+ * Enqueueing a task normally doesn't allocate. Tasks are stored in nodes that
+ * are recycled through per-worker free lists, and small callables are stored
+ * inline in the task.
+ *
+ * Threads are started lazily. No threads exist until the first task is
+ * enqueued, and another thread is only started when there are more unfinished
+ * tasks than threads and none of the existing threads are idle. Thus, scripts
+ * that never glob don't pay for creating a thread per core.
  */
 class ThreadPool {
 public:
+    /**
+     * Creates a pool of up to `threads` worker threads. None of them are
+     * started until they are needed.
+     */
     explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
 
     // It should never be possible to copy a thread pool.
@@ -53,9 +80,11 @@ public:
     ~ThreadPool();
 
     /**
-     * Adds a new task to the end of the queue.
+     * Adds a new task. If called from a worker of this pool, the task is
+     * pushed onto that worker's deque. Otherwise, it is added to the end of
+     * the shared queue.
      */
-    void enqueueTask(std::function<void()> task);
+    void enqueueTask(Task task);
 
     /**
      * Wraps a task in a future and adds it to the end of the queue. This is
@@ -66,37 +95,231 @@ public:
     enqueue(F&& f, Args&&... args) {
         using packaged_task = std::packaged_task<typename std::result_of<F(Args...)>::type()>;
 
-        std::shared_ptr<packaged_task> task(new packaged_task(
+        // Since tasks are move-only, the packaged task can be moved right into
+        // it instead of being shared.
+        packaged_task task(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-            ));
+            );
 
-        auto res = task->get_future();
+        auto res = task.get_future();
 
-        enqueueTask([task](){ (*task)(); });
+        enqueueTask(std::move(task));
 
         return res;
     }
 
     /**
      * Blocks until all tasks in the queue have completed. This should be called
-     * before destruction to ensure all work has been finished.
+     * before destruction to ensure all work has been finished. Note that this
+     * also waits for tasks that have nothing to do with the caller.
      */
     void waitAll();
 
+    /**
+     * Maximum number of worker threads.
+     */
+    size_t maxThreads() const {
+        return _maxThreads;
+    }
+
+    /**
+     * Number of worker threads that have been started so far.
+     */
+    size_t threadCount() const {
+        return _started.load(std::memory_order_relaxed);
+    }
+
 private:
+    friend class TaskGroup;
+
+    /**
+     * A queued task. Nodes are allocated in blocks and recycled.
+     */
+    struct Node {
+        // The task is only constructed while the node is in use.
+        typename std::aligned_storage<sizeof(Task), alignof(Task)>::type task;
+
+        // Group the task belongs to, if any.
+        TaskGroup* group;
+
+        // Next node in a free list.
+        Node* next;
+
+        Task& get() {
+            return *reinterpret_cast<Task*>(&task);
+        }
+    };
+
     /**
-     * Takes the next task in the queue and runs it. Notify the main thread that a
-     * task has completed. This is the main loop for each thread.
+     * Per-deque state. Only the thread that owns the deque may push and take
+     * from it or touch the free list.
      */
-    void worker();
+    struct Worker {
+        WorkDeque<Node> deque;
+
+        // Nodes that are ready to be reused.
+        Node* free;
+        size_t freeCount;
 
+        Worker() : free(nullptr), freeCount(0) {}
+    };
+
+    /**
+     * Gets an unused node. Nodes come from the current thread's free list if
+     * it has one. Otherwise, from the shared free list.
+     */
+    Node* allocNode();
+
+    /**
+     * Returns a node after its task has been destroyed.
+     */
+    void freeNode(Node* node);
+
+    /**
+     * Gets a node from the shared free list, allocating a new block of them
+     * if it is empty. The free mutex must be held.
+     */
+    Node* allocSharedNode();
+
+    /**
+     * Adds a task that optionally belongs to a group.
+     */
+    void submit(Task task, TaskGroup* group);
+
+    /**
+     * Runs tasks until the group is finished. See TaskGroup::wait.
+     */
+    void wait(TaskGroup& group);
+
+    /**
+     * The main loop for each thread. Runs tasks until the pool is destroyed.
+     */
+    void worker(size_t index);
+
+    /**
+     * Finds a task to run. The deque of the current thread is checked first,
+     * then the shared queue, then the other deques. Returns null if no task
+     * was found.
+     */
+    Node* findTask();
+
+    /**
+     * Takes a task from the shared queue. Returns null if it is empty.
+     */
+    Node* takeShared();
+
+    /**
+     * Runs a task and frees its node.
+     */
+    void run(Node* node);
+
+    /**
+     * Wakes a sleeping worker, if any, after a task was added. If no worker is
+     * sleeping, another thread may be started instead.
+     */
+    void notify();
+
+    /**
+     * Starts another worker thread if there are more unfinished tasks than
+     * threads and the maximum hasn't been reached yet.
+     */
+    void grow();
+
+    /**
+     * Sleeps until a task might be available or the predicate is true. Returns
+     * a task if one was found right before going to sleep.
+     */
+    template<class Pred>
+    Node* sleep(Pred done);
+
+    // One deque per worker thread, plus one for a thread outside of the pool
+    // that is waiting on a task group. Deques exist for threads that haven't
+    // been started yet such that stealing doesn't need to synchronize with
+    // starting threads.
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    // Threads that have been started. Only modified with the start mutex held.
     std::vector<std::thread> _threads;
-    std::queue<std::function<void()>> _queue;
+    std::atomic<size_t> _started;
+    const size_t _maxThreads;
+    std::mutex _startMutex;
 
-    size_t _tasksLeft;
-    std::atomic_bool _stop;
-    std::condition_variable _taskAvailableCond;
+    // Held by the outside thread that currently owns the extra deque.
+    std::mutex _externalMutex;
+
+    // Tasks enqueued from threads outside of the pool.
+    std::deque<Node*> _shared;
+    std::atomic<size_t> _sharedSize;
+    std::mutex _sharedMutex;
+
+    // Number of tasks that have been enqueued but have not yet finished.
+    std::atomic<size_t> _tasksLeft;
     std::condition_variable _waitCond;
-    std::mutex _tasksLeftMutex;
-    std::mutex _queueMutex;
+    std::mutex _waitMutex;
+
+    // Workers with no work sleep on this. The epoch is incremented whenever
+    // sleeping threads are woken up.
+    std::atomic<size_t> _sleeping;
+    std::atomic<size_t> _epoch;
+    std::condition_variable _sleepCond;
+    std::mutex _sleepMutex;
+
+    // Nodes that are not owned by any worker's free list, and all blocks of
+    // nodes that have been allocated.
+    Node* _free;
+    std::vector<std::unique_ptr<Node[]>> _blocks;
+    std::mutex _freeMutex;
+
+    std::atomic_bool _stop;
+};
+
+/**
+ * A set of tasks in a thread pool that can be waited on separately from all
+ * other tasks. Groups are cheap to create and are meant to be used on the
+ * stack, e.g., one per glob.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : _pool(pool), _pending(0) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * Waits for any remaining tasks.
+     */
+    ~TaskGroup() {
+        wait();
+    }
+
+    /**
+     * Adds a task to the group and enqueues it in the thread pool.
+     */
+    void run(Task task) {
+        _pending.fetch_add(1, std::memory_order_relaxed);
+        _pool.submit(std::move(task), this);
+    }
+
+    /**
+     * Blocks until all tasks in the group have completed, including tasks that
+     * were added by other tasks in the group. Instead of sleeping, the calling
+     * thread runs queued tasks (from any group) while it waits. It only sleeps
+     * if there is nothing to do.
+     */
+    void wait() {
+        if (_pending.load(std::memory_order_acquire) != 0)
+            _pool.wait(*this);
+    }
+
+    ThreadPool& pool() {
+        return _pool;
+    }
+
+private:
+    friend class ThreadPool;
+
+    ThreadPool& _pool;
+
+    // Number of tasks that have not yet finished.
+    std::atomic<size_t> _pending;
 };
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * Lock-free work stealing deque.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * A Chase-Lev work stealing deque of pointers. The owning thread pushes and
+ * takes from the bottom (LIFO) while any other thread may steal from the top
+ * (FIFO). None of the operations take a lock.
+ *
+ * This follows "Correct and Efficient Work-Stealing for Weak Memory Models" by
+ * Lê et al. (2013).
+ */
+template<class T>
+class WorkDeque {
+private:
+    /**
+     * Circular buffer of items. The capacity is always a power of two.
+     */
+    struct Array {
+        int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> items;
+
+        explicit Array(int64_t capacity)
+            : mask(capacity - 1), items(new std::atomic<T*>[capacity]) {}
+
+        int64_t capacity() const {
+            return mask + 1;
+        }
+
+        T* get(int64_t i) const {
+            return items[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T* x) {
+            items[i & mask].store(x, std::memory_order_relaxed);
+        }
+    };
+
+    // Index of the next item to steal. Only ever increases.
+    std::atomic<int64_t> _top;
+
+    // Index one past the last item pushed.
+    std::atomic<int64_t> _bottom;
+
+    std::atomic<Array*> _array;
+
+    // All arrays ever allocated. A thief may still be reading from an old array
+    // after it has been replaced, so they are only freed on destruction. Only
+    // the owner touches this.
+    std::vector<std::unique_ptr<Array>> _arrays;
+
+    /**
+     * Doubles the size of the array. Only called by the owner.
+     */
+    Array* grow(Array* a, int64_t bottom, int64_t top) {
+        Array* b = new Array(a->capacity() * 2);
+        _arrays.emplace_back(b);
+
+        for (int64_t i = top; i < bottom; ++i)
+            b->put(i, a->get(i));
+
+        _array.store(b, std::memory_order_release);
+        return b;
+    }
+
+public:
+    explicit WorkDeque(int64_t capacity = 256) : _top(0), _bottom(0) {
+        Array* a = new Array(capacity);
+        _arrays.emplace_back(a);
+        _array.store(a, std::memory_order_relaxed);
+    }
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    /**
+     * Adds an item to the bottom. Only the owner may call this.
+     */
+    void push(T* x) {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_acquire);
+        Array* a = _array.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity() - 1)
+            a = grow(a, b, t);
+
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Removes the item at the bottom, i.e., the one that was most recently
+     * pushed. Returns null if the deque is empty. Only the owner may call this.
+     */
+    T* take() {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = _array.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = _top.load(std::memory_order_relaxed);
+
+        T* x = nullptr;
+
+        if (t <= b) {
+            x = a->get(b);
+
+            if (t == b) {
+                // Last item. Race against thieves for it.
+                if (!_top.compare_exchange_strong(t, t + 1,
+                            std::memory_order_seq_cst,
+                            std::memory_order_relaxed))
+                    x = nullptr;
+
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else {
+            // Empty.
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return x;
+    }
+
+    /**
+     * Removes the item at the top, i.e., the oldest one. Returns null if the
+     * deque is empty or another thread got to the item first. Any thread may
+     * call this.
+     */
+    T* steal() {
+        int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        Array* a = _array.load(std::memory_order_acquire);
+        T* x = a->get(t);
+
+        if (!_top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return x;
+    }
+
+    /**
+     * Returns true if the deque appears to be empty. This is only a hint since
+     * other threads may be changing it.
+     */
+    bool empty() const {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+};
@@ -0,0 +1,328 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * The 64-bit variant of the XXH3 hash function. This follows the reference
+ * implementation by Yann Collet (BSD 2-Clause License), but only for the
+ * default secret and seed.
+ */
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define XXH3_SSE2
+#   include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#   include <intrin.h>
+#endif
+
+#include "xxh3.h"
+
+namespace {
+
+const uint64_t prime32_1 = 0x9E3779B1U;
+const uint64_t prime32_2 = 0x85EBCA77U;
+const uint64_t prime32_3 = 0xC2B2AE3DU;
+
+const uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+const uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+
+const uint64_t primeMx1 = 0x165667919E3779F9ULL;
+const uint64_t primeMx2 = 0x9FB21C651E98DF25ULL;
+
+const size_t stripeLength = 64;
+const size_t secretConsumeRate = 8;
+const size_t accumulators = 8;
+
+const size_t secretSize = 192;
+
+const uint8_t secret[secretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint32_t read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+        ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+inline uint32_t swap32(uint32_t x) {
+    return ((x << 24) & 0xFF000000) | ((x << 8) & 0x00FF0000) |
+        ((x >> 8) & 0x0000FF00) | ((x >> 24) & 0x000000FF);
+}
+
+inline uint64_t swap64(uint64_t x) {
+    return ((uint64_t)swap32((uint32_t)x) << 32) | swap32((uint32_t)(x >> 32));
+}
+
+inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * Multiplies two 64-bit integers and folds the 128-bit product into 64 bits by
+ * xoring its halves.
+ */
+inline uint64_t mulFold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = (unsigned __int128)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    const uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    const uint64_t loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    const uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+    const uint64_t loHi = (a & 0xFFFFFFFF) * (b >> 32);
+    const uint64_t hiHi = (a >> 32) * (b >> 32);
+
+    const uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    const uint64_t high = (hiLo >> 32) + (cross >> 32) + hiHi;
+    const uint64_t low = (cross << 32) | (loLo & 0xFFFFFFFF);
+    return low ^ high;
+#endif
+}
+
+inline uint64_t xxh64Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= prime64_2;
+    h ^= h >> 29;
+    h *= prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= primeMx1;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t rrmxmx(uint64_t h, uint64_t length) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= primeMx2;
+    h ^= (h >> 35) + length;
+    h *= primeMx2;
+    h ^= h >> 28;
+    return h;
+}
+
+inline uint64_t mix16(const uint8_t* p, const uint8_t* s) {
+    return mulFold64(read64(p) ^ read64(s), read64(p + 8) ^ read64(s + 8));
+}
+
+uint64_t hash0to16(const uint8_t* p, size_t length) {
+    if (length > 8) {
+        const uint64_t lo = read64(p) ^ (read64(secret + 24) ^ read64(secret + 32));
+        const uint64_t hi = read64(p + length - 8) ^
+            (read64(secret + 40) ^ read64(secret + 48));
+
+        return avalanche(length + swap64(lo) + hi + mulFold64(lo, hi));
+    }
+
+    if (length >= 4) {
+        const uint64_t input = read32(p + length - 4) +
+            ((uint64_t)read32(p) << 32);
+
+        return rrmxmx(input ^ (read64(secret + 8) ^ read64(secret + 16)),
+                length);
+    }
+
+    if (length > 0) {
+        const uint32_t combined = ((uint32_t)p[0] << 16) |
+            ((uint32_t)p[length >> 1] << 24) |
+            (uint32_t)p[length - 1] | ((uint32_t)length << 8);
+
+        return xxh64Avalanche(combined ^ (uint64_t)(read32(secret) ^
+                    read32(secret + 4)));
+    }
+
+    return xxh64Avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+uint64_t hash17to128(const uint8_t* p, size_t length) {
+    uint64_t acc = length * prime64_1;
+
+    if (length > 32) {
+        if (length > 64) {
+            if (length > 96) {
+                acc += mix16(p + 48, secret + 96);
+                acc += mix16(p + length - 64, secret + 112);
+            }
+
+            acc += mix16(p + 32, secret + 64);
+            acc += mix16(p + length - 48, secret + 80);
+        }
+
+        acc += mix16(p + 16, secret + 32);
+        acc += mix16(p + length - 32, secret + 48);
+    }
+
+    acc += mix16(p, secret);
+    acc += mix16(p + length - 16, secret + 16);
+
+    return avalanche(acc);
+}
+
+uint64_t hash129to240(const uint8_t* p, size_t length) {
+    const size_t rounds = length / 16;
+
+    uint64_t acc = length * prime64_1;
+
+    for (size_t i = 0; i < 8; ++i)
+        acc += mix16(p + 16 * i, secret + 16 * i);
+
+    acc = avalanche(acc);
+
+    for (size_t i = 8; i < rounds; ++i)
+        acc += mix16(p + 16 * i, secret + 16 * (i - 8) + 3);
+
+    acc += mix16(p + length - 16, secret + 136 - 17);
+
+    return avalanche(acc);
+}
+
+/**
+ * Mixes one stripe of input into the accumulators.
+ */
+inline void accumulate512(uint64_t* acc, const uint8_t* p, const uint8_t* s) {
+#ifdef XXH3_SSE2
+    __m128i* a = (__m128i*)acc;
+
+    for (size_t i = 0; i < accumulators / 2; ++i) {
+        const __m128i data = _mm_loadu_si128((const __m128i*)p + i);
+        const __m128i key = _mm_xor_si128(data,
+                _mm_loadu_si128((const __m128i*)s + i));
+
+        // Multiply the low and high halves of each 64-bit lane.
+        const __m128i product = _mm_mul_epu32(key,
+                _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+
+        // Each lane also gets the input of its neighbor.
+        const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+        a[i] = _mm_add_epi64(product, _mm_add_epi64(a[i], swapped));
+    }
+#else
+    for (size_t i = 0; i < accumulators; ++i) {
+        const uint64_t data = read64(p + 8 * i);
+        const uint64_t key = data ^ read64(s + 8 * i);
+
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+#endif
+}
+
+inline void scramble(uint64_t* acc, const uint8_t* s) {
+#ifdef XXH3_SSE2
+    __m128i* a = (__m128i*)acc;
+    const __m128i prime = _mm_set1_epi32((int)prime32_1);
+
+    for (size_t i = 0; i < accumulators / 2; ++i) {
+        __m128i x = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+        x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)s + i));
+
+        // There is no 64-bit multiply, so do it in two halves.
+        const __m128i lo = _mm_mul_epu32(x, prime);
+        const __m128i hi = _mm_mul_epu32(
+                _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+        a[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    }
+#else
+    for (size_t i = 0; i < accumulators; ++i) {
+        uint64_t x = acc[i];
+        x ^= x >> 47;
+        x ^= read64(s + 8 * i);
+        x *= prime32_1;
+        acc[i] = x;
+    }
+#endif
+}
+
+uint64_t hashLong(const uint8_t* p, size_t length) {
+    // Aligned for SSE2.
+    struct alignas(16) Accumulators {
+        uint64_t v[accumulators];
+    };
+
+    Accumulators acc = {{
+        prime32_3, prime64_1, prime64_2, prime64_3,
+        prime64_4, prime32_2, prime64_5, prime32_1,
+    }};
+
+    const size_t stripesPerBlock = (secretSize - stripeLength) / secretConsumeRate;
+    const size_t blockLength = stripeLength * stripesPerBlock;
+    const size_t blocks = (length - 1) / blockLength;
+
+    for (size_t n = 0; n < blocks; ++n) {
+        const uint8_t* block = p + n * blockLength;
+
+        for (size_t i = 0; i < stripesPerBlock; ++i)
+            accumulate512(acc.v, block + i * stripeLength,
+                    secret + i * secretConsumeRate);
+
+        scramble(acc.v, secret + secretSize - stripeLength);
+    }
+
+    // The last partial block
+    const uint8_t* block = p + blocks * blockLength;
+    const size_t stripes = ((length - 1) - blocks * blockLength) / stripeLength;
+
+    for (size_t i = 0; i < stripes; ++i)
+        accumulate512(acc.v, block + i * stripeLength,
+                secret + i * secretConsumeRate);
+
+    // The last stripe, which may overlap the previous one.
+    accumulate512(acc.v, p + length - stripeLength,
+            secret + secretSize - stripeLength - 7);
+
+    // Merge the accumulators.
+    uint64_t result = length * prime64_1;
+
+    for (size_t i = 0; i < accumulators / 2; ++i)
+        result += mulFold64(acc.v[2 * i] ^ read64(secret + 11 + 16 * i),
+                acc.v[2 * i + 1] ^ read64(secret + 11 + 16 * i + 8));
+
+    return avalanche(result);
+}
+
+}
+
+uint64_t xxh3(const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+
+    if (length <= 16)
+        return hash0to16(p, length);
+
+    if (length <= 128)
+        return hash17to128(p, length);
+
+    if (length <= 240)
+        return hash129to240(p, length);
+
+    return hashLong(p, length);
+}
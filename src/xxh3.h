@@ -0,0 +1,19 @@
+/**
+ * Copyright (c) Jason White
+ *
+ * MIT License
+ *
+ * Description:
+ * The 64-bit variant of the XXH3 hash function.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Returns the XXH3 64-bit hash of the data with the default secret and a seed
+ * of 0. This gives the same results as XXH3_64bits() from the reference
+ * implementation. It is fast, but it is not a cryptographic hash.
+ */
+uint64_t xxh3(const void* data, size_t length);
@@ -6,6 +6,17 @@
 # Tests additions to the standard Lua library.
 
 runtest std/globals.sh
+runtest std/table.sh
 runtest std/posixpath.sh
 runtest std/winpath.sh
 runtest std/glob.sh
+runtest std/globindex.sh
+runtest std/import.sh
+runtest std/expand.sh
+runtest std/cache.sh
+runtest std/pathtable.sh
+runtest std/argv.sh
+runtest std/fs.sh
+runtest std/json.sh
+runtest std/hash.sh
+runtest std/noop.sh
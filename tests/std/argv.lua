@@ -0,0 +1,105 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests argv lists.
+]]
+
+local function equal(t1, t2)
+    if #t1 ~= #t2 then
+        return false
+    end
+
+    for i,v in ipairs(t1) do
+        if v ~= t2[i] then
+            return false
+        end
+    end
+
+    return true
+end
+
+local flags = argv.join("cc", {"-Wall", "-O2"})
+assert(#flags == 3)
+assert(equal(flags, {"cc", "-Wall", "-O2"}))
+assert(equal(flags:totable(), {"cc", "-Wall", "-O2"}))
+assert(equal(argv.totable(flags), {"cc", "-Wall", "-O2"}))
+assert(flags[0] == nil and flags[4] == nil)
+
+-- Nested lists are shared instead of copied.
+local a = argv.join(flags, "-c", "foo.c", {"-o", "foo.o"})
+local b = argv.join(flags, "-c", "bar.c", {"-o", "bar.o"})
+assert(equal(a, {"cc", "-Wall", "-O2", "-c", "foo.c", "-o", "foo.o"}))
+assert(equal(b, {"cc", "-Wall", "-O2", "-c", "bar.c", "-o", "bar.o"}))
+assert(a[2] == "-Wall" and a[5] == "foo.c")
+
+local n = 0
+for i,v in ipairs(a) do
+    n = n + 1
+    assert(v == a[i])
+end
+assert(n == #a)
+
+-- Like table.join, this stops at the first nil and converts numbers.
+assert(#argv.join() == 0)
+assert(equal(argv.join("a", nil, "b"), {"a"}))
+assert(equal(argv.join(1, {2}), {"1", "2"}))
+assert(not pcall(argv.join, {true}))
+
+-- Lists built up one element at a time stay correct.
+local long = argv.join()
+for i = 1, 100 do
+    long = argv.join(long, tostring(i))
+end
+assert(#long == 100)
+for i = 1, 100 do
+    assert(long[i] == tostring(i))
+end
+
+-- Building a long list one element at a time and iterating over it take
+-- about linear time. Both used to be quadratic and took seconds.
+local start = os.clock()
+long = argv.join()
+for i = 1, 10000 do
+    long = argv.join(long, tostring(i))
+end
+assert(os.clock() - start < 1, "joining is too slow")
+
+start = os.clock()
+n = 0
+for i, v in ipairs(long) do
+    n = n + 1
+    assert(v == tostring(i))
+end
+assert(n == 10000)
+assert(os.clock() - start < 1, "iterating is too slow")
+assert(long[1] == "1" and long[5000] == "5000" and long[10000] == "10000")
+assert(long[0] == nil and long[10001] == nil)
+
+-- Path handles are elements.
+local p = path.intern("x/./y")
+assert(argv.join(p)[1] == p)
+
+-- The table library flattens argv lists.
+assert(equal(table.join(flags, "x"), {"cc", "-Wall", "-O2", "x"}))
+assert(equal(table.append({"y"}, flags), {"y", "cc", "-Wall", "-O2"}))
+
+rule {
+    inputs  = argv.join("foo.c", p),
+    task    = {argv.join(flags, "-c", p)},
+    outputs = {"foo.o"},
+}
+
+require("rules").expand_compile {
+    args    = flags,
+    sources = {"bar.c"},
+    objects = {"bar.o"},
+}
+
+-- Rule modules don't use the global, which scripts are free to reuse.
+argv = {"not", "the", "module"}
+
+require("rules.cc").binary {
+    name = "prog",
+    srcs = {"main.c"},
+}
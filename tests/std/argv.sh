@@ -0,0 +1,18 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+output=$(mktemp)
+
+teardown() {
+    rm -f -- "$output"
+}
+
+trap teardown 0
+
+button-lua argv.lua -o "$output"
+
+grep -q '"inputs": \["foo.c", "x/y"\]' "$output"
+grep -q '"task": \[\["cc", "-Wall", "-O2", "-c", "x/y"\]\]' "$output"
+grep -q '"task": \[\["cc", "-Wall", "-O2", "-c", "bar.c", "-o", "bar.o"\]\]' "$output"
+grep -q '"display": "ld prog"' "$output"
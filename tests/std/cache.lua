@@ -0,0 +1,15 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Imports build scripts for testing the bytecode cache.
+]]
+
+local mode = ...
+
+if mode == "error" then
+    import "error/BUILD.lua"
+else
+    import "a/BUILD.lua"
+    import_all {"b/BUILD.lua", "c/BUILD.lua"}
+end
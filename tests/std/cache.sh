@@ -0,0 +1,71 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+# Cleanup on exit
+trap teardown 0
+
+cp -- cache.lua "$tempdir"
+
+cd $tempdir
+
+script=$(pwd)/cache.lua
+
+for d in a b c; do
+    mkdir -- "$d"
+    cat > "$d/BUILD.lua" <<END
+#!/usr/bin/env button-lua
+print("$d", 1)
+END
+done
+
+mkdir -- "error"
+printf 'local x = 1\n\nerror("oops")\n' > "error/BUILD.lua"
+
+button-lua $script -o nocache.json > nocache.out
+
+# One entry for each script
+button-lua $script -o cold.json --cache-dir cache > cold.out
+[[ $(ls cache/*.luac | wc -l) -eq 4 ]]
+
+# Unchanged scripts use the cache
+button-lua $script -o warm.json --cache-dir cache > warm.out
+[[ $(ls cache/*.luac | wc -l) -eq 4 ]]
+
+cmp nocache.out cold.out
+cmp nocache.out warm.out
+cmp nocache.json warm.json
+
+# A changed script gets a new entry
+printf 'print("changed")\n' > "b/BUILD.lua"
+button-lua $script -o /dev/null --cache-dir cache > changed.out
+grep -q changed changed.out
+[[ $(ls cache/*.luac | wc -l) -eq 5 ]]
+
+# Corrupt entries are replaced
+for f in cache/*; do
+    printf 'garbage' > "$f"
+done
+button-lua $script -o /dev/null --cache-dir cache > corrupt.out
+cmp changed.out corrupt.out
+
+# Truncated or modified bytecode is never loaded.
+for f in cache/*.luac; do
+    size=$(stat -c %s "$f")
+    printf '\377' | dd of="$f" bs=1 seek=$((size / 2)) conv=notrunc 2> /dev/null
+done
+truncate -s -4 -- cache/*.luac
+button-lua $script -o /dev/null --cache-dir cache > tampered.out
+cmp changed.out tampered.out
+
+# Line numbers in errors are kept
+for i in 1 2; do
+    button-lua $script -o /dev/null --cache-dir cache error > error.out || true
+    grep -q "BUILD.lua:3: oops" error.out
+done
@@ -0,0 +1,93 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests that rules.expand_compile outputs the same rules as the equivalent Lua.
+]]
+
+local rules = require "rules"
+
+local mode = ...
+
+local t = {
+    args      = {"gcc", "-Iinclude", "-DNAME=\"value\""},
+    headers   = {"src/foo.h", "src/bar.h"},
+    sources   = {"src/foo.c", "../src/bar.cc", "baz.c"},
+    objects   = {"obj/foo.c.o", "obj/bar.cc.o", "obj/baz.c.o"},
+    scriptdir = "some/dir",
+    src_deps  = {
+        ["src/foo.c"] = {"gen/foo.inc", "../../../root.h"},
+        ["baz.c"] = {},
+    },
+    display   = "cc ",
+}
+
+if mode == "native" then
+    rules.expand_compile(t)
+
+    -- Without optional fields
+    rules.expand_compile {
+        args    = {"cc"},
+        sources = {"a.c"},
+        objects = {"a.o"},
+    }
+
+    -- Sources and dependencies given as path handles
+    local h = path.intern("h.c")
+    rules.expand_compile {
+        args     = {"cc"},
+        sources  = {h},
+        objects  = {"h.o"},
+        src_deps = {[h] = {"h.inc"}},
+    }
+else
+    for i,src in ipairs(t.sources) do
+        local deps = {}
+        for _,v in ipairs(t.src_deps[src] or {}) do
+            table.insert(deps, path.norm(path.join(t.scriptdir, v)))
+        end
+
+        src = path.norm(path.join(t.scriptdir, src))
+
+        rule {
+            inputs  = table.join(t.headers, {src}, deps),
+            task    = {table.join(t.args, {"-c", src, "-o", t.objects[i]})},
+            outputs = {t.objects[i]},
+            display = t.display .. src,
+        }
+    end
+
+    rule {
+        inputs  = {"a.c"},
+        task    = {{"cc", "-c", "a.c", "-o", "a.o"}},
+        outputs = {"a.o"},
+    }
+
+    rule {
+        inputs  = {"h.c", "h.inc"},
+        task    = {{"cc", "-c", "h.c", "-o", "h.o"}},
+        outputs = {"h.o"},
+    }
+end
+
+-- Mismatched sources and objects
+assert(not pcall(rules.expand_compile, {args = {}, sources = {"a.c"}, objects = {}}))
+
+-- Malformed tables
+local function fails(t, msg)
+    local ok, err = pcall(rules.expand_compile, t)
+    assert(not ok)
+    assert(string.find(err, msg, 1, true), err)
+end
+
+fails({sources = {"a.c"}, objects = {"a.o"}}, "missing field 'args'")
+fails({args = {"cc", {}}, sources = {"a.c"}, objects = {"a.o"}},
+    "element 2 of field 'args'")
+fails({args = {"cc"}, sources = "a.c", objects = {"a.o"}},
+    "field 'sources' (table expected")
+fails({args = {"cc"}, sources = {"a.c"}, objects = {"a.o"}, display = {}},
+    "field 'display' (string expected")
+fails({args = {"cc"}, sources = {"a.c"}, objects = {"a.o"}, src_deps = 1},
+    "field 'src_deps' (table expected")
+fails({args = {"cc"}, sources = {"a.c"}, objects = {"a.o"},
+    src_deps = {["a.c"] = {true}}}, "element 1 of field 'src_deps'")
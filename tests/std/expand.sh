@@ -0,0 +1,17 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+# Cleanup on exit
+trap teardown 0
+
+button-lua expand.lua -o "$tempdir/native.json" native
+button-lua expand.lua -o "$tempdir/lua.json" lua
+
+cmp "$tempdir/native.json" "$tempdir/lua.json"
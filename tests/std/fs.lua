@@ -0,0 +1,63 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests the fs module. The directory structure is created by fs.sh.
+]]
+
+assert(fs.exists("a"))
+assert(fs.exists("a/foo.c"))
+assert(fs.exists("./a/../a/foo.c"))
+assert(fs.exists(path.intern("a/foo.c")))
+assert(not fs.exists("a/missing.c"))
+assert(not fs.exists("missing/foo.c"))
+assert(fs.exists("."))
+assert(fs.exists(".."))
+assert(fs.exists("/"))
+
+assert(fs.isdir("a"))
+assert(fs.isdir("."))
+assert(not fs.isdir("a/foo.c"))
+assert(not fs.isdir("missing"))
+
+local names = fs.list("a")
+assert(#names == 3)
+assert(names[1] == "bar.c" and names[2] == "foo.c" and names[3] == "sub")
+assert(#fs.list("missing") == 0)
+
+-- Reads
+assert(fs.read("a/foo.c") == "hello")
+assert(fs.read("a/empty") == nil)
+assert(fs.read("a/bar.c") == "")
+
+local contents, err = fs.read("a/missing.c")
+assert(contents == nil and err == "cannot read 'a/missing.c'")
+
+local big = fs.read("b/big")
+assert(#big == 100000 and big == string.rep("x", 100000))
+
+-- Directories can't be read.
+assert(fs.read("a/sub") == nil)
+
+-- Batched reads keep the order and mark failures with false.
+local files = {}
+for i = 1, 100 do
+    files[i] = "a/sub/" .. i
+end
+files[101] = "a/missing.c"
+
+local t = fs.read(files)
+assert(#t == 101)
+for i = 1, 100 do
+    assert(t[i] == tostring(i))
+end
+assert(t[101] == false)
+
+-- Prefetched reads
+fs.prefetch(files)
+fs.prefetch("a/foo.c")
+fs.prefetch({"b/big"})
+assert(fs.read({"b/big"})[1] == big)
+assert(fs.read("a/sub/42") == "42")
+assert(fs.read("a/foo.c") == "hello")
+assert(fs.read("a/foo.c") == "hello")
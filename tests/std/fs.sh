@@ -0,0 +1,40 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+trap teardown 0
+
+script=$(pwd)/fs.lua
+
+cd $tempdir
+
+mkdir -- "a" "a/sub" "b"
+
+printf 'hello' > "a/foo.c"
+touch -- "a/bar.c"
+
+# Large files are mapped instead of read.
+head -c 100000 /dev/zero | tr '\0' 'x' > "b/big"
+
+for i in $(seq 1 100); do
+    printf '%s' "$i" > "a/sub/$i"
+done
+
+BUTTON_INPUTS=3 BUTTON_OUTPUTS=4 button-lua $script -o /dev/null \
+    3> inputs 4> /dev/null
+
+# Files are only reported once no matter how often they are read.
+test "$(grep -a -o 'a/foo\.c' inputs | wc -l)" -eq 1
+test "$(grep -a -o 'a/sub/42' inputs | wc -l)" -eq 1
+
+# Existence checks report the directory instead of the file.
+test "$(grep -a -o 'missing/foo\.c' inputs | wc -l)" -eq 0
+
+# Same results with a single thread
+button-lua $script -o /dev/null -j 1
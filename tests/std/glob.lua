@@ -26,9 +26,54 @@ local function equal(t1, t2)
     return true
 end
 
+-- Path to an ignore file.
+local ignore_file, mode = ...
+
 -- Don't prepend SCRIPT_DIR to glob paths.
 SCRIPT_DIR = nil
 
+if mode == "subdir" then
+    -- Anchored patterns in an ignore file are relative to its directory.
+    assert(equal(
+        glob {"**/*.c", ignore_file = "d/.ignore"},
+        {
+            "a/foo.c",
+            "b/bar.c",
+            "d/x/top.c",
+            "gen/a.c",
+            "top.c",
+        }
+    ))
+
+    -- Leading "./" and "../" in patterns don't change what is ignored.
+    assert(equal(
+        glob {"./d/**/*.c", ignore_file = "d/.ignore"},
+        {
+            "./d/x/top.c",
+        }
+    ))
+
+    assert(equal(
+        glob {"./*/*.c", ignore = "/b/"},
+        {
+            "./a/foo.c",
+            "./d/top.c",
+            "./gen/a.c",
+        }
+    ))
+
+    SCRIPT_DIR = "d"
+
+    assert(equal(
+        glob {"../a/*.c", "../d/*.c", ignore_file = ".ignore"},
+        {
+            "../a/foo.c",
+        }
+    ))
+
+    return
+end
+
 assert(equal(
     glob("*/*.c"),
     {
@@ -157,3 +202,169 @@ assert(equal(
         "b/bar.c",
     }
 ))
+
+--[[
+    Lazy glob results
+]]
+SCRIPT_DIR = nil
+
+local results = glob.lazy("**")
+assert(#results == 8)
+assert(results[1] == "a/foo.c")
+assert(results[8] == "c/baz.h")
+assert(results[0] == nil)
+assert(results[9] == nil)
+
+local t = {}
+for i,v in ipairs(results) do
+    t[i] = v
+end
+
+assert(equal(t, glob("**")))
+assert(equal(results:totable(), glob("**")))
+
+assert(equal(
+    glob.lazy("**"):filter(".c", ".cc"):totable(),
+    {
+        "a/foo.c",
+        "b/bar.c",
+        "c/1/foo.cc",
+        "c/2/bar.cc",
+        "c/3/baz.cc",
+    }
+))
+
+assert(equal(
+    glob.lazy {"*/*", "!*/*.c"}:filter {".h"}:totable(),
+    {
+        "a/foo.h",
+        "b/bar.h",
+        "c/baz.h",
+    }
+))
+
+assert(#glob.lazy("**"):filter(".d") == 0)
+
+--[[
+    Ignore rules and depth limits
+]]
+SCRIPT_DIR = nil
+
+assert(equal(
+    glob {"**", ignore = "c"},
+    {
+        "a/foo.c",
+        "a/foo.h",
+        "b/bar.c",
+        "b/bar.h",
+    }
+))
+
+assert(equal(
+    glob {"**", ignore = {"*.h", "c/*/"}},
+    {
+        "a/foo.c",
+        "b/bar.c",
+    }
+))
+
+assert(equal(
+    glob {"**", ignore = {"/c/**/*.cc", "!c/2/*"}},
+    {
+        "a/foo.c",
+        "a/foo.h",
+        "b/bar.c",
+        "b/bar.h",
+        "c/baz.h",
+        "c/2/bar.cc",
+    }
+))
+
+assert(equal(
+    glob {"c/3/*", ignore = "3/"},
+    {
+    }
+))
+
+assert(equal(
+    glob {"**", ignore_file = ignore_file},
+    {
+        "a/foo.c",
+        "a/foo.h",
+        "b/bar.c",
+        "c/1/foo.cc",
+        "c/2/bar.cc",
+    }
+))
+
+assert(equal(
+    glob {"**", max_depth = 0},
+    {
+    }
+))
+
+assert(equal(
+    glob {"**/", max_depth = 0},
+    {
+        "a",
+        "b",
+        "c",
+    }
+))
+
+assert(equal(
+    glob {"**", max_depth = 1},
+    {
+        "a/foo.c",
+        "a/foo.h",
+        "b/bar.c",
+        "b/bar.h",
+        "c/baz.h",
+    }
+))
+
+assert(equal(
+    glob.lazy({"**/*.cc", max_depth = 2, ignore = "1"}):totable(),
+    {
+        "c/2/bar.cc",
+        "c/3/baz.cc",
+    }
+))
+
+local files, sizes, mtimes = glob {"*/*.c", stat = true}
+assert(equal(files, {"a/foo.c", "b/bar.c"}))
+assert(equal(sizes, {0, 5}))
+assert(#mtimes == 2 and mtimes[1] > 0 and mtimes[2] > 0)
+
+local lazy = glob.lazy({"*/*", stat = true}):filter(".c")
+assert(#lazy == 2 and lazy[2] == "b/bar.c")
+local size, mtime = lazy:stat(2)
+assert(size == 5 and mtime == mtimes[2])
+
+assert(not pcall(function() return glob.lazy("*/*.c"):stat(1) end))
+
+-- Invalid arguments
+assert(not pcall(glob, {"**", max_depth = "deep"}))
+assert(not pcall(glob.lazy, {"**", max_depth = true}))
+assert(not pcall(glob.async, {"**", max_depth = {}}))
+assert(not pcall(function() return glob.lazy("**"):filter(".c", true) end))
+
+-- Asynchronous globs
+local handles = {}
+for i = 1, 20 do
+    handles[i] = glob.async {"**/*.cc", "!c/1/*"}
+end
+
+local sources = glob.async("*/*.c", {stat = true})
+
+for i = 1, 20 do
+    assert(equal(glob.await(handles[i]), {"c/2/bar.cc", "c/3/baz.cc"}))
+    assert(glob.ready(handles[i]))
+end
+
+local files, sizes = glob.await(sources)
+assert(equal(files, {"a/foo.c", "b/bar.c"}))
+assert(equal(sizes, {0, 5}))
+
+-- Unawaited globs must not keep the script from finishing.
+glob.async "**"
@@ -13,6 +13,7 @@ teardown() {
 trap teardown 0
 
 script=$(pwd)/glob.lua
+ignorefile=$(pwd)/glob.ignore
 
 cd $tempdir
 
@@ -34,4 +35,17 @@ touch -- "a/foo.c" \
          "c/2/bar.cc" \
          "c/3/baz.cc"
 
-button-lua $script -o /dev/null
+# Give one file a known size
+printf 'hello' > "b/bar.c"
+
+button-lua $script -o /dev/null "$ignorefile"
+
+# Same results with a single thread
+button-lua $script -o /dev/null -j 1 "$ignorefile"
+
+# Ignore files in a subdirectory
+mkdir -- "d" "d/x" "d/gen" "gen"
+touch -- "d/top.c" "d/x/top.c" "d/gen/a.c" "gen/a.c" "top.c"
+printf '/gen/\n/top.c\n' > "d/.ignore"
+
+button-lua $script -o /dev/null "$ignorefile" subdir
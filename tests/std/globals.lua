@@ -2,8 +2,18 @@
 Copyright 2016 Jason White. MIT license.
 ]]
 
+-- Native modules are only loaded when first used.
+assert(rawget(_G, "glob") == nil)
+assert(package.loaded.glob == nil)
+assert(require("coroutine") == coroutine)
+assert(rawget(_G, "coroutine") == coroutine)
+
 -- Basic checks to see if certain modules exist.
 assert(type(path) == "table")
+assert(type(glob) == "table")
+assert(require("path") == path)
+assert(require("glob") == glob)
+assert(type(debug.getinfo) == "function")
 
 -- Test that certain functions that can affect the file system don't exist.
 assert(io.popen == nil)
@@ -15,3 +25,10 @@ assert(os.rename == nil)
 assert(os.remove == nil)
 assert(package.loadlib == nil)
 assert(#package.searchers == 3)
+
+-- Embedded modules can be found, but nothing else.
+assert(type(require("rules")) == "table")
+assert(type(require("rules.cc.gcc")) == "table")
+assert(type(require("rules.d.dmd")) == "table")
+assert(not pcall(require, "rules.nonexistent"))
+assert(not pcall(require, "init"))
@@ -2,3 +2,9 @@
 # Copyright (c) 2016 Jason White
 # MIT License
 button-lua globals.lua -o /dev/null
+
+# Memory statistics and garbage collector options
+button-lua globals.lua -o /dev/null --mem-stats 2>&1 | grep -q "Lua memory usage"
+button-lua globals.lua -o /dev/null --gc-pause 150 --gc-stepmul 400
+button-lua globals.lua -o /dev/null --gc-mode incremental
+! button-lua globals.lua -o /dev/null --gc-mode bogus 2>/dev/null
@@ -0,0 +1,83 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests globbing against a git index or manifest. Only tracked files should be
+matched.
+]]
+
+local function equal(t1, t2)
+    table.sort(t1)
+    table.sort(t2)
+
+    if #t1 ~= #t2 then
+        local msg = string.format(
+            "Tables are not of equal length (%d != %d)", #t1, #t2)
+        return false, msg
+    end
+
+    for i,v in ipairs(t1) do
+        if v ~= t2[i] then
+            local msg = string.format(
+                "Tables are not equal ('%s' != '%s')", v, t2[i])
+            return false, msg
+        end
+    end
+
+    return true
+end
+
+SCRIPT_DIR = nil
+
+assert(equal(
+    glob("**"),
+    {
+        "a/foo.c",
+        "a/foo.h",
+        "b/bar.c",
+        "c/1/foo.cc",
+    }
+))
+
+assert(equal(
+    glob("*/"),
+    {
+        "a",
+        "b",
+        "c",
+    }
+))
+
+assert(equal(
+    glob("**/"),
+    {
+        "a",
+        "b",
+        "c",
+        "c/1",
+    }
+))
+
+assert(equal(
+    glob("a/*.c"),
+    {
+        "a/foo.c",
+    }
+))
+
+assert(equal(
+    glob {"a/foo.c", "a/untracked.c", "build/foo.o", "c/1/"},
+    {
+        "a/foo.c",
+        "c/1",
+    }
+))
+
+SCRIPT_DIR = "c"
+
+assert(equal(
+    glob("**/*.cc"),
+    {
+        "1/foo.cc",
+    }
+))
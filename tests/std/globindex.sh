@@ -0,0 +1,49 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+#
+# Description:
+# Tests globbing against a git index or manifest instead of the file system.
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+# Cleanup on exit
+trap teardown 0
+
+script=$(pwd)/globindex.lua
+
+cd $tempdir
+
+mkdir -- "a" \
+         "b" \
+         "c" \
+         "c/1" \
+         "build"
+
+# Tracked files
+touch -- "a/foo.c" \
+         "a/foo.h" \
+         "b/bar.c" \
+         "c/1/foo.cc"
+
+# Untracked files
+touch -- "a/untracked.c" \
+         "build/foo.o"
+
+printf "a/foo.c\na/foo.h\nb/bar.c\nc/1/foo.cc\n" > manifest.txt
+
+button-lua $script --manifest manifest.txt -o /dev/null
+
+if command -v git > /dev/null; then
+    git init -q .
+    git add -- "a/foo.c" "a/foo.h" "b/bar.c" "c/1/foo.cc"
+
+    for version in 2 3 4; do
+        git update-index --index-version $version
+        button-lua $script --git-index .git/index -o /dev/null
+    done
+fi
@@ -0,0 +1,67 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests the hash module. The files are created by hash.sh.
+]]
+
+-- Known values, one for each size class of XXH3.
+assert(hash.string("") == "2d06800538d394c2")
+assert(hash.string("a") == "e6c632b61e964e1f")
+assert(hash.string("abc") == "78af5f94892f3950")
+assert(hash.string("hello world") == "d447b1ea40e6988b")
+assert(hash.string(string.rep("x", 100)) == "c90984ffdf50ce42")
+assert(hash.string(string.rep("x", 200)) == "50ef124fb1e4de53")
+assert(hash.string(string.rep("x", 1000)) == "c0a4877b962cba82")
+assert(hash.string("abc", "xxh3") == "78af5f94892f3950")
+
+assert(hash.string("", "sha256") ==
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855")
+assert(hash.string("abc", "sha256") ==
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+assert(hash.string(string.rep("x", 1000), "sha256") ==
+    "44f8354494a5ba03ba1792a8d3e9c534c47a9181980fde7a3f44b06ef2ae7c7f")
+
+assert(not pcall(hash.string, "abc", "md5"))
+assert(not pcall(hash.string))
+
+-- Files
+assert(hash.file("abc.txt") == "78af5f94892f3950")
+assert(hash.file("./sub/../abc.txt") == "78af5f94892f3950")
+assert(hash.file("empty.txt") == "2d06800538d394c2")
+assert(hash.file("sha.txt", "sha256") ==
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+assert(hash.file(path.intern("abc.txt")) == "78af5f94892f3950")
+
+local h, err = hash.file("missing.txt")
+assert(h == nil and err:find("missing.txt", 1, true))
+assert(hash.file("sub") == nil)
+
+-- Large files are hashed the same as strings.
+local f = io.open("big.bin", "rb")
+local big = f:read("*a")
+f:close()
+assert(hash.file("big.bin") == hash.string(big))
+assert(hash.file("big.bin", "sha256") == hash.string(big, "sha256"))
+
+-- Many files on the thread pool
+local paths = {}
+for i = 1, 100 do
+    paths[i] = "sub/" .. i
+end
+paths[#paths+1] = "missing.txt"
+
+local hashes = hash.files(paths)
+assert(#hashes == 101)
+for i = 1, 100 do
+    assert(hashes[i] == hash.string(tostring(i)))
+end
+assert(hashes[101] == false)
+
+hashes = hash.files(paths, "sha256")
+for i = 1, 100 do
+    assert(hashes[i] == hash.string(tostring(i), "sha256"))
+end
+
+assert(#hash.files({}) == 0)
+assert(not pcall(hash.files, {1, {}}))
@@ -0,0 +1,43 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+trap teardown 0
+
+script=$(pwd)/hash.lua
+
+cd $tempdir
+
+mkdir -- "sub"
+
+printf 'abc' > "abc.txt"
+printf 'abc' > "sha.txt"
+touch -- "empty.txt"
+
+head -c 300000 /dev/urandom > "big.bin"
+
+for i in $(seq 1 100); do
+    printf '%s' "$i" > "sub/$i"
+done
+
+BUTTON_INPUTS=3 BUTTON_OUTPUTS=4 button-lua $script -o /dev/null \
+    3> inputs 4> /dev/null
+
+# Files are only reported once no matter how often they are hashed.
+test "$(grep -a -o 'abc\.txt' inputs | wc -l)" -eq 1
+test "$(grep -a -o 'sub/42' inputs | wc -l)" -eq 1
+
+# Files hashed with SHA-256 are reported with their checksum. It comes right
+# before the length, which comes right before the name.
+offset=$(grep -a -b -o 'sha\.txt' inputs | cut -d: -f1)
+checksum=$(od -A n -t x1 -j $((offset - 36)) -N 32 inputs | tr -d ' \n')
+test "$checksum" = "$(printf 'abc' | sha256sum | cut -d' ' -f1)"
+
+# Same results with a single thread
+button-lua $script -o /dev/null -j 1
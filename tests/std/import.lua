@@ -0,0 +1,56 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests importing build scripts in parallel. The output must be the same as when
+importing them one at a time.
+]]
+
+local mode, n = ...
+n = tonumber(n)
+
+local scripts = {}
+for i = 1, n do
+    scripts[i] = "dir" .. i .. "/BUILD.lua"
+end
+
+if mode == "serial" then
+    for _,script in ipairs(scripts) do
+        import(script)
+    end
+elseif mode == "parallel" then
+    import_all(scripts)
+elseif mode == "dofile" then
+    dofile "other.lua"
+elseif mode == "add" then
+    -- Adding targets directly must fail.
+    local ok, err = pcall(import_all, "bad/BUILD.lua")
+    assert(not ok)
+    assert(string.find(err, "rule modules"), err)
+elseif mode == "encode" then
+    -- Arguments that can't be copied to another Lua state fail cleanly.
+    local ok, err = pcall(import_all, {"fn/BUILD.lua"})
+    assert(not ok)
+    assert(string.find(err, "cannot pass a function", 1, true), err)
+
+    ok, err = pcall(import_all, {"keys/BUILD.lua"})
+    assert(not ok)
+    assert(string.find(err, "with function keys", 1, true), err)
+
+    -- Float keys outside the integer range stay floats.
+    import_all({"float/BUILD.lua"})
+
+    ok, err = pcall(import_all, {"float/BUILD.lua", {}})
+    assert(not ok)
+    assert(string.find(err, "path expected at index 2", 1, true), err)
+elseif mode == "replay" then
+    -- Recorded calls are only made in this state.
+    import_all {"count/BUILD.lua"}
+
+    -- Errors while replaying restore the script directory.
+    local dir = SCRIPT_DIR
+    local ok, err = pcall(import_all, {"count/BUILD.lua", "fail/BUILD.lua"})
+    assert(not ok)
+    assert(string.find(err, "replay failed", 1, true), err)
+    assert(SCRIPT_DIR == dir)
+end
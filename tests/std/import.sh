@@ -0,0 +1,102 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+# Cleanup on exit
+trap teardown 0
+
+cp -- import.lua "$tempdir"
+
+cd $tempdir
+
+script=$(pwd)/import.lua
+
+n=16
+
+# Create a build script in each directory
+for i in $(seq 1 $n); do
+    mkdir -- "dir$i"
+    touch -- "dir$i/main.c" "dir$i/util$i.c" "dir$i/util.h"
+
+    cat > "dir$i/BUILD.lua" <<END
+local cc = require "rules.cc"
+
+print("dir$i", $i, true)
+
+cc.binary {
+    name = "prog$i",
+    srcs = glob "*.c",
+    includes = {"."},
+}
+
+rule {
+    inputs = {"main.c"},
+    outputs = {"copy$i.c"},
+    task = {"cp", "main.c", "copy$i.c"},
+}
+END
+done
+
+mkdir -- "bad"
+cat > "bad/BUILD.lua" <<END
+local rules = require "rules"
+rules.add {}
+END
+
+button-lua $script -o serial.json serial $n > serial.out
+button-lua $script -o parallel.json parallel $n > parallel.out
+button-lua $script -o parallel1.json -j 1 parallel $n > parallel1.out
+
+cmp serial.json parallel.json
+cmp serial.out parallel.out
+cmp serial.json parallel1.json
+
+# Imported scripts are reported as inputs.
+printf 'return 1\n' > "other.lua"
+BUTTON_INPUTS=3 button-lua $script -o /dev/null serial $n \
+    3> serial.inputs > /dev/null
+BUTTON_INPUTS=3 button-lua $script -o /dev/null parallel $n \
+    3> parallel.inputs > /dev/null
+BUTTON_INPUTS=3 button-lua $script -o /dev/null dofile 0 \
+    3> dofile.inputs > /dev/null
+
+for i in $(seq 1 $n); do
+    grep -a -q "dir$i/BUILD.lua" serial.inputs
+    grep -a -q "dir$i/BUILD.lua" parallel.inputs
+done
+
+grep -a -q "other.lua" dofile.inputs
+
+mkdir -- "fn" "keys" "float"
+cat > "fn/BUILD.lua" <<END
+rule {inputs = {}, outputs = {"fn"}, task = {{"true"}}, display = print}
+END
+cat > "keys/BUILD.lua" <<END
+rule {inputs = {}, outputs = {"keys"}, task = {{"true"}}, [print] = 1}
+END
+cat > "float/BUILD.lua" <<END
+rule {inputs = {}, outputs = {"float"}, task = {{"true"}}, [2^70] = 1, [-2^70] = 2}
+END
+
+button-lua $script -o /dev/null encode 0
+button-lua $script -o /dev/null add 0
+
+mkdir -- "rules" "count" "fail"
+cat > "rules/count.lua" <<END
+return {
+    bump = function() io.stderr:write("bump\n") end,
+    fail = function() error("replay failed") end,
+}
+END
+printf 'require("rules.count").bump()\n' > "count/BUILD.lua"
+printf 'require("rules.count").fail()\n' > "fail/BUILD.lua"
+
+# Each recorded call is made exactly once.
+button-lua $script -o /dev/null replay 0 2> replay.err
+test "$(grep -c bump replay.err)" -eq 2
@@ -0,0 +1,159 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests the json module. The files are created by json.sh.
+]]
+
+local function fails(f, ...)
+    local ok, err = pcall(f, ...)
+    return not ok and err
+end
+
+-- Scalars
+assert(json.decode("1") == 1)
+assert(json.decode("-12") == -12)
+assert(json.decode("1.5") == 1.5)
+assert(json.decode("-2.5e3") == -2500)
+assert(json.decode("1E-2") == 0.01)
+assert(json.decode("12345678901234567890") == 12345678901234567890.0)
+assert(json.decode("0.1") == 0.1)
+assert(json.decode("-0") == 0)
+
+-- 64-bit integers are exact. Anything bigger becomes a float.
+if math.type then
+    assert(json.decode("1234567890123456789") == 1234567890123456789)
+    assert(json.decode("9223372036854775807") == math.maxinteger)
+    assert(json.decode("-9223372036854775808") == math.mininteger)
+    assert(math.type(json.decode("9223372036854775808")) == "float")
+    assert(math.type(json.decode("-9223372036854775809")) == "float")
+    assert(math.type(json.decode("1e2")) == "float")
+    assert(math.type(json.decode("12")) == "integer")
+end
+assert(json.decode("true") == true)
+assert(json.decode("false") == false)
+assert(json.decode("null") == json.null)
+assert(json.decode(" \t\r\n\"foo\" ") == "foo")
+assert(json.decode('""') == "")
+
+-- Escapes
+assert(json.decode([["a\"b\\c\/d"]]) == 'a"b\\c/d')
+assert(json.decode([["\b\f\n\r\t"]]) == "\b\f\n\r\t")
+assert(json.decode([["Aé€"]]) == "A\xc3\xa9\xe2\x82\xac")
+assert(json.decode([["😀"]]) == "\xf0\x9f\x98\x80")
+assert(json.decode([["\ud83d"]]) == "\xef\xbf\xbd")
+
+-- Strings longer than a block, with quotes and backslashes straddling blocks.
+local long = string.rep("x", 15) .. [[\"]] .. string.rep("y", 14) .. [[\\]]
+assert(json.decode('"' .. long .. '"') ==
+    string.rep("x", 15) .. '"' .. string.rep("y", 14) .. "\\")
+assert(json.decode('["' .. string.rep("\\\\", 40) .. '"]')[1] ==
+    string.rep("\\", 40))
+assert(json.decode('"' .. string.rep("z", 1000) .. '"') == string.rep("z", 1000))
+
+-- Arrays and objects
+local t = json.decode('[1, "two", [3, [4]], {"five": 5}, null, true]')
+assert(#t == 6)
+assert(t[1] == 1 and t[2] == "two")
+assert(t[3][1] == 3 and t[3][2][1] == 4)
+assert(t[4].five == 5)
+assert(t[5] == json.null)
+assert(t[6] == true)
+
+t = json.decode('{"a": {"b": {"c": []}}, "d": {}, "e\\n": "f", "a b": 1}')
+assert(#t.a.b.c == 0)
+assert(next(t.d) == nil)
+assert(t["e\n"] == "f")
+assert(t["a b"] == 1)
+
+-- The last duplicate key wins.
+assert(json.decode('{"a": 1, "a": 2}').a == 2)
+
+-- Deep nesting
+local depth = 500
+t = json.decode(string.rep("[", depth) .. string.rep("]", depth))
+for i = 1, depth - 1 do
+    t = t[1]
+end
+assert(#t == 0)
+
+-- Errors
+assert(fails(json.decode, ""))
+assert(fails(json.decode, "   "))
+assert(fails(json.decode, "[1, 2"))
+assert(fails(json.decode, "[1, 2,]"))
+assert(fails(json.decode, "[1 2]"))
+assert(fails(json.decode, "{\"a\" 1}"))
+assert(fails(json.decode, "{\"a\": 1,}"))
+assert(fails(json.decode, "{1: 2}"))
+assert(fails(json.decode, "[1]]"))
+assert(fails(json.decode, "[}"))
+assert(fails(json.decode, "1 2"))
+assert(fails(json.decode, "01"))
+assert(fails(json.decode, "1."))
+assert(fails(json.decode, "-"))
+assert(fails(json.decode, "+1"))
+assert(fails(json.decode, "1e"))
+assert(fails(json.decode, "tru"))
+assert(fails(json.decode, "nulls"))
+assert(fails(json.decode, '"abc'))
+assert(fails(json.decode, '"a\nb"'))
+assert(fails(json.decode, '"\\x"'))
+assert(fails(json.decode, '"\\u12g4"'))
+assert(fails(json.decode, string.rep("[", 2000) .. string.rep("]", 2000)))
+
+local err = fails(json.decode, '{\n  "a": 1\n  "b": 2\n}')
+assert(err:find("line 3, column 3", 1, true), err)
+
+-- Lazy decoding
+local doc = json.decode('{"a": [1, 2, {"b": "c"}], "d": null, "e": {}}',
+    {lazy = true})
+assert(type(doc) == "userdata")
+assert(doc.d == json.null)
+assert(doc.missing == nil)
+assert(#doc.a == 3)
+assert(doc.a[1] == 1 and doc.a[3].b == "c")
+assert(doc.a == doc.a)
+
+local n = 0
+for i,v in ipairs(doc.a) do
+    n = n + 1
+end
+assert(n == 3)
+
+local keys = {}
+for k,v in pairs(doc) do
+    keys[#keys+1] = k
+end
+table.sort(keys)
+assert(#keys == 3 and keys[1] == "a" and keys[2] == "d" and keys[3] == "e")
+
+assert(fails(function() doc.a = 1 end))
+
+t = json.totable(doc)
+assert(type(t) == "table" and type(t.a) == "table" and t.a[3].b == "c")
+assert(json.totable(42) == 42)
+
+-- Lazy values outlive the string they were decoded from.
+doc = json.decode('[[' .. string.rep('"x",', 100) .. '"y"]]', {lazy = true})
+collectgarbage()
+assert(#doc[1] == 101 and doc[1][101] == "y")
+
+assert(fails(json.decode, "[1, 2", {lazy = true}))
+
+-- Files
+t = json.load("small.json")
+assert(t.name == "small" and #t.list == 3)
+
+doc = json.load("big.json", {lazy = true})
+assert(#doc.items == 10000)
+assert(doc.items[10000].id == 10000)
+assert(doc.items[5000].name == "item5000")
+
+t = json.load("big.json")
+assert(#t.items == 10000 and t.items[1].id == 1)
+
+assert(json.load("missing.json") == nil)
+
+err = fails(json.load, "bad.json")
+assert(err:find("bad.json", 1, true), err)
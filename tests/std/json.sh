@@ -0,0 +1,34 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+trap teardown 0
+
+script=$(pwd)/json.lua
+
+cd $tempdir
+
+printf '{"name": "small", "list": [1, 2, 3]}' > "small.json"
+printf '{"a": 1,}' > "bad.json"
+
+# Large enough to be memory mapped.
+{
+    printf '{"items": ['
+    for i in $(seq 1 9999); do
+        printf '{"id": %d, "name": "item%d"},' "$i" "$i"
+    done
+    printf '{"id": 10000, "name": "item10000"}]}'
+} > "big.json"
+
+BUTTON_INPUTS=3 BUTTON_OUTPUTS=4 button-lua $script -o /dev/null \
+    3> inputs 4> /dev/null
+
+# Loaded files are reported once each.
+test "$(grep -a -o 'small\.json' inputs | wc -l)" -eq 1
+test "$(grep -a -o 'big\.json' inputs | wc -l)" -eq 1
@@ -0,0 +1,35 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests skipping runs where nothing changed. The files are created by noop.sh,
+which checks whether this was evaluated by what it prints.
+]]
+
+print("evaluated")
+
+local lib = require "lib"
+local version = hash.file("VERSION")
+
+for _, p in ipairs(glob("src/*.c")) do
+    rule {
+        inputs = {p},
+        task = {{"cc", "-c", p}},
+        outputs = {p .. ".o"},
+        display = lib.display .. " " .. version,
+    }
+end
+
+import "sub/BUILD.lua"
+
+-- The metadata of files and whether literal paths exist are inputs too.
+local headers, sizes, mtimes = glob {"src/*.h", stat = true}
+local config = glob "config.h"
+
+rule {
+    inputs = headers,
+    task = {{"true"}},
+    outputs = {"headers"},
+    display = "headers " .. table.concat(sizes, ",") .. " " ..
+        table.concat(mtimes, ",") .. " config " .. #config,
+}
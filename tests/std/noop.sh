@@ -0,0 +1,155 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+tempdir=$(mktemp -d)
+
+teardown() {
+    rm -rf -- "$tempdir"
+}
+
+trap teardown 0
+
+cp -- noop.lua "$tempdir"
+
+cd $tempdir
+
+mkdir -- "src"
+printf 'int a;\n' > "src/a.c"
+printf 'int b;\n' > "src/b.c"
+printf 'int h;\n' > "src/a.h"
+printf 'return {display = "cc"}\n' > "lib.lua"
+printf '1.0\n' > "VERSION"
+
+mkdir -- "sub"
+cat > "sub/BUILD.lua" <<END
+rule {inputs = {}, task = {{"true"}}, outputs = {"sub1"}}
+END
+
+# Runs are only recorded if their inputs are older than the run.
+age() {
+    touch -d '1 minute ago' -- "$@"
+}
+
+age noop.lua lib.lua VERSION src src/* sub sub/*
+
+run() {
+    BUTTON_INPUTS=3 button-lua noop.lua -o out.json --cache-dir cache "$@" \
+        3> inputs > stdout
+}
+
+evaluated() {
+    grep -q evaluated stdout
+}
+
+skipped() {
+    ! grep -q evaluated stdout
+}
+
+# Prints the status of the first reported input with the given name.
+status() {
+    local offset=$(grep -a -b -o -- "$1" inputs | head -n 1 | cut -d: -f1)
+    od -A n -t u4 -j $((offset - 40)) -N 4 inputs | tr -d ' '
+}
+
+run
+evaluated
+cp -- out.json first.json
+cp -- inputs first.inputs
+
+# Literal paths that don't exist are reported as such.
+test "$(status config.h)" -eq 1
+
+# Nothing changed, so the previous output and dependencies are reused.
+run
+skipped
+cmp first.json out.json
+cmp first.inputs inputs
+
+# A directory whose listing is the same
+touch -- src
+run
+skipped
+age src
+
+# A changed input
+printf '1.1\n' > "VERSION"
+age VERSION
+run
+evaluated
+run
+skipped
+
+# A new file in a globbed directory
+printf 'int c;\n' > "src/c.c"
+age src src/c.c
+run
+evaluated
+grep -q 'src/c.c' out.json
+run
+skipped
+
+# A changed module
+printf 'return {display = "compile"}\n' > "lib.lua"
+age lib.lua
+run
+evaluated
+grep -q compile out.json
+run
+skipped
+
+# A changed imported script
+cat >> "sub/BUILD.lua" <<END
+rule {inputs = {}, task = {{"true"}}, outputs = {"sub2"}}
+END
+age sub/BUILD.lua
+run
+evaluated
+grep -q sub2 out.json
+run
+skipped
+
+# A file whose metadata was read
+touch -d '30 seconds ago' -- src/a.h
+run
+evaluated
+run
+skipped
+
+# A literal path that didn't exist before
+printf '#define X\n' > "config.h"
+age config.h
+run
+evaluated
+grep -q 'config 1' out.json
+test "$(status config.h)" -eq 0
+run
+skipped
+
+# Different arguments are recorded separately.
+run extra
+evaluated
+run extra
+skipped
+
+# The output was changed by something else.
+printf 'garbage' > out.json
+run
+evaluated
+grep -q compile out.json
+run
+skipped
+
+# Inputs modified right before the run are never trusted.
+printf '1.2\n' > "VERSION"
+run
+evaluated
+run
+evaluated
+
+# Without a cache directory every run is evaluated.
+age VERSION
+button-lua noop.lua -o out.json > stdout
+evaluated
+button-lua noop.lua -o out.json > stdout
+evaluated
@@ -0,0 +1,69 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests interned path handles.
+]]
+
+local h = path.intern("a/./b/../c")
+
+-- Handles for equal paths are the same object.
+assert(tostring(h) == "a/c")
+assert(h:str() == "a/c")
+assert(h == path.intern("a/c"))
+assert(h == path.intern("c", "a"))
+assert(h == path.intern("c", path.intern("a")))
+assert(h == path.intern(h))
+assert(h ~= path.intern("a/b"))
+
+local set = {[h] = true}
+assert(set[path.intern("a//c/")])
+
+-- Methods
+assert(h:basename() == "c")
+assert(h:parent() == path.intern("a"))
+assert(h:parent():parent() == path.intern("."))
+assert(h:join("..", "d") == path.intern("a/d"))
+assert(h:join("/x") == path.intern("/x"))
+assert(type(h:id()) == "number")
+
+assert(tostring(path.intern("")) == ".")
+assert(tostring(path.intern("..")) == "..")
+assert(path.intern(".."):parent() == path.intern("../.."))
+assert(path.intern("/"):parent() == path.intern("/"))
+assert(path.intern("/foo"):parent() == path.intern("/"))
+
+-- Concatenation
+assert("-I" .. h == "-Ia/c")
+assert(h .. ".o" == "a/c.o")
+
+-- Interning is the same as normalizing the joined paths.
+local bases = {"", ".", "..", "a", "a/b", "/", "/a", "../a"}
+local paths = {"", ".", "..", "../..", "x", "x/../y", "./x//y/", "/z/../w",
+    "../../../x"}
+
+for _,base in ipairs(bases) do
+    for _,p in ipairs(paths) do
+        local expected = path.norm(path.join(base, p))
+        assert(tostring(path.intern(p, base)) == expected,
+            string.format("path.intern(%q, %q) ~= %q", p, base, expected))
+    end
+
+    local handles = path.intern_all(paths, base)
+    for i,p in ipairs(paths) do
+        assert(handles[i] == path.intern(p, base))
+    end
+end
+
+-- Handles can be used wherever paths can.
+assert(path.getext(path.intern("x/y.c")) == ".c")
+assert(path.join(h, "d") == "a/c/d")
+assert(path.norm_all({h, "b"}, "z")[1] == "z/a/c")
+
+-- Rules accept handles.
+rule {
+    inputs  = {h, path.intern("in/./put")},
+    task    = {{"cc", "-c", h}},
+    outputs = {path.intern("out/../out.o")},
+    cwd     = path.intern("dir/"),
+}
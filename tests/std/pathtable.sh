@@ -0,0 +1,18 @@
+#!/bin/bash -e
+# Copyright (c) 2016 Jason White
+# MIT License
+
+output=$(mktemp)
+
+teardown() {
+    rm -f -- "$output"
+}
+
+trap teardown 0
+
+button-lua pathtable.lua -o "$output"
+
+grep -q '"inputs": \["a/c", "in/put"\]' "$output"
+grep -q '"task": \[\["cc", "-c", "a/c"\]\]' "$output"
+grep -q '"outputs": \["out.o"\]' "$output"
+grep -q '"cwd": "dir"' "$output"
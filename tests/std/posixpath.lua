@@ -7,6 +7,20 @@ Tests the path manipulation functions for Posix.
 
 local path = posixpath;
 
+local function equal(t1, t2)
+    if #t1 ~= #t2 then
+        return false
+    end
+
+    for i,v in ipairs(t1) do
+        if v ~= t2[i] then
+            return false
+        end
+    end
+
+    return true
+end
+
 --[[
     Get the root part of the path.
 ]]
@@ -193,6 +207,41 @@ assert(path.norm("../foo/../bar/") == "../bar")
 assert(path.norm("../foo/../bar///") == "../bar")
 assert(path.norm("../path/./to//a/../b/c/../../test.txt/") == "../path/to/test.txt")
 
+--[[
+    path.norm_all, path.join_all, path.setext_all, and path.filter_ext
+]]
+local files = {"foo.c", "./bar/../baz.cc", "/abs//qux.h", "inc/"}
+
+assert(equal(path.norm_all({}), {}))
+assert(equal(path.norm_all(files), {"foo.c", "baz.cc", "/abs/qux.h", "inc"}))
+assert(equal(path.norm_all(files, "src/."),
+    {"src/foo.c", "src/baz.cc", "/abs/qux.h", "src/inc"}))
+
+for _,base in ipairs({"", "src", "src/", "../src/x/..", "/"}) do
+    local normed = path.norm_all(files, base)
+    for i,v in ipairs(files) do
+        assert(normed[i] == path.norm(path.join(base, v)))
+    end
+end
+
+assert(equal(path.join_all(files, "src"),
+    {"src/foo.c", "src/./bar/../baz.cc", "/abs//qux.h", "src/inc/"}))
+assert(equal(path.join_all(files, ""), files))
+
+assert(equal(path.setext_all(files, ".o"),
+    {"foo.o", "./bar/../baz.o", "/abs//qux.o", "inc/.o"}))
+
+assert(equal(path.filter_ext(files, {".c", ".h"}), {"foo.c", "/abs//qux.h"}))
+assert(equal(path.filter_ext(files, table.set {".cc"}), {"./bar/../baz.cc"}))
+assert(equal(path.filter_ext(files, {""}), {"inc/"}))
+assert(equal(path.filter_ext(files, {}), {}))
+
+assert(not pcall(path.norm_all, {"foo", true}))
+assert(not pcall(path.norm_all, "foo"))
+assert(not pcall(path.join_all, files))
+assert(not pcall(path.setext_all, files))
+assert(not pcall(path.filter_ext, files, ".c"))
+
 --[[
     path.matches
 ]]
@@ -0,0 +1,60 @@
+--[[
+Copyright 2016 Jason White. MIT license.
+
+Description:
+Tests additions to the table library.
+]]
+
+local function equal(t1, t2)
+    if #t1 ~= #t2 then
+        return false
+    end
+
+    for i,v in ipairs(t1) do
+        if v ~= t2[i] then
+            return false
+        end
+    end
+
+    return true
+end
+
+-- table.append
+local t = {1, 2}
+assert(table.append(t, 3, {4, 5}, {}, "six") == t)
+assert(equal(t, {1, 2, 3, 4, 5, "six"}))
+
+-- Stops at the first nil argument like ipairs()
+assert(equal(table.append({}, 1, nil, 2), {1}))
+
+-- table.join
+assert(equal(table.join(), {}))
+assert(equal(table.join({"a", "b"}, "c", {"d"}), {"a", "b", "c", "d"}))
+
+-- Elements past a hole are not included
+assert(equal(table.join({1, nil, 3}), {1}))
+
+local a = {"x"}
+assert(table.join(a) ~= a)
+
+-- table.contains
+assert(table.contains({".c", ".cc"}, ".cc"))
+assert(not table.contains({".c", ".cc"}, ".h"))
+assert(not table.contains({}, nil))
+assert(table.contains({1, 2, 3}, 2.0))
+
+-- table.set
+local s = table.set {".h", ".hpp"}
+assert(s[".h"] == true)
+assert(s[".hpp"] == true)
+assert(s[".c"] == nil)
+
+-- table.filter
+local function odd(x) return x % 2 == 1 end
+assert(equal(table.filter({1, 2, 3, 4, 5}, odd), {1, 3, 5}))
+assert(equal(table.filter({}, odd), {}))
+
+-- Works with lists that are not tables
+local files = glob.lazy(path.join(SCRIPT_DIR, "table.*"))
+assert(table.contains(files, path.join(SCRIPT_DIR, "table.lua")))
+assert(#table.filter(files, function(f) return path.getext(f) == ".sh" end) == 1)
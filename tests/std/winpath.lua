@@ -237,6 +237,26 @@ assert(path.norm("\\\\server\\share\\..\\..\\foo") == "\\\\server\\share\\foo")
 assert(path.norm("\\\\?\\UNC\\server\\share\\..\\..\\foo") == "\\\\?\\UNC\\server\\share\\foo")
 assert(path.norm("\\\\.\\COM1\\bar\\baz\\..\\..\\..\\foo") == "\\\\.\\COM1\\foo")
 
+--[[
+    path.norm_all, path.join_all, path.setext_all, and path.filter_ext
+]]
+local files = {"foo.c", ".\\bar/../baz.cc", "C:/abs//qux.h"}
+
+for _,base in ipairs({"", "src", "D:\\src\\", "\\\\server\\share"}) do
+    local normed = path.norm_all(files, base)
+    local joined = path.join_all(files, base)
+    for i,v in ipairs(files) do
+        assert(normed[i] == path.norm(path.join(base, v)))
+        assert(joined[i] == path.join(base, v))
+    end
+end
+
+local objs = path.setext_all(files, ".obj")
+assert(objs[1] == "foo.obj" and objs[3] == "C:/abs//qux.obj")
+
+local hdrs = path.filter_ext(files, {".h"})
+assert(#hdrs == 1 and hdrs[1] == "C:/abs//qux.h")
+
 --[[
     path.matches
 ]]
@@ -19,7 +19,11 @@
 # SOFTWARE.
 
 param (
-    [Parameter(Mandatory=$true)][string]$lua
+    [Parameter(Mandatory=$true)][string]$lua,
+
+    # Optional path to luac. If given, scripts are embedded as stripped
+    # bytecode instead of source.
+    [string]$luac = ""
 )
 
 # Stop immediately if something fails.
@@ -28,16 +32,31 @@ $ErrorActionPreference='Stop'
 # We need the absolute path to the Lua executable since we will be changing
 # directories.
 $lua=(Resolve-Path $lua)
+if ($luac) {
+    $luac=(Resolve-Path $luac)
+}
 
 # CD to the root of this project; "tools\embed.lua" needs this to be its
 # working directory.
 Set-Location (Join-Path $PSScriptRoot '..')
 
+# Scripts that are loaded directly instead of with require().
+$main = @('init.lua', 'shutdown.lua', 'worker.lua')
+$modules = @()
+
 # Generate the C files from the Lua files
 foreach ($name in (Get-ChildItem scripts -Include "*.lua" -Recurse -Name)) {
     $outfile = (Join-Path 'src\embedded' ([io.path]::ChangeExtension($name, 'c')))
     $dirname = [io.path]::GetDirectoryName($outfile)
     mkdir -Force -Path $dirname > $null
     Write-Host "Generating '$outfile'..."
-    & $lua tools\embed.lua (Join-Path scripts $name) | Out-File $outfile
+    & $lua tools\embed.lua (Join-Path scripts $name) $luac | Out-File $outfile
+
+    if ($main -notcontains $name) {
+        $modules += (Join-Path scripts $name)
+    }
 }
+
+# Generate the table of modules
+Write-Host "Generating 'src\embedded\modules.c'..."
+& $lua tools\embed-table.lua $modules | Out-File 'src\embedded\modules.c'
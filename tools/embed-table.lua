@@ -0,0 +1,142 @@
+--[[
+Copyright (c) 2016 Jason White
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+]]
+
+local description = [[
+Usage: lua embed-table.lua filename...
+
+Generates the table of embedded modules from the given scripts. The scripts
+must be in the "scripts" directory and must have been converted to C with
+embed.lua. Modules are looked up with a perfect hash that is computed here such
+that there are never any collisions at run time.
+]]
+
+if not arg or not arg[1] then
+  io.stderr:write(description)
+  return
+end
+
+--[[
+    Must be the same as hash_name() in src/embedded.cc. Only uses arithmetic
+    that is exact with both integers and doubles such that this works with any
+    version of Lua.
+]]
+local function hash(s, seed)
+    local h = seed
+    for i = 1, #s do
+        h = (h * 31 + s:byte(i)) % 4294967296
+    end
+    return h
+end
+
+local modules = {}
+
+for _,filename in ipairs(arg) do
+    local file = filename:gsub("\\", "/")
+    local rel = assert(file:match("^scripts/(.*)%.lua$"),
+        "script must be in the 'scripts' directory: ".. filename)
+
+    table.insert(modules, {
+        name = rel:gsub("/", "."),
+        path = rel,
+        varname = rel:gsub("[/%.]", "_"),
+    })
+end
+
+-- The output shouldn't depend on the order the files were given in.
+table.sort(modules, function(a, b) return a.name < b.name end)
+
+--[[
+    Finds the smallest table size and a seed such that all modules hash to
+    different slots.
+]]
+local function find_hash()
+    local n = #modules
+
+    for size = n, 4 * n + 1 do
+        for seed = 0, 65535 do
+            local slots = {}
+            local ok = true
+
+            for i,m in ipairs(modules) do
+                local slot = hash(m.name, seed) % size
+                if slots[slot] then
+                    ok = false
+                    break
+                end
+                slots[slot] = i
+            end
+
+            if ok then
+                return size, seed, slots
+            end
+        end
+    end
+
+    error("failed to find a perfect hash for the embedded modules")
+end
+
+local size, seed, slots = find_hash()
+
+local out = {}
+
+table.insert(out, [[
+/**
+ * This file is automatically generated by tools/embed-table.lua.
+ */
+]])
+
+for _,m in ipairs(modules) do
+    table.insert(out, ('#include "embedded/%s.c"\n'):format(m.path))
+end
+
+table.insert(out, [[
+
+/**
+ * List of embedded Lua modules.
+ */
+const Script embedded[] = {
+]])
+
+for _,m in ipairs(modules) do
+    table.insert(out, ('    SCRIPT("%s", "{embedded}/%s.lua", %s),\n'):format(
+        m.name, m.path, m.varname))
+end
+
+table.insert(out, ([[
+};
+
+/**
+ * Perfect hash table of the modules. The name of a module hashes to a unique
+ * slot that holds its index in the list above plus one. Empty slots are zero.
+ */
+const uint32_t embedded_seed = %d;
+
+const unsigned short embedded_slots[] = {
+]]):format(seed))
+
+for slot = 0, size - 1 do
+    table.insert(out, ("    %d,\n"):format(slots[slot] or 0))
+end
+
+table.insert(out, "};\n")
+
+io.write(table.concat(out))
@@ -21,7 +21,11 @@ THE SOFTWARE.
 ]]
 
 local description = [[
-Usage: lua embed.lua filename
+Usage: lua embed.lua filename [luac]
+
+If the path to luac is given, the script is compiled to stripped bytecode such
+that it doesn't need to be parsed at run time. If compilation fails, the source
+is embedded instead.
 ]]
 
 if not arg or not arg[1] then
@@ -30,9 +34,41 @@ if not arg or not arg[1] then
 end
 
 local filename = arg[1]
+local luac = arg[2]
 local varname = filename:gsub("[/\\%.]", "_")
 
-local content = assert(io.open(filename, "rb")):read("*a")
+--[[
+    Compiles the script with luac. Returns nil if that fails.
+]]
+local function compile(filename)
+    local output = os.tmpname()
+
+    local cmd = string.format('"%s" -s -o "%s" "%s"', luac, output, filename)
+
+    -- Lua 5.1 returns the exit code, 5.2+ returns true on success.
+    local ok = os.execute(cmd)
+
+    local content
+    if ok == true or ok == 0 then
+        local f = io.open(output, "rb")
+        if f then
+            content = f:read("*a")
+            f:close()
+        end
+    end
+
+    os.remove(output)
+    return content
+end
+
+local content = luac and luac ~= "" and compile(filename)
+
+local kind = "bytecode"
+
+if not content then
+    content = assert(io.open(filename, "rb")):read("*a")
+    kind = "source"
+end
 
 local numtab = {};
 
@@ -49,8 +85,10 @@ io.write(([[
  * This file is automatically generated from the script:
  *
  *      %s
+ *
+ * Contents: %s
  */
 unsigned char %s[] = {
 %s
 };
-]]):format(filename, varname, dump(content)))
+]]):format(filename, kind, varname, dump(content)))